@@ -37,6 +37,10 @@ using std::string;
   #include <GL/glu.h>
 #endif
 
+#ifdef OE_NULL_GL
+#include <Renderers2/OpenGL/NullGL.h>
+#endif
+
 #ifndef GL_RGB32F
 #define GL_RGB32F 34837
 #endif
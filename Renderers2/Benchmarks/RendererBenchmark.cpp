@@ -0,0 +1,480 @@
+// Renderer benchmark on synthetic scenes.
+// -------------------------------------------------------------------
+// Copyright (C) 2007 OpenEngine.dk (See AUTHORS)
+//
+// This program is free software; It is covered by the GNU General
+// Public License version 2 or any later version.
+// See the GNU General Public License for more details (see LICENSE).
+//--------------------------------------------------------------------
+
+// Renders a generated scene for a number of frames and writes the
+// CPU time per frame and per rendering stage as JSON or CSV:
+//
+//   Renderer2Benchmark --meshes 1000 --materials 16 --lights 1
+//       --depth 4 --transparency 0.1 --frames 200 --format json
+//
+// Built with RENDERER2_NULL_GL it runs without a GPU and also reports
+// the GL work per frame. Otherwise it renders to a GLUT window,
+// for instance through a software GL implementation. Built with
+// RENDERER2_PROFILE, --trace writes the profiled scopes of the
+// measured frames as a Chrome trace.
+
+#include <Renderers2/Benchmarks/SceneGenerator.h>
+#include <Renderers2/OpenGL/GLRenderer.h>
+#include <Renderers2/OpenGL/GLContext.h>
+#include <Renderers2/OpenGL/FrameTimer.h>
+#include <Resources2/PhongShader.h>
+#include <Resources2/ShaderResource.h>
+#include <Display2/Canvas3D.h>
+#include <Display2/CompositeCanvas.h>
+#include <Display/PerspectiveViewingVolume.h>
+#include <Display/Camera.h>
+#include <Scene/ISceneNode.h>
+#include <Scene/ISceneNodeVisitor.h>
+#include <Scene/MeshNode.h>
+#include <Core/EngineEvents.h>
+#include <Resources/ResourceManager.h>
+#include <Resources/DirectoryManager.h>
+#include <Utils/Timer.h>
+#include <Utils/Profiler.h>
+#include <Meta/OpenGL.h>
+#ifndef OE_NULL_GL
+#include <GL/glut.h>
+#endif
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <cstdlib>
+#include <cstring>
+#include <cstdio>
+
+using namespace OpenEngine;
+using namespace OpenEngine::Renderers2;
+using namespace OpenEngine::Renderers2::OpenGL;
+using Renderers2::Benchmarks::SceneGenerator;
+using Display2::Canvas3D;
+using Display2::CompositeCanvas;
+using Display::PerspectiveViewingVolume;
+using Display::Camera;
+using Scene::ISceneNode;
+using Scene::ISceneNodeVisitor;
+using Scene::MeshNode;
+using Resources::ResourceManager;
+using Resources::DirectoryManager;
+using Resources2::ShaderResource;
+using Resources2::ShaderResourcePlugin;
+using Resources2::PhongShader;
+using Utils::Timer;
+using Math::Vector;
+using Math::Matrix;
+using std::string;
+using std::vector;
+using std::map;
+using std::ostream;
+
+namespace {
+
+struct Options {
+    SceneGenerator::Parameters scene;
+    unsigned int frames, warmup, iterations;
+    unsigned int width, height;
+    bool composite;
+    string format, output, resources, trace;
+    Options()
+        : frames(200), warmup(10), iterations(10000)
+        , width(800), height(600)
+        , composite(false)
+        , format("json"), resources("resources/") {}
+};
+
+/**
+ * Summary of a series of measurements, in milliseconds.
+ */
+struct Summary {
+    unsigned int count;
+    double mean, min, median, p95, max;
+    Summary(vector<double> v): count(v.size()), mean(0), min(0), median(0), p95(0), max(0) {
+        if (v.empty()) return;
+        std::sort(v.begin(), v.end());
+        for (unsigned int i = 0; i < v.size(); ++i) mean += v[i];
+        mean /= v.size();
+        min = v.front();
+        max = v.back();
+        median = v[v.size() / 2];
+        p95 = v[std::min<size_t>(v.size() - 1, (size_t)(v.size() * 0.95))];
+    }
+};
+
+struct Stage {
+    vector<double> cpu, gpu;
+};
+
+struct Micro {
+    string name;
+    unsigned int iterations;
+    double total; // milliseconds
+};
+
+struct Results {
+    string backend;
+    vector<double> frames;
+    vector<string> order; // stages in the order first seen
+    map<string, Stage> stages;
+    vector<Micro> micro;
+    vector<std::pair<string, double> > gl; // per frame averages
+};
+
+double Now() {
+    return Timer::GetTime().AsInt() / 1000.0;
+}
+
+/**
+ * Visits the whole scene, counting the meshes.
+ */
+class TraversalVisitor : public ISceneNodeVisitor {
+public:
+    unsigned int meshes;
+    TraversalVisitor(): meshes(0) {}
+    void VisitMeshNode(MeshNode* node) {
+        ++meshes;
+        node->VisitSubNodes(*this);
+    }
+};
+
+void Usage() {
+    std::cerr << "Renderer2Benchmark [options]\n"
+              << "  --meshes N         meshes in the scene (1000)\n"
+              << "  --materials M      opaque materials, each with a transparent variant (16)\n"
+              << "  --lights L         point lights (1)\n"
+              << "  --depth D          levels of transformation nodes (4)\n"
+              << "  --transparency R   ratio of transparent meshes (0.1)\n"
+              << "  --seed S           scene seed (1)\n"
+              << "  --frames F         measured frames (200)\n"
+              << "  --warmup W         frames before measuring (10)\n"
+              << "  --iterations I     iterations of the micro benchmarks (10000)\n"
+              << "  --size WxH         canvas size (800x600)\n"
+              << "  --composite        render through a composite canvas\n"
+              << "  --resources DIR    directory holding extensions/Renderer2 (resources/)\n"
+              << "  --format json|csv  output format (json)\n"
+              << "  --output FILE      output file (standard output)\n"
+              << "  --trace FILE       Chrome trace of the measured frames, needs RENDERER2_PROFILE\n";
+}
+
+bool Parse(int argc, char** argv, Options& opt) {
+    for (int i = 1; i < argc; ++i) {
+        string arg = argv[i];
+        const char* value = i + 1 < argc ? argv[i + 1] : NULL;
+        if (arg == "--composite") { opt.composite = true; continue; }
+        if (arg == "--help" || value == NULL) return false;
+        ++i;
+        if (arg == "--meshes") opt.scene.meshes = strtoul(value, NULL, 10);
+        else if (arg == "--materials") opt.scene.materials = strtoul(value, NULL, 10);
+        else if (arg == "--lights") opt.scene.lights = strtoul(value, NULL, 10);
+        else if (arg == "--depth") opt.scene.depth = strtoul(value, NULL, 10);
+        else if (arg == "--transparency") opt.scene.transparency = atof(value);
+        else if (arg == "--seed") opt.scene.seed = strtoul(value, NULL, 10);
+        else if (arg == "--frames") opt.frames = strtoul(value, NULL, 10);
+        else if (arg == "--warmup") opt.warmup = strtoul(value, NULL, 10);
+        else if (arg == "--iterations") opt.iterations = strtoul(value, NULL, 10);
+        else if (arg == "--size") {
+            if (sscanf(value, "%ux%u", &opt.width, &opt.height) != 2) return false;
+        }
+        else if (arg == "--resources") opt.resources = value;
+        else if (arg == "--format") opt.format = value;
+        else if (arg == "--output") opt.output = value;
+        else if (arg == "--trace") opt.trace = value;
+        else return false;
+    }
+    return opt.format == "json" || opt.format == "csv";
+}
+
+/**
+ * Path of every sample, from its enclosing scopes. Listener type
+ * names are shortened to the class name.
+ */
+void CollectStages(const vector<FrameTimer::Sample>& samples, Results& results) {
+    vector<string> path;
+    for (unsigned int i = 0; i < samples.size(); ++i) {
+        const FrameTimer::Sample& s = samples[i];
+        string name = s.name;
+        string::size_type ns = name.rfind("::");
+        if (ns != string::npos) name = name.substr(ns + 2);
+        path.resize(s.depth);
+        path.push_back(name);
+        string key;
+        for (unsigned int j = 0; j < path.size(); ++j)
+            key += (j ? "/" : "") + path[j];
+        if (results.stages.find(key) == results.stages.end())
+            results.order.push_back(key);
+        Stage& stage = results.stages[key];
+        stage.cpu.push_back(s.cpu);
+        if (s.gpu >= 0.0) stage.gpu.push_back(s.gpu);
+    }
+}
+
+/**
+ * Shader apply and uniform flush in isolation: applying a shader
+ * whose uniforms did not change, and one whose matrices changed.
+ */
+void RunMicro(GLContext& ctx, SceneGenerator& generator, unsigned int iterations, Results& results) {
+    if (generator.GetMeshes().empty() || !ctx.ShaderSupport()) return;
+    PhongShader shader(generator.GetMeshes().front().get());
+    // linked up front, as Apply skips shaders still compiling
+    ctx.LookupShader(&shader, true);
+    ctx.Apply(&shader);
+    ctx.Release(&shader);
+
+    Micro apply = { "shader apply", iterations, 0.0 };
+    double start = Now();
+    for (unsigned int i = 0; i < iterations; ++i) {
+        ctx.Apply(&shader);
+        ctx.Release(&shader);
+    }
+    apply.total = Now() - start;
+    results.micro.push_back(apply);
+
+    Micro flush = { "uniform flush", iterations, 0.0 };
+    Matrix<4,4,float> m;
+    start = Now();
+    for (unsigned int i = 0; i < iterations; ++i) {
+        m(3, 0) = float(i);
+        shader.SetModelViewMatrix(m);
+        shader.SetModelViewProjectionMatrix(m);
+        ctx.Apply(&shader);
+        ctx.Release(&shader);
+    }
+    flush.total = Now() - start;
+    results.micro.push_back(flush);
+}
+
+void RunTraversal(ISceneNode* scene, unsigned int iterations, Results& results) {
+    Micro traversal = { "scene traversal", iterations, 0.0 };
+    double start = Now();
+    for (unsigned int i = 0; i < iterations; ++i) {
+        TraversalVisitor visitor;
+        scene->Accept(visitor);
+    }
+    traversal.total = Now() - start;
+    results.micro.push_back(traversal);
+}
+
+void WriteSummary(ostream& out, const Summary& s) {
+    out << "{\"count\": " << s.count
+        << ", \"mean\": " << s.mean
+        << ", \"min\": " << s.min
+        << ", \"median\": " << s.median
+        << ", \"p95\": " << s.p95
+        << ", \"max\": " << s.max << "}";
+}
+
+void WriteJSON(ostream& out, const Options& opt, const Results& r) {
+    out << "{\n"
+        << "  \"benchmark\": \"Renderer2\",\n"
+        << "  \"backend\": \"" << r.backend << "\",\n"
+        << "  \"parameters\": {\"meshes\": " << opt.scene.meshes
+        << ", \"materials\": " << opt.scene.materials
+        << ", \"lights\": " << opt.scene.lights
+        << ", \"depth\": " << opt.scene.depth
+        << ", \"transparency\": " << opt.scene.transparency
+        << ", \"seed\": " << opt.scene.seed
+        << ", \"frames\": " << opt.frames
+        << ", \"warmup\": " << opt.warmup
+        << ", \"width\": " << opt.width
+        << ", \"height\": " << opt.height
+        << ", \"composite\": " << (opt.composite ? "true" : "false") << "},\n"
+        << "  \"unit\": \"ms\",\n"
+        << "  \"frame\": ";
+    WriteSummary(out, Summary(r.frames));
+    out << ",\n  \"stages\": [";
+    for (unsigned int i = 0; i < r.order.size(); ++i) {
+        const Stage& stage = r.stages.find(r.order[i])->second;
+        out << (i ? ",\n" : "\n") << "    {\"name\": \"" << r.order[i] << "\", \"cpu\": ";
+        WriteSummary(out, Summary(stage.cpu));
+        if (!stage.gpu.empty()) {
+            out << ", \"gpu\": ";
+            WriteSummary(out, Summary(stage.gpu));
+        }
+        out << "}";
+    }
+    out << "\n  ],\n  \"micro\": [";
+    for (unsigned int i = 0; i < r.micro.size(); ++i) {
+        const Micro& m = r.micro[i];
+        out << (i ? ",\n" : "\n") << "    {\"name\": \"" << m.name
+            << "\", \"iterations\": " << m.iterations
+            << ", \"total\": " << m.total
+            << ", \"mean\": " << (m.iterations ? m.total / m.iterations : 0.0) << "}";
+    }
+    out << "\n  ]";
+    if (!r.gl.empty()) {
+        out << ",\n  \"gl\": {";
+        for (unsigned int i = 0; i < r.gl.size(); ++i)
+            out << (i ? ", " : "") << "\"" << r.gl[i].first << "\": " << r.gl[i].second;
+        out << "}";
+    }
+    out << "\n}\n";
+}
+
+void WriteRows(ostream& out, const string& section, const string& name, const Summary& s) {
+    out << section << "," << name << ",count," << s.count << "\n"
+        << section << "," << name << ",mean," << s.mean << "\n"
+        << section << "," << name << ",min," << s.min << "\n"
+        << section << "," << name << ",median," << s.median << "\n"
+        << section << "," << name << ",p95," << s.p95 << "\n"
+        << section << "," << name << ",max," << s.max << "\n";
+}
+
+void WriteCSV(ostream& out, const Options& opt, const Results& r) {
+    out << "section,name,statistic,value\n"
+        << "parameters,backend,," << r.backend << "\n"
+        << "parameters,meshes,," << opt.scene.meshes << "\n"
+        << "parameters,materials,," << opt.scene.materials << "\n"
+        << "parameters,lights,," << opt.scene.lights << "\n"
+        << "parameters,depth,," << opt.scene.depth << "\n"
+        << "parameters,transparency,," << opt.scene.transparency << "\n"
+        << "parameters,seed,," << opt.scene.seed << "\n"
+        << "parameters,frames,," << opt.frames << "\n"
+        << "parameters,composite,," << opt.composite << "\n";
+    WriteRows(out, "frame", "frame", Summary(r.frames));
+    for (unsigned int i = 0; i < r.order.size(); ++i) {
+        const Stage& stage = r.stages.find(r.order[i])->second;
+        WriteRows(out, "cpu", r.order[i], Summary(stage.cpu));
+        if (!stage.gpu.empty()) WriteRows(out, "gpu", r.order[i], Summary(stage.gpu));
+    }
+    for (unsigned int i = 0; i < r.micro.size(); ++i) {
+        const Micro& m = r.micro[i];
+        out << "micro," << m.name << ",iterations," << m.iterations << "\n"
+            << "micro," << m.name << ",mean," << (m.iterations ? m.total / m.iterations : 0.0) << "\n";
+    }
+    for (unsigned int i = 0; i < r.gl.size(); ++i)
+        out << "gl," << r.gl[i].first << ",mean," << r.gl[i].second << "\n";
+}
+
+} // anonymous namespace
+
+int main(int argc, char** argv) {
+    Options opt;
+    if (!Parse(argc, argv, opt)) {
+        Usage();
+        return 1;
+    }
+
+#ifndef OE_NULL_GL
+    glutInit(&argc, argv);
+    glutInitDisplayMode(GLUT_RGBA | GLUT_DEPTH | GLUT_DOUBLE);
+    glutInitWindowSize(opt.width, opt.height);
+    glutCreateWindow("Renderer2Benchmark");
+#endif
+
+    DirectoryManager::AppendPath(opt.resources);
+    ResourceManager<ShaderResource>::AddPlugin(new ShaderResourcePlugin());
+
+    SceneGenerator generator(opt.scene);
+    ISceneNode* scene = generator.Generate();
+
+    PerspectiveViewingVolume volume(1.0f, 10.0f * generator.GetSize(), float(opt.width) / opt.height);
+    Camera camera(volume);
+    camera.SetPosition(Vector<3,float>(0.0f, 0.0f, generator.GetSize()));
+    camera.LookAt(Vector<3,float>(0.0f, 0.0f, 0.0f));
+
+    Canvas3D* canvas3D = new Canvas3D(opt.width, opt.height, &camera, scene);
+    CompositeCanvas* composite = NULL;
+    if (opt.composite) {
+        composite = new CompositeCanvas(opt.width, opt.height);
+        composite->AddCanvas(canvas3D);
+    }
+
+    GLContext* ctx = new GLContext();
+    GLRenderer* renderer = new GLRenderer(ctx);
+    if (composite) renderer->SetCanvas(composite);
+    else renderer->SetCanvas(canvas3D);
+    renderer->SetTiming(true);
+    renderer->Handle(Core::InitializeEventArg());
+
+    Results results;
+#ifdef OE_NULL_GL
+    results.backend = "null";
+#else
+    results.backend = (const char*)glGetString(GL_RENDERER);
+#endif
+
+#ifdef OE_NULL_GL
+    NullGL::Statistics before, after;
+#endif
+    FrameTimer* timer = renderer->GetFrameTimer();
+    unsigned int collected = 0;
+    for (unsigned int i = 0; i < opt.warmup + opt.frames; ++i) {
+        bool measured = i >= opt.warmup;
+#ifdef OE_NULL_GL
+        if (i == opt.warmup) before = NullGL::GetStatistics();
+#endif
+#ifdef OE_PROFILE
+        if (i == opt.warmup) Utils::Profiler::Clear();
+#endif
+        double start = Now();
+        renderer->Handle(Core::ProcessEventArg(Timer::GetTime(), 16));
+#ifndef OE_NULL_GL
+        glFinish();
+#endif
+        if (measured) results.frames.push_back(Now() - start);
+        // samples lag behind the rendered frames, which are numbered
+        // from 1, so the first measured frame is warmup + 1.
+        if (timer->GetSampleFrame() > collected) {
+            collected = timer->GetSampleFrame();
+            if (collected > opt.warmup) CollectStages(timer->GetSamples(), results);
+        }
+    }
+    // the last frames are still in the timer ring
+    while (timer->Drain()) {
+        if (timer->GetSampleFrame() > opt.warmup) CollectStages(timer->GetSamples(), results);
+    }
+#ifdef OE_NULL_GL
+    after = NullGL::GetStatistics();
+    double frames = std::max(opt.frames, 1u);
+    results.gl.push_back(std::make_pair(string("calls"), (after.calls - before.calls) / frames));
+    results.gl.push_back(std::make_pair(string("draw calls"), (after.drawCalls - before.drawCalls) / frames));
+    results.gl.push_back(std::make_pair(string("vertices"), (after.vertices - before.vertices) / frames));
+    results.gl.push_back(std::make_pair(string("bytes uploaded"), (after.bytesUploaded - before.bytesUploaded) / frames));
+    results.gl.push_back(std::make_pair(string("state changes"), (after.stateChanges - before.stateChanges) / frames));
+    results.gl.push_back(std::make_pair(string("uniforms"), (after.uniforms - before.uniforms) / frames));
+#endif
+
+    if (!opt.trace.empty()) {
+#ifdef OE_PROFILE
+        std::ofstream file(opt.trace.c_str());
+        if (!file.is_open()) {
+            std::cerr << "Could not write " << opt.trace << std::endl;
+            return 1;
+        }
+        Utils::Profiler::WriteChromeTrace(file);
+#else
+        std::cerr << "Built without RENDERER2_PROFILE, no trace written" << std::endl;
+#endif
+    }
+
+    RunMicro(*ctx, generator, opt.iterations, results);
+    RunTraversal(scene, std::max(opt.iterations / std::max(opt.scene.meshes, 1u), 1u), results);
+
+    if (opt.output.empty()) {
+        if (opt.format == "json") WriteJSON(std::cout, opt, results);
+        else WriteCSV(std::cout, opt, results);
+    }
+    else {
+        std::ofstream file(opt.output.c_str());
+        if (!file.is_open()) {
+            std::cerr << "Could not write " << opt.output << std::endl;
+            return 1;
+        }
+        if (opt.format == "json") WriteJSON(file, opt, results);
+        else WriteCSV(file, opt, results);
+    }
+
+    renderer->Handle(Core::DeinitializeEventArg());
+    delete renderer;
+    delete ctx;
+    delete composite;
+    delete canvas3D;
+    delete scene;
+    return 0;
+}
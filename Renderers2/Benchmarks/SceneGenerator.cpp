@@ -0,0 +1,168 @@
+// Synthetic scenes for renderer benchmarks.
+// -------------------------------------------------------------------
+// Copyright (C) 2007 OpenEngine.dk (See AUTHORS)
+//
+// This program is free software; It is covered by the GNU General
+// Public License version 2 or any later version.
+// See the GNU General Public License for more details (see LICENSE).
+//--------------------------------------------------------------------
+
+#include <Renderers2/Benchmarks/SceneGenerator.h>
+#include <Scene/SceneNode.h>
+#include <Scene/TransformationNode.h>
+#include <Scene/MeshNode.h>
+#include <Scene/PointLightNode.h>
+#include <Geometry/GeometrySet.h>
+#include <Resources/DataBlock.h>
+#include <Resources/Indices.h>
+#include <cmath>
+#include <algorithm>
+
+namespace OpenEngine {
+namespace Renderers2 {
+namespace Benchmarks {
+
+using namespace Scene;
+using namespace Geometry;
+using namespace Resources;
+
+SceneGenerator::Parameters::Parameters()
+    : meshes(1000)
+    , materials(16)
+    , lights(1)
+    , depth(4)
+    , transparency(0.1f)
+    , seed(1)
+{}
+
+SceneGenerator::SceneGenerator(Parameters params)
+    : params(params)
+    , random(params.seed)
+    , size(0.0f)
+{}
+
+SceneGenerator::~SceneGenerator() {}
+
+/**
+ * Uniform in [0, 1). A fixed linear congruential generator, as rand
+ * differs between platforms.
+ */
+float SceneGenerator::Random() {
+    random = random * 1664525u + 1013904223u;
+    return (random >> 8) / float(1 << 24);
+}
+
+Vector<3,float> SceneGenerator::RandomPosition() {
+    return Vector<3,float>((Random() - 0.5f) * size,
+                           (Random() - 0.5f) * size,
+                           (Random() - 0.5f) * size);
+}
+
+MaterialPtr SceneGenerator::CreateMaterial(bool transparent) {
+    MaterialPtr mat(new Material());
+    mat->diffuse = Vector<4,float>(Random(), Random(), Random(), 1.0f);
+    mat->ambient = mat->diffuse * 0.2f;
+    mat->ambient[3] = 1.0f;
+    mat->specular = Vector<4,float>(1.0f, 1.0f, 1.0f, 1.0f);
+    mat->shininess = 8.0f + Random() * 56.0f;
+    mat->transparency = transparent ? 0.5f : 0.0f;
+    return mat;
+}
+
+/**
+ * Unit box with a normal per face vertex.
+ */
+MeshPtr SceneGenerator::CreateBox() {
+    DataBlock<3,float>* vertices = new DataBlock<3,float>(24);
+    DataBlock<3,float>* normals = new DataBlock<3,float>(24);
+    Indices* indices = new Indices(36);
+    float* v = vertices->GetData();
+    float* n = normals->GetData();
+    unsigned int* i = indices->GetData();
+    for (unsigned int face = 0; face < 6; ++face) {
+        unsigned int axis = face / 2;
+        float sign = face % 2 ? -1.0f : 1.0f;
+        for (unsigned int corner = 0; corner < 4; ++corner) {
+            float a = corner & 1 ? 0.5f : -0.5f;
+            float b = corner & 2 ? 0.5f : -0.5f;
+            float* p = v + (face * 4 + corner) * 3;
+            float* q = n + (face * 4 + corner) * 3;
+            p[axis] = 0.5f * sign;
+            p[(axis + 1) % 3] = a * sign;
+            p[(axis + 2) % 3] = b;
+            q[axis] = sign;
+            q[(axis + 1) % 3] = q[(axis + 2) % 3] = 0.0f;
+        }
+        const unsigned int quad[6] = { 0, 1, 2, 2, 1, 3 };
+        for (unsigned int k = 0; k < 6; ++k)
+            i[face * 6 + k] = face * 4 + quad[k];
+    }
+
+    GeometrySetPtr geom(new GeometrySet(IDataBlockPtr(vertices), IDataBlockPtr(normals)));
+    unsigned int index = meshes.size();
+    bool isTransparent = floor((index + 1) * params.transparency) > floor(index * params.transparency);
+    MaterialPtr mat = isTransparent ? transparent[index % transparent.size()]
+                                    : opaque[index % opaque.size()];
+    return MeshPtr(new Mesh(IndicesPtr(indices), TRIANGLES, geom, mat));
+}
+
+/**
+ * Spread count meshes evenly over the subtrees of a node, with the
+ * meshes at the leaves.
+ */
+void SceneGenerator::Build(TransformationNode* parent, unsigned int count, unsigned int depth) {
+    if (depth <= 1) {
+        for (unsigned int i = 0; i < count; ++i) {
+            TransformationNode* node = new TransformationNode();
+            node->SetPosition(RandomPosition());
+            MeshPtr mesh = CreateBox();
+            meshes.push_back(mesh);
+            node->AddNode(new MeshNode(mesh));
+            parent->AddNode(node);
+        }
+        return;
+    }
+    unsigned int branches = (unsigned int)ceil(pow(double(count), 1.0 / depth));
+    if (branches < 1) branches = 1;
+    for (unsigned int b = 0; b < branches; ++b) {
+        unsigned int share = count / branches + (b < count % branches ? 1 : 0);
+        if (share == 0) continue;
+        TransformationNode* node = new TransformationNode();
+        parent->AddNode(node);
+        Build(node, share, depth - 1);
+    }
+}
+
+ISceneNode* SceneGenerator::Generate() {
+    random = params.seed;
+    // about one box per 27 units of volume
+    size = 3.0f * pow(float(std::max(params.meshes, 1u)), 1.0f / 3.0f);
+    meshes.clear();
+    opaque.clear();
+    transparent.clear();
+    unsigned int materials = std::max(params.materials, 1u);
+    for (unsigned int i = 0; i < materials; ++i) {
+        opaque.push_back(CreateMaterial(false));
+        transparent.push_back(CreateMaterial(true));
+    }
+
+    SceneNode* root = new SceneNode();
+    for (unsigned int i = 0; i < params.lights; ++i) {
+        TransformationNode* node = new TransformationNode();
+        node->SetPosition(RandomPosition() * 1.5f);
+        PointLightNode* light = new PointLightNode();
+        light->diffuse = Vector<4,float>(0.8f, 0.8f, 0.8f, 1.0f);
+        light->specular = Vector<4,float>(1.0f, 1.0f, 1.0f, 1.0f);
+        node->AddNode(light);
+        root->AddNode(node);
+    }
+
+    TransformationNode* meshRoot = new TransformationNode();
+    root->AddNode(meshRoot);
+    Build(meshRoot, params.meshes, std::max(params.depth, 1u));
+    return root;
+}
+
+} // NS Benchmarks
+} // NS Renderers2
+} // NS OpenEngine
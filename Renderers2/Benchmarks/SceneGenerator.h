@@ -0,0 +1,97 @@
+// Synthetic scenes for renderer benchmarks.
+// -------------------------------------------------------------------
+// Copyright (C) 2007 OpenEngine.dk (See AUTHORS)
+//
+// This program is free software; It is covered by the GNU General
+// Public License version 2 or any later version.
+// See the GNU General Public License for more details (see LICENSE).
+//--------------------------------------------------------------------
+
+#ifndef _OE_BENCHMARKS_SCENE_GENERATOR_H_
+#define _OE_BENCHMARKS_SCENE_GENERATOR_H_
+
+#include <Geometry/Mesh.h>
+#include <Geometry/Material.h>
+#include <Math/Vector.h>
+#include <vector>
+
+namespace OpenEngine {
+    namespace Scene {
+        class ISceneNode;
+        class TransformationNode;
+    }
+namespace Renderers2 {
+namespace Benchmarks {
+
+using Scene::ISceneNode;
+using Scene::TransformationNode;
+using Geometry::MeshPtr;
+using Geometry::MaterialPtr;
+using Math::Vector;
+using std::vector;
+
+/**
+ * Synthetic scene generator
+ *
+ * Builds a scene of boxes, each with its own vertex data, hung below
+ * a tree of transformation nodes of the given depth. The boxes share
+ * the given number of opaque materials, and the given ratio of them
+ * use a transparent variant instead. Point lights are placed around
+ * the scene.
+ *
+ * The scene only depends on the parameters, including the seed, so
+ * runs with the same parameters render the same scene.
+ *
+ * @class SceneGenerator SceneGenerator.h Renderers2/Benchmarks/SceneGenerator.h
+ */
+class SceneGenerator {
+public:
+    struct Parameters {
+        unsigned int meshes;
+        unsigned int materials;
+        unsigned int lights;
+        unsigned int depth;     // levels of transformation nodes
+        float transparency;     // ratio of transparent meshes, 0 to 1
+        unsigned int seed;
+        Parameters();
+    };
+
+private:
+    Parameters params;
+    unsigned int random;
+    float size;
+    vector<MaterialPtr> opaque, transparent;
+    vector<MeshPtr> meshes;
+
+    float Random();
+    Vector<3,float> RandomPosition();
+    MaterialPtr CreateMaterial(bool transparent);
+    MeshPtr CreateBox();
+    void Build(TransformationNode* parent, unsigned int count, unsigned int depth);
+
+public:
+    SceneGenerator(Parameters params);
+    virtual ~SceneGenerator();
+
+    /**
+     * Generate a new scene. The caller owns the returned root.
+     */
+    ISceneNode* Generate();
+
+    /**
+     * Meshes of the last generated scene.
+     */
+    const vector<MeshPtr>& GetMeshes() const { return meshes; }
+
+    /**
+     * Side length of the cube centered at the origin containing the
+     * meshes.
+     */
+    float GetSize() const { return size; }
+};
+
+} // NS Benchmarks
+} // NS Renderers2
+} // NS OpenEngine
+
+#endif // _OE_BENCHMARKS_SCENE_GENERATOR_H_
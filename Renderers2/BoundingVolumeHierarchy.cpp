@@ -0,0 +1,198 @@
+// Bounding volume hierarchy over a scene graph.
+// -------------------------------------------------------------------
+// Copyright (C) 2007 OpenEngine.dk (See AUTHORS) 
+// 
+// This program is free software; It is covered by the GNU General 
+// Public License version 2 or any later version. 
+// See the GNU General Public License for more details (see LICENSE). 
+//--------------------------------------------------------------------
+
+#include <Renderers2/BoundingVolumeHierarchy.h>
+#include <Renderers2/Frustum.h>
+#include <Scene/ISceneNode.h>
+#include <Scene/TransformationNode.h>
+#include <Scene/MeshNode.h>
+#include <Geometry/Mesh.h>
+#include <Geometry/GeometrySet.h>
+
+#include <algorithm>
+#include <functional>
+#include <cmath>
+
+namespace OpenEngine {
+namespace Renderers2 {
+
+using Math::Vector;
+
+static const unsigned int NO_PARENT = 0xFFFFFFFF;
+
+BoundingVolumeHierarchy::BoundingVolumeHierarchy(ISceneNode* root, BoundsCache* cache)
+    : root(root)
+    , cache(cache)
+    , frame(0)
+{
+    cache->ChangedEvent().Attach(*this);
+    Rebuild();
+}
+
+BoundingVolumeHierarchy::~BoundingVolumeHierarchy() {
+    cache->ChangedEvent().Detach(*this);
+}
+
+ISceneNode* BoundingVolumeHierarchy::GetRoot() {
+    return root;
+}
+
+void BoundingVolumeHierarchy::Rebuild() {
+    entries.clear();
+    index.clear();
+    transformations.clear();
+    meshes.clear();
+    dirty.clear();
+    if (root) Build(root, NO_PARENT);
+    for (unsigned int i = entries.size(); i > 0; --i)
+        Refit(i - 1);
+}
+
+void BoundingVolumeHierarchy::Build(ISceneNode* node, unsigned int parent) {
+    unsigned int i = entries.size();
+    Entry e;
+    e.node = node;
+    e.transformation = dynamic_cast<TransformationNode*>(node);
+    e.mesh = dynamic_cast<MeshNode*>(node);
+    e.parent = parent;
+    if (e.transformation) e.matrix = e.transformation->GetTransformationMatrix();
+    e.bounds.infinite = false;
+    e.empty = true;
+    e.dirty = true;
+    entries.push_back(e);
+    index[node] = i;
+    if (e.transformation) transformations.push_back(i);
+    if (e.mesh && e.mesh->GetMesh()) {
+        IDataBlock* verts = e.mesh->GetMesh()->GetGeometrySet()->GetVertices().get();
+        if (verts) meshes[verts].push_back(i);
+    }
+
+    for (unsigned int c = 0; c < node->GetNumberOfNodes(); ++c)
+        Build(node->GetNode(c), i);
+    entries[i].end = entries.size();
+}
+
+void BoundingVolumeHierarchy::MarkDirty(unsigned int i) {
+    while (i != NO_PARENT && !entries[i].dirty) {
+        entries[i].dirty = true;
+        dirty.push_back(i);
+        i = entries[i].parent;
+    }
+}
+
+/**
+ * Grow the box b to contain the box a.
+ */
+static void Merge(Bounds& b, bool& empty, const Bounds& a) {
+    if (a.infinite) b.infinite = true;
+    if (b.infinite) return;
+    if (empty) {
+        b = a;
+        empty = false;
+        return;
+    }
+    for (unsigned int c = 0; c < 3; ++c) {
+        if (a.min[c] < b.min[c]) b.min[c] = a.min[c];
+        if (a.max[c] > b.max[c]) b.max[c] = a.max[c];
+    }
+}
+
+/**
+ * Transform a box by a (row vector) matrix, giving the box around
+ * the transformed box.
+ */
+static Bounds Transform(const Bounds& b, const Matrix<4,4,float>& m) {
+    if (b.infinite) return b;
+    Bounds r;
+    r.infinite = false;
+    for (unsigned int j = 0; j < 3; ++j) {
+        float center = m(3,j), extent = 0.0f;
+        for (unsigned int i = 0; i < 3; ++i) {
+            float c = (b.min[i] + b.max[i]) * 0.5f;
+            float e = (b.max[i] - b.min[i]) * 0.5f;
+            center += c * m(i,j);
+            extent += e * fabs(m(i,j));
+        }
+        r.min[j] = center - extent;
+        r.max[j] = center + extent;
+    }
+    return r;
+}
+
+/**
+ * Recompute the bounds of an entry from its mesh and its children,
+ * which must be up to date.
+ */
+void BoundingVolumeHierarchy::Refit(unsigned int i) {
+    Entry& e = entries[i];
+    if (!e.dirty) return;
+
+    Bounds b;
+    b.infinite = false;
+    bool empty = true;
+    if (e.mesh && e.mesh->GetMesh()) {
+        Resources::IDataBlockPtr verts = e.mesh->GetMesh()->GetGeometrySet()->GetVertices();
+        if (verts) Merge(b, empty, cache->Lookup(verts));
+    }
+    for (unsigned int c = i + 1; c < e.end; c = entries[c].end) {
+        if (!entries[c].empty) Merge(b, empty, entries[c].bounds);
+    }
+    if (e.transformation && !empty)
+        b = Transform(b, e.matrix);
+
+    e.bounds = b;
+    e.empty = empty && !b.infinite;
+    e.dirty = false;
+}
+
+void BoundingVolumeHierarchy::Update(unsigned int frame) {
+    if (frame == this->frame) return;
+    this->frame = frame;
+
+    for (unsigned int t = 0; t < transformations.size(); ++t) {
+        Entry& e = entries[transformations[t]];
+        Matrix<4,4,float> m = e.transformation->GetTransformationMatrix();
+        if (m != e.matrix) {
+            e.matrix = m;
+            MarkDirty(transformations[t]);
+        }
+    }
+    if (dirty.empty()) return;
+
+    // children follow their parents in preorder
+    std::sort(dirty.begin(), dirty.end(), std::greater<unsigned int>());
+    for (unsigned int i = 0; i < dirty.size(); ++i)
+        Refit(dirty[i]);
+    dirty.clear();
+}
+
+/**
+ * Mark the meshes using a block with changed bounds, refitted by the
+ * next Update.
+ */
+void BoundingVolumeHierarchy::Handle(BoundsChangedEventArg arg) {
+    map<IDataBlock*, vector<unsigned int> >::iterator it = meshes.begin();
+    if (arg.block) it = meshes.find(arg.block);
+    for (; it != meshes.end(); ++it) {
+        for (unsigned int i = 0; i < it->second.size(); ++i)
+            MarkDirty(it->second[i]);
+        if (arg.block) break;
+    }
+}
+
+bool BoundingVolumeHierarchy::Intersects(ISceneNode* node, const Frustum& frustum) {
+    map<ISceneNode*, unsigned int>::iterator it = index.find(node);
+    if (it == index.end()) return true;
+    Entry& e = entries[it->second];
+    if (e.empty) return false;
+    return frustum.Intersects(e.bounds);
+}
+
+} // NS Renderers2
+} // NS OpenEngine
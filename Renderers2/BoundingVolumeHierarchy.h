@@ -0,0 +1,113 @@
+// Bounding volume hierarchy over a scene graph.
+// -------------------------------------------------------------------
+// Copyright (C) 2007 OpenEngine.dk (See AUTHORS) 
+// 
+// This program is free software; It is covered by the GNU General 
+// Public License version 2 or any later version. 
+// See the GNU General Public License for more details (see LICENSE). 
+//--------------------------------------------------------------------
+
+#ifndef _OE_RENDERERS2_BOUNDING_VOLUME_HIERARCHY_H_
+#define _OE_RENDERERS2_BOUNDING_VOLUME_HIERARCHY_H_
+
+#include <Renderers2/BoundsCache.h>
+#include <Math/Matrix.h>
+#include <vector>
+#include <map>
+
+namespace OpenEngine {
+    namespace Scene {
+        class ISceneNode;
+        class TransformationNode;
+        class MeshNode;
+    }
+namespace Renderers2 {
+
+class Frustum;
+
+using Scene::ISceneNode;
+using Scene::TransformationNode;
+using Scene::MeshNode;
+using Math::Matrix;
+using Core::IListener;
+using std::vector;
+using std::map;
+
+/**
+ * Bounding volume hierarchy following the structure of a scene
+ * graph.
+ *
+ * Every node gets the bounds of the meshes in its sub tree,
+ * expressed in the coordinate frame the node is visited in, i.e.
+ * before its own transformation is applied. A visitor can thus test
+ * a node against the frustum of its current modelview matrix and
+ * skip the whole sub tree when it is outside.
+ *
+ * Update refits the bounds of the transformation nodes whose matrix
+ * changed, of the mesh nodes whose vertex bounds changed, and of
+ * their ancestors only. Transformations are compared to their last
+ * matrix, as the scene graph does not signal changes; other nodes are
+ * not visited. Adding or removing nodes is not tracked, call Rebuild
+ * after structural changes. Nodes unknown to the hierarchy are always
+ * reported visible.
+ *
+ * @class BoundingVolumeHierarchy BoundingVolumeHierarchy.h Renderers2/BoundingVolumeHierarchy.h
+ */
+class BoundingVolumeHierarchy : public IListener<BoundsChangedEventArg> {
+private:
+    struct Entry {
+        ISceneNode* node;
+        TransformationNode* transformation; // NULL if not a transformation node
+        MeshNode* mesh;                     // NULL if not a mesh node
+        unsigned int parent;                // index of the parent entry
+        unsigned int end;                   // index one past the sub tree
+        Matrix<4,4,float> matrix;           // transformation at last update
+        Bounds bounds;
+        bool empty;                         // no meshes in the sub tree
+        bool dirty;
+    };
+
+    ISceneNode* root;
+    BoundsCache* cache;
+    vector<Entry> entries;                  // scene graph in preorder
+    map<ISceneNode*, unsigned int> index;
+    vector<unsigned int> transformations;   // entries of transformation nodes
+    map<IDataBlock*, vector<unsigned int> > meshes; // vertex block to mesh entries
+    vector<unsigned int> dirty;             // entries marked by MarkDirty
+    unsigned int frame;
+
+    void Build(ISceneNode* node, unsigned int parent);
+    void MarkDirty(unsigned int i);
+    void Refit(unsigned int i);
+
+public:
+    BoundingVolumeHierarchy(ISceneNode* root, BoundsCache* cache);
+    virtual ~BoundingVolumeHierarchy();
+
+    ISceneNode* GetRoot();
+
+    /**
+     * Rebuild the hierarchy from the current scene graph.
+     */
+    void Rebuild();
+
+    /**
+     * Refit the bounds to the current transformations and vertex
+     * bounds. Calls with the same frame number as the previous call
+     * are ignored, so several visitors may update once per frame.
+     */
+    void Update(unsigned int frame);
+
+    /**
+     * True if the sub tree of the node may intersect the frustum.
+     * The frustum must be given in the frame the node is visited in.
+     */
+    bool Intersects(ISceneNode* node, const Frustum& frustum);
+
+    void Handle(BoundsChangedEventArg arg);
+};
+
+} // NS Renderers2
+} // NS OpenEngine
+
+#endif // _OE_RENDERERS2_BOUNDING_VOLUME_HIERARCHY_H_
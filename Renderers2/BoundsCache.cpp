@@ -0,0 +1,89 @@
+// Cache of axis aligned bounding boxes for vertex data blocks.
+// -------------------------------------------------------------------
+// Copyright (C) 2007 OpenEngine.dk (See AUTHORS) 
+// 
+// This program is free software; It is covered by the GNU General 
+// Public License version 2 or any later version. 
+// See the GNU General Public License for more details (see LICENSE). 
+//--------------------------------------------------------------------
+
+#include <Renderers2/BoundsCache.h>
+
+namespace OpenEngine {
+namespace Renderers2 {
+
+BoundsCache::BoundsCache() {
+}
+
+BoundsCache::~BoundsCache() {
+    Clear();
+}
+
+const Bounds& BoundsCache::Lookup(const IDataBlockPtr& db) {
+    map<IDataBlock*, Entry>::iterator it = bounds.find(db.get());
+    if (it != bounds.end()) {
+        if (!it->second.owner.expired())
+            return it->second.bounds;
+        // a new block at the address of a destroyed one
+        bounds.erase(it);
+    }
+    db->ChangedEvent().Attach(*this);
+    Entry& e = bounds[db.get()];
+    e.owner = db;
+    e.bounds = Compute(db.get());
+    return e.bounds;
+}
+
+void BoundsCache::ReleaseDead() {
+    map<IDataBlock*, Entry>::iterator it = bounds.begin();
+    while (it != bounds.end()) {
+        if (it->second.owner.expired()) bounds.erase(it++);
+        else ++it;
+    }
+}
+
+void BoundsCache::Clear() {
+    map<IDataBlock*, Entry>::iterator it = bounds.begin();
+    for (; it != bounds.end(); ++it) {
+        IDataBlockPtr db = it->second.owner.lock();
+        if (db) db->ChangedEvent().Detach(*this);
+    }
+    bounds.clear();
+    changedEvent.Notify(BoundsChangedEventArg(NULL));
+}
+
+void BoundsCache::Handle(IDataBlockChangedEventArg arg) {
+    map<IDataBlock*, Entry>::iterator it = bounds.find(arg.resource.get());
+    if (it == bounds.end()) return;
+    it->second.bounds = Compute(it->first);
+    changedEvent.Notify(BoundsChangedEventArg(it->first));
+}
+
+/**
+ * Compute the bounds of the first three components of each element.
+ * Blocks which are not float or whose data has been unloaded after
+ * upload get infinite bounds.
+ */
+Bounds BoundsCache::Compute(IDataBlock* db) {
+    Bounds b;
+    float* data = (float*)db->GetVoidDataPtr();
+    unsigned int dim = db->GetDimension();
+    b.infinite = data == NULL || db->GetType() != Resources::Types::FLOAT 
+        || db->GetSize() == 0 || dim == 0;
+    if (b.infinite) return b;
+
+    unsigned int comps = dim < 3 ? dim : 3;
+    for (unsigned int c = 0; c < 3; ++c)
+        b.min[c] = b.max[c] = c < comps ? data[c] : 0.0f;
+    for (unsigned int i = 1; i < db->GetSize(); ++i) {
+        float* v = data + i * dim;
+        for (unsigned int c = 0; c < comps; ++c) {
+            if (v[c] < b.min[c]) b.min[c] = v[c];
+            else if (v[c] > b.max[c]) b.max[c] = v[c];
+        }
+    }
+    return b;
+}
+
+} // NS Renderers2
+} // NS OpenEngine
@@ -0,0 +1,94 @@
+// Cache of axis aligned bounding boxes for vertex data blocks.
+// -------------------------------------------------------------------
+// Copyright (C) 2007 OpenEngine.dk (See AUTHORS) 
+// 
+// This program is free software; It is covered by the GNU General 
+// Public License version 2 or any later version. 
+// See the GNU General Public License for more details (see LICENSE). 
+//--------------------------------------------------------------------
+
+#ifndef _OE_RENDERERS2_BOUNDS_CACHE_H_
+#define _OE_RENDERERS2_BOUNDS_CACHE_H_
+
+#include <Resources/IDataBlock.h>
+#include <Core/Event.h>
+#include <Core/IListener.h>
+#include <Math/Vector.h>
+#include <boost/weak_ptr.hpp>
+#include <map>
+
+namespace OpenEngine {
+namespace Renderers2 {
+
+using Resources::IDataBlock;
+using Resources::IDataBlockPtr;
+using Resources::IDataBlockChangedEventArg;
+using Core::IListener;
+using Core::Event;
+using Core::IEvent;
+using Math::Vector;
+using std::map;
+
+/**
+ * Axis aligned bounding box. Infinite boxes are used when the
+ * bounds could not be computed and must never be culled.
+ */
+struct Bounds {
+    Vector<3,float> min, max;
+    bool infinite;
+};
+
+/**
+ * Changed bounds of a block, or of all blocks if block is NULL.
+ */
+class BoundsChangedEventArg {
+public:
+    BoundsChangedEventArg(IDataBlock* block): block(block) {}
+    IDataBlock* block;
+};
+
+/**
+ * Bounding box cache.
+ *
+ * Bounds are computed from the vertex data the first time a block is
+ * looked up and recomputed when the block signals a change, after
+ * which ChangedEvent is fired. Bounds of destroyed blocks are dropped
+ * by ReleaseDead.
+ *
+ * @class BoundsCache BoundsCache.h Renderers2/BoundsCache.h
+ */
+class BoundsCache : public IListener<IDataBlockChangedEventArg> {
+private:
+    struct Entry {
+        Bounds bounds;
+        boost::weak_ptr<IDataBlock> owner;
+    };
+    map<IDataBlock*, Entry> bounds;
+    Event<BoundsChangedEventArg> changedEvent;
+
+    Bounds Compute(IDataBlock* db);
+
+public:
+    BoundsCache();
+    virtual ~BoundsCache();
+
+    /**
+     * Get the object space bounds of a vertex data block.
+     */
+    const Bounds& Lookup(const IDataBlockPtr& db);
+
+    /**
+     * Drop the bounds of destroyed blocks.
+     */
+    void ReleaseDead();
+
+    IEvent<BoundsChangedEventArg>& ChangedEvent() { return changedEvent; }
+
+    void Clear();
+    void Handle(IDataBlockChangedEventArg arg);
+};
+
+} // NS Renderers2
+} // NS OpenEngine
+
+#endif // _OE_RENDERERS2_BOUNDS_CACHE_H_
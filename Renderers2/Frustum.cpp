@@ -0,0 +1,55 @@
+// View frustum for culling.
+// -------------------------------------------------------------------
+// Copyright (C) 2007 OpenEngine.dk (See AUTHORS) 
+// 
+// This program is free software; It is covered by the GNU General 
+// Public License version 2 or any later version. 
+// See the GNU General Public License for more details (see LICENSE). 
+//--------------------------------------------------------------------
+
+#include <Renderers2/Frustum.h>
+
+namespace OpenEngine {
+namespace Renderers2 {
+
+Frustum::Frustum() {
+    for (unsigned int i = 0; i < 6; ++i) {
+        planes[i][0] = planes[i][1] = planes[i][2] = 0.0f;
+        planes[i][3] = 1.0f;
+    }
+}
+
+Frustum::Frustum(const Matrix<4,4,float>& mvp) {
+    Set(mvp);
+}
+
+/**
+ * Extract the planes. Points are row vectors (p * mvp), so clip
+ * coordinate j is p dotted with column j and the planes are column 3
+ * plus or minus the columns 0 to 2.
+ */
+void Frustum::Set(const Matrix<4,4,float>& mvp) {
+    for (unsigned int c = 0; c < 3; ++c) {
+        for (unsigned int r = 0; r < 4; ++r) {
+            planes[c*2][r]   = mvp(r,3) + mvp(r,c);
+            planes[c*2+1][r] = mvp(r,3) - mvp(r,c);
+        }
+    }
+}
+
+bool Frustum::Intersects(const Bounds& b) const {
+    if (b.infinite) return true;
+    for (unsigned int i = 0; i < 6; ++i) {
+        const float* p = planes[i];
+        // the box corner furthest along the plane normal
+        float d = p[3];
+        d += p[0] * (p[0] >= 0.0f ? b.max[0] : b.min[0]);
+        d += p[1] * (p[1] >= 0.0f ? b.max[1] : b.min[1]);
+        d += p[2] * (p[2] >= 0.0f ? b.max[2] : b.min[2]);
+        if (d < 0.0f) return false;
+    }
+    return true;
+}
+
+} // NS Renderers2
+} // NS OpenEngine
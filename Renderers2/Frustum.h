@@ -0,0 +1,49 @@
+// View frustum for culling.
+// -------------------------------------------------------------------
+// Copyright (C) 2007 OpenEngine.dk (See AUTHORS) 
+// 
+// This program is free software; It is covered by the GNU General 
+// Public License version 2 or any later version. 
+// See the GNU General Public License for more details (see LICENSE). 
+//--------------------------------------------------------------------
+
+#ifndef _OE_RENDERERS2_FRUSTUM_H_
+#define _OE_RENDERERS2_FRUSTUM_H_
+
+#include <Renderers2/BoundsCache.h>
+#include <Math/Matrix.h>
+
+namespace OpenEngine {
+namespace Renderers2 {
+
+using Math::Matrix;
+
+/**
+ * View frustum given by the six clipping planes of a
+ * (model)view-projection matrix.
+ *
+ * The planes are in the space the matrix transforms from, so a
+ * frustum built from modelview times projection tests object space
+ * bounds directly.
+ *
+ * @class Frustum Frustum.h Renderers2/Frustum.h
+ */
+class Frustum {
+private:
+    float planes[6][4];
+public:
+    Frustum();
+    Frustum(const Matrix<4,4,float>& mvp);
+
+    void Set(const Matrix<4,4,float>& mvp);
+
+    /**
+     * True if the box is (partially) inside the frustum.
+     */
+    bool Intersects(const Bounds& b) const;
+};
+
+} // NS Renderers2
+} // NS OpenEngine
+
+#endif // _OE_RENDERERS2_FRUSTUM_H_
@@ -0,0 +1,234 @@
+// Software occlusion culling.
+// -------------------------------------------------------------------
+// Copyright (C) 2007 OpenEngine.dk (See AUTHORS) 
+// 
+// This program is free software; It is covered by the GNU General 
+// Public License version 2 or any later version. 
+// See the GNU General Public License for more details (see LICENSE). 
+//--------------------------------------------------------------------
+
+#include <Renderers2/OcclusionCuller.h>
+#include <Geometry/GeometrySet.h>
+#include <Resources/IDataBlock.h>
+#include <Core/Exceptions.h>
+
+#include <cmath>
+#include <algorithm>
+
+namespace OpenEngine {
+namespace Renderers2 {
+
+using Core::Exception;
+using Resources::IDataBlock;
+
+// clip space w below which geometry is considered to cross the near plane
+static const float NEAR_W = 1e-5f;
+
+OcclusionCuller::OcclusionCuller(unsigned int width, unsigned int height)
+    : width(width)
+    , height(height)
+    , depth(width * height, 1.0f)
+{
+}
+
+OcclusionCuller::~OcclusionCuller() {}
+
+/**
+ * Element i of an index block of unsigned bytes, shorts or ints.
+ */
+static unsigned int Index(const void* data, Resources::Types::Type type, unsigned int i) {
+    switch (type) {
+    case Resources::Types::UBYTE: return ((const unsigned char*)data)[i];
+    case Resources::Types::USHORT: return ((const unsigned short*)data)[i];
+    default: return ((const unsigned int*)data)[i];
+    }
+}
+
+void OcclusionCuller::AddOccluder(MeshPtr mesh, Matrix<4,4,float> m) {
+    IDataBlock* verts = mesh->GetGeometrySet()->GetVertices().get();
+    IDataBlock* indices = mesh->indices.get();
+    if (verts == NULL || indices == NULL || verts->GetVoidDataPtr() == NULL || 
+        indices->GetVoidDataPtr() == NULL || verts->GetDimension() < 3)
+        throw Exception("Occluder data not loaded.");
+    if (mesh->GetType() != Geometry::TRIANGLES)
+        throw Exception("Occluders must be triangle meshes.");
+    Resources::Types::Type type = indices->GetType();
+    if (verts->GetType() != Resources::Types::FLOAT ||
+        (type != Resources::Types::UINT && type != Resources::Types::USHORT && 
+         type != Resources::Types::UBYTE))
+        throw Exception("Occluders need float vertices and unsigned indices.");
+
+    float* v = (float*)verts->GetVoidDataPtr();
+    const void* is = indices->GetVoidDataPtr();
+    unsigned int dim = verts->GetDimension();
+    unsigned int offset = mesh->GetIndexOffset();
+    unsigned int end = std::min(offset + mesh->GetDrawingRange(), indices->GetSize());
+    // checked before any triangle is added, so a bad mesh adds none
+    for (unsigned int i = offset; i < end; ++i) {
+        if (Index(is, type, i) >= verts->GetSize())
+            throw Exception("Occluder index out of range.");
+    }
+    for (unsigned int i = offset; i + 2 < end; i += 3) {
+        for (unsigned int k = 0; k < 3; ++k) {
+            float* p = v + Index(is, type, i + k) * dim;
+            for (unsigned int j = 0; j < 3; ++j) 
+                vertices.push_back(p[0] * m(0,j) + p[1] * m(1,j) + p[2] * m(2,j) + m(3,j));
+        }
+    }
+    occluders.insert(mesh.get());
+}
+
+void OcclusionCuller::ClearOccluders() {
+    vertices.clear();
+    occluders.clear();
+}
+
+bool OcclusionCuller::IsOccluder(Mesh* mesh) {
+    return occluders.find(mesh) != occluders.end();
+}
+
+void OcclusionCuller::Rasterize(const Matrix<4,4,float>& vp) {
+    std::fill(depth.begin(), depth.end(), 1.0f);
+
+    // project all vertices to window space (x, y in pixels, z in [0,1])
+    unsigned int n = vertices.size() / 3;
+    screen.resize(n * 4);
+    const float* v = vertices.empty() ? NULL : &vertices[0];
+    for (unsigned int i = 0; i < n; ++i, v += 3) {
+        float cx = v[0] * vp(0,0) + v[1] * vp(1,0) + v[2] * vp(2,0) + vp(3,0);
+        float cy = v[0] * vp(0,1) + v[1] * vp(1,1) + v[2] * vp(2,1) + vp(3,1);
+        float cz = v[0] * vp(0,2) + v[1] * vp(1,2) + v[2] * vp(2,2) + vp(3,2);
+        float cw = v[0] * vp(0,3) + v[1] * vp(1,3) + v[2] * vp(2,3) + vp(3,3);
+        float* s = &screen[i * 4];
+        s[3] = cw;
+        if (cw < NEAR_W) continue;
+        float iw = 1.0f / cw;
+        s[0] = (cx * iw * 0.5f + 0.5f) * width;
+        s[1] = (cy * iw * 0.5f + 0.5f) * height;
+        s[2] = cz * iw * 0.5f + 0.5f;
+    }
+
+    for (unsigned int i = 0; i + 2 < n; i += 3) {
+        const float* s = &screen[i * 4];
+        // skip triangles crossing the near plane
+        if (s[3] < NEAR_W || s[7] < NEAR_W || s[11] < NEAR_W) continue;
+        RasterizeTriangle(s, s + 4, s + 8);
+    }
+}
+
+/**
+ * Rasterize a window space triangle with edge functions. Only pixels
+ * the triangle fully covers are written, with the farthest depth of
+ * the triangle over the pixel, so the buffer never hides anything the
+ * triangle leaves visible. The inner loop is a plain loop over a row
+ * of floats, which the compiler vectorizes.
+ */
+void OcclusionCuller::RasterizeTriangle(const float* v0, const float* v1, const float* v2) {
+    float area = (v1[0] - v0[0]) * (v2[1] - v0[1]) - (v1[1] - v0[1]) * (v2[0] - v0[0]);
+    if (fabs(area) < 1e-8f) return;
+    // occluders are double sided, orient the edges counter clockwise
+    if (area < 0.0f) {
+        const float* t = v1; v1 = v2; v2 = t;
+        area = -area;
+    }
+
+    float fx0 = std::min(v0[0], std::min(v1[0], v2[0]));
+    float fx1 = std::max(v0[0], std::max(v1[0], v2[0]));
+    float fy0 = std::min(v0[1], std::min(v1[1], v2[1]));
+    float fy1 = std::max(v0[1], std::max(v1[1], v2[1]));
+    if (fx1 < 0.0f || fy1 < 0.0f || fx0 >= width || fy0 >= height) return;
+    // clamped before the casts, vertices near the near plane overflow int
+    int x0 = int(std::max(fx0, 0.0f));
+    int x1 = int(std::min(fx1, float(width - 1)));
+    int y0 = int(std::max(fy0, 0.0f));
+    int y1 = int(std::min(fy1, float(height - 1)));
+
+    // edge functions e(x,y) = a*x + b*y + c, positive inside
+    const float* vs[3] = { v0, v1, v2 };
+    float a[3], b[3], c[3];
+    for (unsigned int e = 0; e < 3; ++e) {
+        const float* p = vs[(e + 1) % 3];
+        const float* q = vs[(e + 2) % 3];
+        a[e] = p[1] - q[1];
+        b[e] = q[0] - p[0];
+        c[e] = p[0] * q[1] - p[1] * q[0];
+    }
+    // depth as a plane over the window, z = zx*x + zy*y + zc
+    float inv = 1.0f / area;
+    float zx = (a[0] * v0[2] + a[1] * v1[2] + a[2] * v2[2]) * inv;
+    float zy = (b[0] * v0[2] + b[1] * v1[2] + b[2] * v2[2]) * inv;
+    float zc = (c[0] * v0[2] + c[1] * v1[2] + c[2] * v2[2]) * inv;
+    // evaluated at the pixel center, the edges are shifted to their
+    // value at the corner furthest outside, and the depth to its value
+    // at the farthest corner.
+    for (unsigned int e = 0; e < 3; ++e)
+        c[e] -= (fabs(a[e]) + fabs(b[e])) * 0.5f;
+    zc += (fabs(zx) + fabs(zy)) * 0.5f;
+
+    for (int y = y0; y <= y1; ++y) {
+        float py = y + 0.5f;
+        float* row = &depth[y * width];
+        float r0 = b[0] * py + c[0];
+        float r1 = b[1] * py + c[1];
+        float r2 = b[2] * py + c[2];
+        float rz = zy * py + zc;
+        for (int x = x0; x <= x1; ++x) {
+            float px = x + 0.5f;
+            float e0 = a[0] * px + r0;
+            float e1 = a[1] * px + r1;
+            float e2 = a[2] * px + r2;
+            float z = zx * px + rz;
+            bool inside = e0 >= 0.0f && e1 >= 0.0f && e2 >= 0.0f && z >= 0.0f;
+            row[x] = inside && z < row[x] ? z : row[x];
+        }
+    }
+}
+
+bool OcclusionCuller::IsVisible(const Bounds& b, const Matrix<4,4,float>& m) {
+    if (b.infinite) return true;
+
+    // window rectangle and nearest depth of the box corners
+    float x0 = width, x1 = 0.0f, y0 = height, y1 = 0.0f, zmin = 1.0f;
+    for (unsigned int i = 0; i < 8; ++i) {
+        float p[3] = { i & 1 ? b.max[0] : b.min[0],
+                       i & 2 ? b.max[1] : b.min[1],
+                       i & 4 ? b.max[2] : b.min[2] };
+        float cw = p[0] * m(0,3) + p[1] * m(1,3) + p[2] * m(2,3) + m(3,3);
+        if (cw < NEAR_W) return true;
+        float iw = 1.0f / cw;
+        float x = ((p[0] * m(0,0) + p[1] * m(1,0) + p[2] * m(2,0) + m(3,0)) * iw * 0.5f + 0.5f) * width;
+        float y = ((p[0] * m(0,1) + p[1] * m(1,1) + p[2] * m(2,1) + m(3,1)) * iw * 0.5f + 0.5f) * height;
+        float z = (p[0] * m(0,2) + p[1] * m(1,2) + p[2] * m(2,2) + m(3,2)) * iw * 0.5f + 0.5f;
+        x0 = std::min(x0, x); x1 = std::max(x1, x);
+        y0 = std::min(y0, y); y1 = std::max(y1, y);
+        zmin = std::min(zmin, z);
+    }
+    // outside the window, leave it to the frustum test
+    if (x1 < 0.0f || y1 < 0.0f || x0 >= width || y0 >= height) return true;
+
+    int ix0 = int(std::max(x0, 0.0f));
+    int ix1 = int(std::min(x1, float(width - 1)));
+    int iy0 = int(std::max(y0, 0.0f));
+    int iy1 = int(std::min(y1, float(height - 1)));
+    for (int y = iy0; y <= iy1; ++y) {
+        const float* row = &depth[y * width];
+        for (int x = ix0; x <= ix1; ++x) 
+            if (zmin <= row[x]) return true;
+    }
+    return false;
+}
+
+unsigned int OcclusionCuller::GetWidth() {
+    return width;
+}
+
+unsigned int OcclusionCuller::GetHeight() {
+    return height;
+}
+
+const float* OcclusionCuller::GetDepthBuffer() {
+    return &depth[0];
+}
+
+} // NS Renderers2
+} // NS OpenEngine
@@ -0,0 +1,92 @@
+// Software occlusion culling.
+// -------------------------------------------------------------------
+// Copyright (C) 2007 OpenEngine.dk (See AUTHORS) 
+// 
+// This program is free software; It is covered by the GNU General 
+// Public License version 2 or any later version. 
+// See the GNU General Public License for more details (see LICENSE). 
+//--------------------------------------------------------------------
+
+#ifndef _OE_RENDERERS2_OCCLUSION_CULLER_H_
+#define _OE_RENDERERS2_OCCLUSION_CULLER_H_
+
+#include <Renderers2/BoundsCache.h>
+#include <Geometry/Mesh.h>
+#include <Math/Matrix.h>
+#include <vector>
+#include <set>
+
+namespace OpenEngine {
+namespace Renderers2 {
+
+using Geometry::Mesh;
+using Geometry::MeshPtr;
+using Math::Matrix;
+using std::vector;
+using std::set;
+
+/**
+ * Software occlusion culler.
+ *
+ * A small set of occluder meshes is rasterized on the CPU into a low
+ * resolution depth buffer once per frame. Bounding boxes are then
+ * tested against the buffer by their screen rectangle and nearest
+ * depth, so meshes hidden behind the occluders need not be drawn.
+ *
+ * Occluders are copied to scene space when added and are static
+ * from then on. Occluders only cover the pixels they cover entirely,
+ * at their farthest depth over the pixel. Triangles crossing the near
+ * plane are not rasterized and boxes crossing it are always visible,
+ * which keeps the test conservative.
+ *
+ * @class OcclusionCuller OcclusionCuller.h Renderers2/OcclusionCuller.h
+ */
+class OcclusionCuller {
+private:
+    unsigned int width, height;
+    vector<float> depth;        // window depth in [0,1], row major
+    vector<float> vertices;     // occluder triangles in scene space, 9 floats each
+    vector<float> screen;       // scratch for projected triangles
+    set<Mesh*> occluders;
+
+    void RasterizeTriangle(const float* v0, const float* v1, const float* v2);
+
+public:
+    OcclusionCuller(unsigned int width = 256, unsigned int height = 128);
+    virtual ~OcclusionCuller();
+
+    /**
+     * Add the triangles of a mesh as occluder. The vertex data must
+     * still be loaded.
+     *
+     * @param mesh Occluder mesh, only triangle meshes are supported.
+     * @param modelMatrix Transformation from mesh to scene space.
+     */
+    void AddOccluder(MeshPtr mesh, Matrix<4,4,float> modelMatrix);
+    void ClearOccluders();
+    bool IsOccluder(Mesh* mesh);
+
+    /**
+     * Rasterize the occluders for a new frame.
+     *
+     * @param viewProjection Scene space to clip space matrix.
+     */
+    void Rasterize(const Matrix<4,4,float>& viewProjection);
+
+    /**
+     * True if the box may be visible behind the rasterized occluders.
+     *
+     * @param b Box in object space.
+     * @param mvp Object space to clip space matrix.
+     */
+    bool IsVisible(const Bounds& b, const Matrix<4,4,float>& mvp);
+
+    unsigned int GetWidth();
+    unsigned int GetHeight();
+    const float* GetDepthBuffer();
+};
+
+} // NS Renderers2
+} // NS OpenEngine
+
+#endif // _OE_RENDERERS2_OCCLUSION_CULLER_H_
@@ -0,0 +1,119 @@
+// Sub-allocation of small buffers from large GL buffers.
+// -------------------------------------------------------------------
+// Copyright (C) 2007 OpenEngine.dk (See AUTHORS)
+//
+// This program is free software; It is covered by the GNU General
+// Public License version 2 or any later version.
+// See the GNU General Public License for more details (see LICENSE).
+//--------------------------------------------------------------------
+
+#include <Renderers2/OpenGL/BufferArena.h>
+#include <Renderers2/OpenGL/GLContext.h>
+#include <Core/Exceptions.h>
+
+namespace OpenEngine {
+namespace Renderers2 {
+namespace OpenGL {
+
+using Core::Exception;
+
+BufferArena::BufferArena(GLContext& ctx, GLenum target, GLsizeiptr pageSize)
+    : ctx(ctx)
+    , target(target)
+    , pageSize(pageSize)
+{}
+
+BufferArena::~BufferArena() {
+    // pages are deleted by Release while the gl context is current.
+}
+
+bool BufferArena::Allocate(GLsizeiptr size, GLuint& buffer, GLintptr& offset) {
+    size = (size + ALIGNMENT - 1) & ~(ALIGNMENT - 1);
+    if (size > pageSize) return false;
+
+    for (unsigned int i = 0; i < pages.size(); ++i) {
+        if (Allocate(pages[i], size, offset)) {
+            buffer = pages[i].id;
+            return true;
+        }
+    }
+
+    Page page;
+    glGenBuffers(1, &page.id);
+    ctx.BindBuffer(target, page.id);
+    glBufferData(target, pageSize, NULL, GL_STATIC_DRAW);
+    CHECK_FOR_GL_ERROR();
+    page.free[0] = pageSize;
+    pages.push_back(page);
+
+    Allocate(pages.back(), size, offset);
+    buffer = pages.back().id;
+    return true;
+}
+
+bool BufferArena::Allocate(Page& page, GLsizeiptr size, GLintptr& offset) {
+    map<GLintptr, GLsizeiptr>::iterator it = page.free.begin();
+    for (; it != page.free.end(); ++it) {
+        if (it->second < size) continue;
+        offset = it->first;
+        GLsizeiptr rest = it->second - size;
+        page.free.erase(it);
+        if (rest > 0) page.free[offset + size] = rest;
+        page.used[offset] = size;
+        return true;
+    }
+    return false;
+}
+
+BufferArena::Page* BufferArena::FindPage(GLuint id) {
+    for (unsigned int i = 0; i < pages.size(); ++i)
+        if (pages[i].id == id) return &pages[i];
+    return NULL;
+}
+
+void BufferArena::Free(GLuint buffer, GLintptr offset) {
+    Page* page = FindPage(buffer);
+    map<GLintptr, GLsizeiptr>::iterator it;
+    if (page == NULL || (it = page->used.find(offset)) == page->used.end()) {
+#if OE_SAFE
+        throw Exception("Freeing unknown buffer arena allocation.");
+#endif
+        return;
+    }
+    GLsizeiptr size = it->second;
+    page->used.erase(it);
+
+    // merge with the following and preceding free ranges
+    map<GLintptr, GLsizeiptr>& free = page->free;
+    map<GLintptr, GLsizeiptr>::iterator next = free.find(offset + size);
+    if (next != free.end()) {
+        size += next->second;
+        free.erase(next);
+    }
+    map<GLintptr, GLsizeiptr>::iterator prev = free.lower_bound(offset);
+    if (prev != free.begin()) {
+        --prev;
+        if (prev->first + prev->second == offset) {
+            prev->second += size;
+            return;
+        }
+    }
+    free[offset] = size;
+}
+
+GLsizeiptr BufferArena::GetSize(GLuint buffer, GLintptr offset) {
+    Page* page = FindPage(buffer);
+    if (page == NULL) return 0;
+    map<GLintptr, GLsizeiptr>::iterator it = page->used.find(offset);
+    return it == page->used.end() ? 0 : it->second;
+}
+
+void BufferArena::Release() {
+    for (unsigned int i = 0; i < pages.size(); ++i)
+        glDeleteBuffers(1, &pages[i].id);
+    pages.clear();
+}
+
+} // NS OpenGL
+} // NS Renderers2
+} // NS OpenEngine
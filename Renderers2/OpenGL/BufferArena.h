@@ -0,0 +1,89 @@
+// Sub-allocation of small buffers from large GL buffers.
+// -------------------------------------------------------------------
+// Copyright (C) 2007 OpenEngine.dk (See AUTHORS)
+//
+// This program is free software; It is covered by the GNU General
+// Public License version 2 or any later version.
+// See the GNU General Public License for more details (see LICENSE).
+//--------------------------------------------------------------------
+
+#ifndef _OE_OPENGL_BUFFER_ARENA_H_
+#define _OE_OPENGL_BUFFER_ARENA_H_
+
+#include <Meta/OpenGL.h>
+#include <map>
+#include <vector>
+
+namespace OpenEngine {
+namespace Renderers2 {
+namespace OpenGL {
+
+class GLContext;
+
+using std::map;
+using std::vector;
+
+/**
+ * Buffer arena
+ *
+ * Hands out ranges of a few large buffer objects of one target, so
+ * many small data blocks share a buffer and are addressed by offset.
+ * Each page keeps a free list ordered by offset, allocations are
+ * first fit and freed ranges are merged with their neighbours.
+ *
+ * @class BufferArena BufferArena.h Renderers2/OpenGL/BufferArena.h
+ */
+class BufferArena {
+public:
+    // allocations are aligned to this many bytes.
+    static const GLsizeiptr ALIGNMENT = 16;
+
+private:
+    struct Page {
+        GLuint id;
+        map<GLintptr, GLsizeiptr> free;  // offset to size of free ranges
+        map<GLintptr, GLsizeiptr> used;  // offset to size of allocations
+    };
+
+    GLContext& ctx;
+    GLenum target;
+    GLsizeiptr pageSize;
+    vector<Page> pages;
+
+    bool Allocate(Page& page, GLsizeiptr size, GLintptr& offset);
+    Page* FindPage(GLuint id);
+
+public:
+    BufferArena(GLContext& ctx, GLenum target, GLsizeiptr pageSize);
+    virtual ~BufferArena();
+
+    /**
+     * Reserve size bytes, creating a new page if none has room.
+     * Returns false if the size exceeds the page size.
+     */
+    bool Allocate(GLsizeiptr size, GLuint& buffer, GLintptr& offset);
+
+    /**
+     * Return an allocation to its page.
+     */
+    void Free(GLuint buffer, GLintptr offset);
+
+    /**
+     * Size of an allocation, after alignment.
+     */
+    GLsizeiptr GetSize(GLuint buffer, GLintptr offset);
+
+    /**
+     * Delete all pages, invalidating every allocation.
+     */
+    void Release();
+
+    GLenum GetTarget() const { return target; }
+    GLsizeiptr GetPageSize() const { return pageSize; }
+};
+
+} // NS OpenGL
+} // NS Renderers2
+} // NS OpenEngine
+
+#endif // _OE_OPENGL_BUFFER_ARENA_H_
@@ -11,6 +11,7 @@
 #include <Renderers2/OpenGL/GLRenderer.h>
 #include <Renderers2/OpenGL/GLContext.h>
 #include <Display2/Canvas2D.h>
+#include <Utils/Profiler.h>
 
 namespace OpenEngine {
 namespace Renderers2 {
@@ -27,14 +28,17 @@ CanvasVisitor::~CanvasVisitor() {
 }
 
 void CanvasVisitor::Visit(Canvas2D* canvas) {
+    OE_PROFILE_SCOPE("CanvasVisitor::Visit(Canvas2D)");
     renderer.GetContext()->LookupCanvas(canvas);
 }
 
 void CanvasVisitor::Visit(Canvas3D* canvas) {
+    OE_PROFILE_SCOPE("CanvasVisitor::Visit(Canvas3D)");
     renderer.Render(canvas);
 }
 
 void CanvasVisitor::Visit(CompositeCanvas* canvas) {
+    OE_PROFILE_SCOPE("CanvasVisitor::Visit(CompositeCanvas)");
     renderer.Render(canvas);
 }
 
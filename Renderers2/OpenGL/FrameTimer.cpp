@@ -0,0 +1,165 @@
+// CPU and GPU timing of rendering scopes.
+// -------------------------------------------------------------------
+// Copyright (C) 2007 OpenEngine.dk (See AUTHORS)
+//
+// This program is free software; It is covered by the GNU General
+// Public License version 2 or any later version.
+// See the GNU General Public License for more details (see LICENSE).
+//--------------------------------------------------------------------
+
+#include <Renderers2/OpenGL/FrameTimer.h>
+#include <Core/Exceptions.h>
+#include <cstdlib>
+#ifdef __GNUC__
+#include <cxxabi.h>
+#endif
+
+namespace OpenEngine {
+namespace Renderers2 {
+namespace OpenGL {
+
+using Core::Exception;
+using Utils::Timer;
+
+FrameTimer::FrameTimer()
+    : current(0)
+    , gpuSupport(-1)
+    , sampleFrame(0)
+{
+    for (unsigned int i = 0; i < FRAMES; ++i)
+        frames[i].number = 0;
+}
+
+FrameTimer::~FrameTimer() {
+#ifndef OE_IOS
+    for (unsigned int i = 0; i < FRAMES; ++i)
+        for (unsigned int j = 0; j < frames[i].scopes.size(); ++j)
+            if (frames[i].scopes[j].queries[0])
+                glDeleteQueries(2, frames[i].scopes[j].queries);
+    if (!freeQueries.empty())
+        glDeleteQueries(freeQueries.size(), &freeQueries[0]);
+#endif
+}
+
+GLuint FrameTimer::Timestamp() {
+#ifdef OE_IOS
+    return 0;
+#else
+    if (gpuSupport < 0) gpuSupport = GLEW_ARB_timer_query ? 1 : 0;
+    if (!gpuSupport) return 0;
+    GLuint query;
+    if (freeQueries.empty())
+        glGenQueries(1, &query);
+    else {
+        query = freeQueries.back();
+        freeQueries.pop_back();
+    }
+    glQueryCounter(query, GL_TIMESTAMP);
+    return query;
+#endif
+}
+
+/**
+ * Turn the scopes of a frame into samples. The GPU results are only
+ * read once every query of the frame is done, so this never stalls.
+ */
+void FrameTimer::Collect(Frame& frame) {
+    if (frame.scopes.empty()) return;
+    samples.clear();
+    sampleFrame = frame.number;
+
+#ifndef OE_IOS
+    bool available = true;
+    for (unsigned int i = 0; i < frame.scopes.size() && available; ++i) {
+        if (frame.scopes[i].queries[1] == 0) continue;
+        GLuint ready = GL_FALSE;
+        glGetQueryObjectuiv(frame.scopes[i].queries[1], GL_QUERY_RESULT_AVAILABLE, &ready);
+        available = ready == GL_TRUE;
+    }
+#endif
+
+    for (unsigned int i = 0; i < frame.scopes.size(); ++i) {
+        Scope& scope = frame.scopes[i];
+        Sample sample;
+        sample.name = scope.name;
+        sample.depth = scope.depth;
+        sample.cpu = (scope.cpuEnd - scope.cpuStart) / 1000.0;
+        sample.gpu = -1.0;
+#ifndef OE_IOS
+        if (scope.queries[0] && scope.queries[1]) {
+            if (available) {
+                GLuint64 begin, end;
+                glGetQueryObjectui64v(scope.queries[0], GL_QUERY_RESULT, &begin);
+                glGetQueryObjectui64v(scope.queries[1], GL_QUERY_RESULT, &end);
+                sample.gpu = (end - begin) / 1000000.0;
+            }
+            freeQueries.push_back(scope.queries[0]);
+            freeQueries.push_back(scope.queries[1]);
+        }
+        else if (scope.queries[0])
+            freeQueries.push_back(scope.queries[0]);
+#endif
+        samples.push_back(sample);
+    }
+    frame.scopes.clear();
+}
+
+void FrameTimer::BeginFrame(unsigned int number) {
+#if OE_SAFE
+    if (!open.empty())
+        throw Exception("Frame timer scope not ended: " + frames[current].scopes[open.back()].name);
+#endif
+    open.clear();
+    current = (current + 1) % FRAMES;
+    Collect(frames[current]);
+    frames[current].number = number;
+}
+
+bool FrameTimer::Drain() {
+    for (unsigned int i = 1; i <= FRAMES; ++i) {
+        Frame& frame = frames[(current + i) % FRAMES];
+        if (frame.scopes.empty()) continue;
+        Collect(frame);
+        return true;
+    }
+    return false;
+}
+
+void FrameTimer::Begin(const string& name) {
+    Scope scope;
+    scope.name = name;
+    scope.depth = open.size();
+    scope.cpuStart = scope.cpuEnd = Timer::GetTime().AsInt();
+    scope.queries[0] = Timestamp();
+    scope.queries[1] = 0;
+    open.push_back(frames[current].scopes.size());
+    frames[current].scopes.push_back(scope);
+}
+
+void FrameTimer::End() {
+#if OE_SAFE
+    if (open.empty())
+        throw Exception("Frame timer scope ended without a begin");
+#endif
+    Scope& scope = frames[current].scopes[open.back()];
+    open.pop_back();
+    if (scope.queries[0]) scope.queries[1] = Timestamp();
+    scope.cpuEnd = Timer::GetTime().AsInt();
+}
+
+string FrameTimer::TypeName(const std::type_info& type) {
+#ifdef __GNUC__
+    int status;
+    char* name = abi::__cxa_demangle(type.name(), NULL, NULL, &status);
+    if (status == 0 && name) {
+        string result(name);
+        free(name);
+        return result;
+    }
+#endif
+    return type.name();
+}
+
+} // NS OpenGL
+} // NS Renderers2
+} // NS OpenEngine
@@ -0,0 +1,158 @@
+// CPU and GPU timing of rendering scopes.
+// -------------------------------------------------------------------
+// Copyright (C) 2007 OpenEngine.dk (See AUTHORS)
+//
+// This program is free software; It is covered by the GNU General
+// Public License version 2 or any later version.
+// See the GNU General Public License for more details (see LICENSE).
+//--------------------------------------------------------------------
+
+#ifndef _OE_OPENGL_FRAME_TIMER_H_
+#define _OE_OPENGL_FRAME_TIMER_H_
+
+#include <Meta/OpenGL.h>
+#include <Core/Event.h>
+#include <Utils/Timer.h>
+#include <string>
+#include <vector>
+#include <list>
+#include <map>
+#include <typeinfo>
+
+namespace OpenEngine {
+namespace Renderers2 {
+namespace OpenGL {
+
+using Core::Event;
+using Core::IListener;
+using std::string;
+using std::vector;
+using std::map;
+
+/**
+ * Frame timer
+ *
+ * Measures named, possibly nested, scopes of a frame on the CPU and
+ * on the GPU. GPU times are taken with timestamp queries, as elapsed
+ * time queries cannot nest. The queries of a frame are read back
+ * when its slot in a ring of frames comes around again, so reading
+ * never waits for the GPU. Samples therefore describe the frame
+ * FRAMES frames back. A frame whose queries are still not done then
+ * gets no GPU times.
+ *
+ * GPU times require ARB_timer_query and are never taken on ES 2.
+ *
+ * @class FrameTimer FrameTimer.h Renderers2/OpenGL/FrameTimer.h
+ */
+class FrameTimer {
+public:
+    static const unsigned int FRAMES = 3;
+
+    struct Sample {
+        string name;
+        unsigned int depth;     // number of enclosing scopes
+        double cpu, gpu;        // milliseconds, gpu negative if unknown
+    };
+
+private:
+    struct Scope {
+        string name;
+        unsigned int depth;
+        unsigned long long cpuStart, cpuEnd; // microseconds
+        GLuint queries[2];                   // begin and end timestamp, 0 if none
+    };
+    struct Frame {
+        unsigned int number;
+        vector<Scope> scopes;
+    };
+
+    Frame frames[FRAMES];
+    unsigned int current;
+    vector<unsigned int> open;  // scopes of the current frame not yet ended
+    vector<GLuint> freeQueries;
+    int gpuSupport;             // -1 until known
+    vector<Sample> samples;
+    unsigned int sampleFrame;
+
+    GLuint Timestamp();
+    void Collect(Frame& frame);
+
+public:
+    FrameTimer();
+    virtual ~FrameTimer();
+
+    /**
+     * Start the next frame, collecting the samples of the oldest
+     * frame in the ring. Call with the GL context current.
+     */
+    void BeginFrame(unsigned int number);
+
+    void Begin(const string& name);
+    void End();
+
+    /**
+     * Samples of the last collected frame, in the order the scopes
+     * were begun.
+     */
+    const vector<Sample>& GetSamples() const { return samples; }
+    unsigned int GetSampleFrame() const { return sampleFrame; }
+
+    /**
+     * Collect the oldest frame still in the ring, to read the last
+     * frames once rendering stops. False when none is left.
+     */
+    bool Drain();
+
+    /**
+     * Readable name of a listener's type.
+     */
+    static string TypeName(const std::type_info& type);
+};
+
+/**
+ * Event timing each of its listeners, inside a scope for the whole
+ * notification. Without a timer it notifies as a plain event.
+ *
+ * @class TimedEvent FrameTimer.h Renderers2/OpenGL/FrameTimer.h
+ */
+template <class T>
+class TimedEvent : public Event<T> {
+private:
+    string name;
+    FrameTimer* timer;
+    map<IListener<T>*, string> names;
+
+public:
+    TimedEvent(string name): name(name), timer(NULL) {}
+    virtual ~TimedEvent() {}
+
+    void SetTimer(FrameTimer* timer) { this->timer = timer; }
+
+    virtual void Detach(IListener<T>& listener) {
+        Event<T>::Detach(listener);
+        names.erase(&listener);
+    }
+
+    virtual void Notify(T arg) {
+        if (timer == NULL) {
+            Event<T>::Notify(arg);
+            return;
+        }
+        timer->Begin(name);
+        typename std::list<IListener<T>*>::iterator itr = this->ls.begin();
+        for (; itr != this->ls.end(); ++itr) {
+            string& listenerName = names[*itr];
+            if (listenerName.empty()) listenerName = FrameTimer::TypeName(typeid(**itr));
+            timer->Begin(listenerName);
+            (*itr)->Handle(arg);
+            timer->End();
+        }
+        timer->End();
+    }
+};
+
+} // NS OpenGL
+} // NS Renderers2
+} // NS OpenEngine
+
+#endif // _OE_OPENGL_FRAME_TIMER_H_
@@ -18,7 +18,14 @@
 #include <Resources/ITexture2D.h>
 #include <Resources/Texture2D.h>
 
+#include <algorithm>
+#include <cstring>
 #include <Logging/Logger.h>
+#include <Utils/Profiler.h>
+
+#ifndef GL_COMPLETION_STATUS_KHR
+#define GL_COMPLETION_STATUS_KHR 0x91B1
+#endif
 
 namespace OpenEngine {
 namespace Renderers2 {
@@ -34,16 +41,53 @@ using Resources::Texture2D;
 
 using namespace std;
 
+const GLuint GLContext::UNKNOWN_ID;
+
 GLContext::GLContext()
     : init(false)
     , fboSupport(false)
     , vboSupport(false)
     , shaderSupport(false) 
+    , instancingSupport(false)
+    , vaoSupport(false)
+    , syncSupport(false)
+    , uniformBufferSupport(false)
+    , streamer(NULL)
+    , arrayArena(*this, GL_ARRAY_BUFFER, 4 << 20)
+    , elementArena(*this, GL_ELEMENT_ARRAY_BUFFER, 4 << 20)
+    , arenaBlockSize(0)
+    , programCache(NULL)
+    , asyncCompile(false)
+    , parallelCompileSupport(false)
+    , vboGeneration(0)
+    , interleave(false)
+    , frameCount(1)
+    , memoryUsed(0)
+    , memoryBudget(0)
+    , evictionAge(60)
 {    
+#ifndef OE_IOS
+    for (unsigned int i = 0; i < STREAM_SEGMENTS; ++i)
+        frameFences[i] = 0;
+#endif
+    for (unsigned int i = 0; i < FALLBACK_KINDS; ++i)
+        fallbacks[i].shader = NULL;
+    InvalidateState();
 }
 
 GLContext::~GLContext() {
-
+    // shaders outliving the context must not notify it
+    map<Shader*, GLShader>::iterator it = shaders.begin();
+    for (; it != shaders.end(); ++it)
+        it->first->DestroyedEvent().Detach(*this);
+#ifndef OE_IOS
+    for (unsigned int i = 0; i < STREAM_SEGMENTS; ++i)
+        if (frameFences[i]) glDeleteSync(frameFences[i]);
+#endif
+    delete streamer;
+    delete programCache;
+    for (unsigned int i = 0; i < FALLBACK_KINDS; ++i)
+        delete fallbacks[i].shader;
 }
 
 void GLContext::Init() {
@@ -53,6 +97,10 @@ void GLContext::Init() {
     fboSupport = true;
     vboSupport = true;
     shaderSupport = true;
+    instancingSupport = false;
+    vaoSupport = false;
+    syncSupport = false;
+    uniformBufferSupport = false;
 #else
     GLenum err = glewInit();
     if (err!=GLEW_OK)
@@ -89,6 +137,14 @@ void GLContext::Init() {
     fboSupport = glewGetExtension("GL_EXT_framebuffer_object") == GL_TRUE;
     vboSupport = glewIsSupported("GL_VERSION_2_0");
     shaderSupport = glewIsSupported("GL_VERSION_2_0");
+    instancingSupport = shaderSupport && 
+        GLEW_ARB_instanced_arrays && GLEW_ARB_draw_instanced;
+    vaoSupport = vboSupport && GLEW_ARB_vertex_array_object;
+    syncSupport = vboSupport && GLEW_ARB_sync && GLEW_ARB_map_buffer_range;
+    uniformBufferSupport = shaderSupport && GLEW_ARB_uniform_buffer_object;
+    parallelCompileSupport = shaderSupport &&
+        (glewGetExtension("GL_KHR_parallel_shader_compile") == GL_TRUE ||
+         glewGetExtension("GL_ARB_parallel_shader_compile") == GL_TRUE);
 #endif
     
     init = true;
@@ -105,6 +161,18 @@ bool GLContext::VBOSupport() {
 bool GLContext::ShaderSupport() {
     return shaderSupport;
 }
+
+bool GLContext::InstancingSupport() {
+    return instancingSupport;
+}
+
+bool GLContext::VertexArraySupport() {
+    return vaoSupport;
+}
+
+bool GLContext::UniformBufferSupport() {
+    return uniformBufferSupport;
+}
     
 GLint GLContext::GLInternalColorFormat(ColorFormat f){
     switch (f) {
@@ -237,6 +305,7 @@ GLuint GLContext::LookupFBO(ICanvas* can) {
     glGenFramebuffers(1, &fbo);
 
     fbos[can] = fbo;
+    ++stats.resourcesCreated;
     return fbo;
 }
 
@@ -255,6 +324,7 @@ GLContext::Attachments GLContext::LoadCanvas(ICanvas* can) {
 GLContext::Attachments& GLContext::LookupCanvas(Canvas2D* can) {
     GLContext::Attachments& atts = LookupCanvas((ICanvas*)can);
     atts.color0 = can->GetTexture();
+    renderTargets.insert(atts.color0.get());
     return atts;
 }
 
@@ -265,6 +335,9 @@ GLContext::Attachments& GLContext::LookupCanvas(ICanvas* can) {
 
     GLContext::Attachments atts = LoadCanvas(can);
     attachments[can] = atts;
+    renderTargets.insert(atts.color0.get());
+    renderTargets.insert(atts.color1.get());
+    renderTargets.insert(atts.depth.get());
     
     return attachments[can];
 }
@@ -283,10 +356,10 @@ GLuint GLContext::LoadCubemap(ICubemap* cubemap) {
     CHECK_FOR_GL_ERROR();
 
     cubemap->SetID(texid); // deprecated nasty stuff
-    glBindTexture(GL_TEXTURE_CUBE_MAP, texid);
+    BindTexture(GL_TEXTURE_CUBE_MAP, texid);
     CHECK_FOR_GL_ERROR();
 
-    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    PixelStore(GL_UNPACK_ALIGNMENT, 1);
     CHECK_FOR_GL_ERROR();
     glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
     glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
@@ -318,24 +391,63 @@ GLuint GLContext::LoadCubemap(ICubemap* cubemap) {
                          cubemap->GetRawData((ICubemap::Face)(ICubemap::POSITIVE_X + i), m));
         CHECK_FOR_GL_ERROR();
     }
-    glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
+    stats.textureBytes += CubemapBytes(cubemap);
+    BindTexture(GL_TEXTURE_CUBE_MAP, 0);
     return texid;
 }
 
+GLContext::GLTexture& GLContext::LookupGLCubemap(ICubemap* cubemap) {
+    map<ICubemap*, GLTexture>::iterator it = cubemaps.find(cubemap);
+    if (it != cubemaps.end()) {
+        if (!it->second.tracked || !it->second.owner.expired()) {
+            Touch(it->second.lastUsed, it->second.lru);
+            return it->second;
+        }
+        // a new cubemap at the address of a destroyed one
+        ForgetCubemap(cubemap);
+    }
+    GLTexture cube;
+    cube.id = LoadCubemap(cubemap);
+    cube.bytes = 0;
+    cube.lastUsed = frameCount;
+    cube.lru = AddResident(NULL, cubemap, NULL);
+    cube.fromSource = false;
+    cube.tracked = false;
+    Account(cube.bytes, CubemapBytes(cubemap));
+    ++stats.resourcesCreated;
+    return cubemaps[cubemap] = cube;
+}
+
 GLuint GLContext::LookupCubemap(ICubemap* cubemap) {
-    map<ICubemap*, GLuint>::iterator it = cubemaps.find(cubemap);
-    if (it != cubemaps.end())
-        return it->second;
-    GLuint id = LoadCubemap(cubemap);
-    cubemaps[cubemap] = id;
-    return id;
+    return LookupGLCubemap(cubemap).id;
+}
+
+GLuint GLContext::LookupCubemap(ICubemapPtr cubemap) {
+    GLTexture& cube = LookupGLCubemap(cubemap.get());
+    if (!cube.tracked) {
+        cube.owner = cubemap;
+        cube.tracked = true;
+    }
+    return cube.id;
 }
  
 
 // ------- Texture -------
+/**
+ * Set the sampler parameters of the bound texture, unless they
+ * already match the texture's current settings.
+ */
 void GLContext::SetupTexParameters(ITexture2D* tex){
-    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
-    CHECK_FOR_GL_ERROR();
+    map<ITexture2D*, TexParameters>::iterator it = texParameters.find(tex);
+    if (it != texParameters.end() &&
+        it->second.wrapping == tex->GetWrapping() &&
+        it->second.filtering == tex->GetFiltering() &&
+        it->second.mipmapping == tex->UseMipmapping())
+        return;
+    TexParameters& params = texParameters[tex];
+    params.wrapping = tex->GetWrapping();
+    params.filtering = tex->GetFiltering();
+    params.mipmapping = tex->UseMipmapping();
 
 #ifdef OE_IOS
     // es test
@@ -371,10 +483,20 @@ void GLContext::SetupTexParameters(ITexture2D* tex){
 }
 
 
-GLuint GLContext::LoadTexture(ITexture2D* tex) {
+/**
+ * Upload a texture, loading its data if needed. Only textures looked
+ * up by shared pointer (owner set) are streamed, as the streamer must
+ * hold a reference while a worker loads them.
+ */
+GLuint GLContext::LoadTexture(ITexture2D* tex, ITexture2DPtr owner) {
+    OE_PROFILE_SCOPE("GLContext::LoadTexture");
 #if OE_SAFE
     if (tex == NULL) throw Exception("Cannot load NULL texture.");
 #endif
+    if (streamer && streamer->GetBudget() && owner && tex->GetVoidDataPtr() == NULL &&
+        renderTargets.find(tex) == renderTargets.end()) 
+        return LoadPlaceholder(owner);
+
     // signal we need the texture data if not loaded.
     bool loaded = true;
     if (tex->GetVoidDataPtr() == NULL){
@@ -387,10 +509,11 @@ GLuint GLContext::LoadTexture(ITexture2D* tex) {
     CHECK_FOR_GL_ERROR();
 
     tex->SetID(texid); // this operation is deprecated! Get texture id by querying the GLContext.
-    glBindTexture(GL_TEXTURE_2D, texid);
+    BindTexture(GL_TEXTURE_2D, texid);
     CHECK_FOR_GL_ERROR();
 
     SetupTexParameters(tex);
+    PixelStore(GL_UNPACK_ALIGNMENT, 1);
     
     GLint internalFormat = GLInternalColorFormat(tex->GetColorFormat());
     GLenum colorFormat = GLColorFormat(tex->GetColorFormat());
@@ -405,8 +528,11 @@ GLuint GLContext::LoadTexture(ITexture2D* tex) {
                  tex->GetType(),
                  tex->GetVoidDataPtr());
     CHECK_FOR_GL_ERROR();
+    // render targets are only allocated
+    if (tex->GetVoidDataPtr())
+        stats.textureBytes += tex->GetWidth() * tex->GetHeight() * PixelBytes(tex);
 
-    glBindTexture(GL_TEXTURE_2D, 0);
+    BindTexture(GL_TEXTURE_2D, 0);
 
     // Return the texture in the state we got it.
     if (!loaded)
@@ -415,54 +541,741 @@ GLuint GLContext::LoadTexture(ITexture2D* tex) {
     return texid;
 }
 
-GLuint GLContext::LookupTexture(ITexture2D* tex) {
-    map<ITexture2D*, GLuint>::iterator it = textures.find(tex);
+/**
+ * Create a texture with a single gray texel and request its data
+ * from the streamer.
+ */
+GLuint GLContext::LoadPlaceholder(ITexture2DPtr tex) {
+    GLuint texid; 
+    glGenTextures(1, &texid);
+    tex->SetID(texid); // this operation is deprecated! Get texture id by querying the GLContext.
+    BindTexture(GL_TEXTURE_2D, texid);
+    SetupTexParameters(tex.get());
+    PixelStore(GL_UNPACK_ALIGNMENT, 1);
+    const unsigned char gray[4] = { 128, 128, 128, 255 };
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, gray);
+    CHECK_FOR_GL_ERROR();
+    stats.textureBytes += 4;
+    BindTexture(GL_TEXTURE_2D, 0);
+
+    streamer->Request(tex);
+    return texid;
+}
+
+void GLContext::SetProgramCache(string directory) {
+    delete programCache;
+    programCache = NULL;
+    programCacheDir = directory;
+}
+
+void GLContext::SetTextureStreaming(unsigned int bytesPerFrame) {
+    if (streamer == NULL) streamer = new TextureStreamer(*this, bytesPerFrame);
+    else streamer->SetBudget(bytesPerFrame);
+}
+
+GLContext::GLTexture& GLContext::LookupGLTexture(ITexture2D* tex, ITexture2DPtr owner) {
+    map<ITexture2D*, GLTexture>::iterator it = textures.find(tex);
     if (it != textures.end()) {
-        return it->second;
+        if (!it->second.tracked || !it->second.owner.expired()) {
+            Touch(it->second.lastUsed, it->second.lru);
+            return it->second;
+        }
+        // a new texture at the address of a destroyed one
+        ForgetTexture(tex, false);
     }
-    GLuint id = LoadTexture(tex);
+    GLTexture glTex;
+    glTex.fromSource = tex->GetVoidDataPtr() == NULL;
+    glTex.id = LoadTexture(tex, owner);
+    glTex.bytes = 0;
+    glTex.lastUsed = frameCount;
+    glTex.lru = AddResident(tex, NULL, NULL);
+    glTex.tracked = false;
+    // a streamed texture holds its placeholder texel until uploaded
+    Account(glTex.bytes, streamer && streamer->IsPending(tex) ? 4 : TextureBytes(tex));
     tex->ChangedEvent().Attach(*this);
+    ++stats.resourcesCreated;
 
-    textures[tex] = id;
-    return id;
+    return textures[tex] = glTex;
+}
+
+GLuint GLContext::LookupTexture(ITexture2D* tex) {
+    return LookupGLTexture(tex, ITexture2DPtr()).id;
+}
+
+GLuint GLContext::LookupTexture(ITexture2DPtr tex) {
+    GLTexture& glTex = LookupGLTexture(tex.get(), tex);
+    if (!glTex.tracked) {
+        glTex.owner = tex;
+        glTex.tracked = true;
+    }
+    return glTex.id;
+}
+
+void GLContext::UpdateTextureMemory(ITexture2D* tex) {
+    map<ITexture2D*, GLTexture>::iterator it = textures.find(tex);
+    if (it != textures.end())
+        Account(it->second.bytes, TextureBytes(tex));
+    stats.textureBytes += tex->GetWidth() * tex->GetHeight() * PixelBytes(tex);
+}
+
+const GLContext::Statistics& GLContext::GetStatistics() {
+    return stats;
 }
 
 // ------- VBO -------
-GLuint GLContext::LoadVBO(IDataBlock* db) {
+GLContext::VBO GLContext::LoadVBO(IDataBlock* db) {
+    OE_PROFILE_SCOPE("GLContext::LoadVBO");
 #if OE_SAFE
     if (!vboSupport) throw Exception("VBOs not supported.");
     if (db == NULL) throw Exception("Cannot bind NULL data block.");
     if (db->GetVoidDataPtr() == NULL) throw Exception("Cannot bind data block with no data.");
 #endif
-    GLuint id;
-    glGenBuffers(1, &id);
-    CHECK_FOR_GL_ERROR();
-    
-    db->SetID(id); // this operation is deprecated! Get vbo id by querying the GLContext.
-    glBindBuffer(db->GetBlockType(), id);
-    CHECK_FOR_GL_ERROR();
-    
+    VBO vbo;
+    vbo.offset = 0;
+    vbo.stream = false;
+    vbo.bytes = 0;
+    vbo.lastUsed = frameCount;
+    vbo.tracked = false;
+    vbo.target = db->GetBlockType();
+    ++vboGeneration;
     unsigned int size = GLTypeSize(db->GetType()) * db->GetSize() * db->GetDimension();
-    GLenum access = GLAccessType(db->GetBlockType(), db->GetUpdateMode());
-        
-    glBufferData(db->GetBlockType(), 
-                 size,
-                 db->GetVoidDataPtr(), access); 
-    glBindBuffer(db->GetBlockType(), 0);
+
+    BufferArena* arena = LookupArena(db);
+    vbo.arena = arena && (GLsizeiptr)size <= arenaBlockSize && 
+        arena->Allocate(size, vbo.id, vbo.offset);
+    if (syncSupport && db->GetUpdateMode() == DYNAMIC) {
+        glGenBuffers(1, &vbo.id);
+        CHECK_FOR_GL_ERROR();
+        vbo.stream = true;
+        vbo.capacity = 0; // allocated by the first write
+        for (unsigned int i = 0; i < STREAM_SEGMENTS; ++i)
+            vbo.frames[i] = 0; // never written
+        vbo.segment = STREAM_SEGMENTS - 1;
+        StreamVBO(db, vbo);
+    }
+    else if (vbo.arena) {
+        BindBuffer(db->GetBlockType(), vbo.id);
+        glBufferSubData(db->GetBlockType(), vbo.offset, size, db->GetVoidDataPtr());
+        CHECK_FOR_GL_ERROR();
+        Account(vbo.bytes, size);
+        stats.bufferBytes += size;
+    }
+    else {
+        glGenBuffers(1, &vbo.id);
+        CHECK_FOR_GL_ERROR();
+        BindBuffer(db->GetBlockType(), vbo.id);
+        CHECK_FOR_GL_ERROR();
+
+        GLenum access = GLAccessType(db->GetBlockType(), db->GetUpdateMode());
+        glBufferData(db->GetBlockType(), 
+                     size,
+                     db->GetVoidDataPtr(), access); 
+        Account(vbo.bytes, size);
+        stats.bufferBytes += size;
+    }
+    db->SetID(vbo.id); // this operation is deprecated! Get vbo id by querying the GLContext.
+    BindBuffer(db->GetBlockType(), 0);
    
     if (db->GetUnloadPolicy() == UNLOAD_AUTOMATIC)
         db->Unload();
-    return id;
+    return vbo;
+}
+
+/**
+ * The arena a block may be sub-allocated from, or NULL if the block
+ * needs its own buffer.
+ */
+BufferArena* GLContext::LookupArena(IDataBlock* db) {
+    if (arenaBlockSize == 0 || db->GetUpdateMode() != STATIC) return NULL;
+    switch (db->GetBlockType()) {
+    case ARRAY: return &arrayArena;
+    case ELEMENT_ARRAY: return &elementArena;
+    default: return NULL;
+    }
+}
+
+GLContext::VBO& GLContext::LookupBuffer(IDataBlock* db) {
+    map<IDataBlock*, VBO>::iterator it = vbos.find(db);
+    if (it != vbos.end()) {
+        if (!it->second.tracked || !it->second.owner.expired()) {
+            Touch(it->second.lastUsed, it->second.lru);
+            return it->second;
+        }
+        // a new block at the address of a destroyed one
+        ForgetVBO(db, false);
+    }
+    VBO vbo = LoadVBO(db);
+    vbo.lru = AddResident(NULL, NULL, db);
+    if (interleavedBlocks.find(db) == interleavedBlocks.end())
+        db->ChangedEvent().Attach(*this);
+    ++stats.resourcesCreated;
+    return vbos[db] = vbo;
 }
 
 GLuint GLContext::LookupVBO(IDataBlock* db) {
-    map<IDataBlock*, GLuint>::iterator it = vbos.find(db);
-    if (it != vbos.end())
-        return (*it).second;
-    GLuint id = LoadVBO(db);
-    db->ChangedEvent().Attach(*this);
-    vbos[db] = id;
-    return id;
+    return LookupBuffer(db).id;
+}
+
+GLintptr GLContext::LookupVBOOffset(IDataBlock* db) {
+    return LookupBuffer(db).offset;
+}
+
+GLContext::VBO& GLContext::LookupBuffer(const IDataBlockPtr& db) {
+    VBO& vbo = LookupBuffer(db.get());
+    if (!vbo.tracked) {
+        vbo.owner = db;
+        vbo.tracked = true;
+    }
+    return vbo;
+}
+
+GLuint GLContext::LookupVBO(IDataBlockPtr db) {
+    return LookupBuffer(db).id;
+}
+
+GLintptr GLContext::LookupVBOOffset(IDataBlockPtr db) {
+    return LookupBuffer(db).offset;
+}
+
+void GLContext::SetBufferArena(GLsizeiptr maxSize) {
+    arenaBlockSize = maxSize;
+}
+
+void GLContext::SetInterleaving(bool enable) {
+    interleave = enable;
+}
+
+GLContext::InterleavedBuffer* GLContext::LookupInterleavedBuffer(const vector<IDataBlock*>& blocks, 
+                                                                 GLShader& glshader) {
+    if (!interleave || blocks.size() < 2) return NULL;
+    map<vector<IDataBlock*>, InterleavedBuffer>::iterator it = interleavedBuffers.find(blocks);
+    if (it != interleavedBuffers.end()) {
+        // new blocks at the addresses of destroyed ones
+        const vector<boost::weak_ptr<void> >& owners = it->second.owners;
+        for (unsigned int i = 0; i < owners.size(); ++i) {
+            if (!owners[i].expired()) continue;
+            ReleaseInterleavedBuffers(blocks[i]);
+            it = interleavedBuffers.end();
+            break;
+        }
+    }
+    if (it == interleavedBuffers.end())
+        it = interleavedBuffers.insert(make_pair(blocks, LoadInterleavedBuffer(blocks, glshader))).first;
+    return it->second.id ? &it->second : NULL;
+}
+
+/**
+ * Interleave the blocks into one buffer, each vertex holding the
+ * elements of all blocks at 4 byte aligned offsets. Returns a buffer
+ * with id 0 if the blocks do not qualify.
+ */
+GLContext::InterleavedBuffer GLContext::LoadInterleavedBuffer(const vector<IDataBlock*>& blocks, 
+                                                              GLShader& glshader) {
+    InterleavedBuffer ib;
+    ib.id = 0;
+    ib.stride = 0;
+    ib.bytes = 0;
+    unsigned int count = blocks[0] ? blocks[0]->GetSize() : 0;
+    for (unsigned int i = 0; i < blocks.size(); ++i) {
+        IDataBlock* db = blocks[i];
+        if (db == NULL || db->GetVoidDataPtr() == NULL || db->GetSize() != count ||
+            db->GetBlockType() != Resources::ARRAY || db->GetUpdateMode() != Resources::STATIC) 
+            return ib;
+        ib.offsets.push_back(ib.stride);
+        ib.stride += (GLTypeSize(db->GetType()) * db->GetDimension() + 3) & ~3;
+    }
+
+    char* data = new char[ib.stride * count];
+    for (unsigned int i = 0; i < blocks.size(); ++i) {
+        IDataBlock* db = blocks[i];
+        ib.owners.push_back(glshader.attributes[i].first->Get());
+        unsigned int size = GLTypeSize(db->GetType()) * db->GetDimension();
+        const char* src = (const char*)db->GetVoidDataPtr();
+        char* dst = data + ib.offsets[i];
+        for (unsigned int v = 0; v < count; ++v, src += size, dst += ib.stride)
+            memcpy(dst, src, size);
+        if (interleavedBlocks.insert(db).second && vbos.find(db) == vbos.end())
+            db->ChangedEvent().Attach(*this);
+    }
+
+    glGenBuffers(1, &ib.id);
+    ++vboGeneration;
+    BindBuffer(GL_ARRAY_BUFFER, ib.id);
+    glBufferData(GL_ARRAY_BUFFER, ib.stride * count, data, GL_STATIC_DRAW);
+    CHECK_FOR_GL_ERROR();
+    Account(ib.bytes, ib.stride * count);
+    stats.bufferBytes += ib.stride * count;
+    ++stats.resourcesCreated;
+    delete[] data;
+    return ib;
+}
+
+/**
+ * Release the interleaved buffers containing a block, or all of
+ * them if the block is NULL.
+ */
+void GLContext::ReleaseInterleavedBuffers(IDataBlock* db) {
+    map<vector<IDataBlock*>, InterleavedBuffer>::iterator it = interleavedBuffers.begin();
+    while (it != interleavedBuffers.end()) {
+        const vector<IDataBlock*>& blocks = it->first;
+        if (db && std::find(blocks.begin(), blocks.end(), db) == blocks.end()) {
+            ++it;
+            continue;
+        }
+        if (it->second.id) glDeleteBuffers(1, &it->second.id);
+        memoryUsed -= it->second.bytes;
+        interleavedBuffers.erase(it++);
+    }
+    ++vboGeneration;
+}
+
+void GLContext::UpdateVBORange(IDataBlock* db, unsigned int first, unsigned int count) {
+    // blocks not uploaded yet are uploaded in full on first use
+    if (count == 0 || (vbos.find(db) == vbos.end() && 
+                       interleavedBlocks.find(db) == interleavedBlocks.end()))
+        return;
+    dirtyRanges[db].push_back(make_pair(first, first + count));
+}
+
+void GLContext::BeginFrame() {
+#ifndef OE_IOS
+    if (syncSupport) {
+        // fence the commands of the frame just ended
+        GLsync& fence = frameFences[frameCount % STREAM_SEGMENTS];
+        if (fence) glDeleteSync(fence);
+        fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    }
+#endif
+    ++frameCount;
+
+    map<IDataBlock*, Ranges>::iterator it = dirtyRanges.begin();
+    for (; it != dirtyRanges.end(); ++it)
+        FlushRanges(it->first, it->second);
+    dirtyRanges.clear();
+
+    if (streamer) streamer->Process();
+    if (!pendingPrograms.empty()) PollPrograms();
+    ReleaseDead();
+    Evict();
+    ReleaseForgottenVertexArrays();
+    DeleteDead();
+}
+
+/**
+ * Write a dynamic block to the next segment of its ring. The segment
+ * was last written at least one frame ago, so only its frame fence
+ * is waited for, which has normally passed. A block written more
+ * times in one frame than there are segments orphans its buffer.
+ */
+void GLContext::StreamVBO(IDataBlock* db, VBO& vbo) {
+#ifndef OE_IOS
+#if OE_SAFE
+    if (db->GetVoidDataPtr() == NULL) throw Exception("Cannot update data block with no data.");
+#endif
+    GLenum target = db->GetBlockType();
+    GLsizeiptr size = GLTypeSize(db->GetType()) * db->GetSize() * db->GetDimension();
+    unsigned int next = (vbo.segment + 1) % STREAM_SEGMENTS;
+    BindBuffer(target, vbo.id);
+    if (size > vbo.capacity || vbo.frames[next] == frameCount) {
+        // (re)allocate, dropping the segments in flight
+        if (size > vbo.capacity) vbo.capacity = size;
+        glBufferData(target, vbo.capacity * STREAM_SEGMENTS, NULL, GL_STREAM_DRAW);
+        Account(vbo.bytes, vbo.capacity * STREAM_SEGMENTS);
+        for (unsigned int i = 0; i < STREAM_SEGMENTS; ++i)
+            vbo.frames[i] = 0;
+        next = 0;
+    }
+    else
+        WaitForFrame(vbo.frames[next]);
+
+    vbo.segment = next;
+    vbo.offset = next * vbo.capacity;
+    vbo.frames[next] = frameCount;
+    if (size > 0) {
+        void* dst = glMapBufferRange(target, vbo.offset, size, GL_MAP_WRITE_BIT | 
+                                     GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+        if (dst) {
+            memcpy(dst, db->GetVoidDataPtr(), size);
+            glUnmapBuffer(target);
+            stats.bufferBytes += size;
+        }
+    }
+    CHECK_FOR_GL_ERROR();
+    ++vboGeneration;
+#endif
+}
+
+/**
+ * Wait until the GPU has finished the commands of a frame. Only the
+ * fences of the last few frames are kept, and a later fence implies
+ * the earlier frames are done.
+ */
+void GLContext::WaitForFrame(unsigned int frame) {
+#ifndef OE_IOS
+    if (frame == 0 || frame >= frameCount) return;
+    if (frameCount - frame > STREAM_SEGMENTS) frame = frameCount - STREAM_SEGMENTS;
+    GLsync fence = frameFences[frame % STREAM_SEGMENTS];
+    if (fence == 0) return;
+    while (glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000) == GL_TIMEOUT_EXPIRED);
+#endif
+}
+
+// ------- Uniform blocks -------
+
+GLContext::UniformBlock& GLContext::LookupUniformBlock(const string& name) {
+    map<string, UniformBlock>::iterator it = uniformBlocks.find(name);
+    if (it != uniformBlocks.end()) return it->second;
+    UniformBlock block;
+    block.buffer = 0;
+    block.binding = uniformBlocks.size();
+    return uniformBlocks[name] = block;
+}
+
+void GLContext::UpdateUniformBlock(string name, const void* data, GLsizeiptr size) {
+#if OE_SAFE
+    if (!uniformBufferSupport) throw Exception("Uniform buffers not supported.");
+#endif
+#ifndef OE_IOS
+    UniformBlock& block = LookupUniformBlock(name);
+    bool created = block.buffer == 0;
+    if (created) glGenBuffers(1, &block.buffer);
+    BindBuffer(GL_UNIFORM_BUFFER, block.buffer);
+    // orphan, so draws still reading the previous data need not finish
+    glBufferData(GL_UNIFORM_BUFFER, size, data, GL_STREAM_DRAW);
+    stats.bufferBytes += size;
+    // the binding point keeps the buffer, only the contents change
+    if (created) glBindBufferBase(GL_UNIFORM_BUFFER, block.binding, block.buffer);
+    CHECK_FOR_GL_ERROR();
+#endif
+}
+
+// ------- Memory budget -------
+
+void GLContext::SetMemoryBudget(size_t bytes, unsigned int minAge) {
+    memoryBudget = bytes;
+    evictionAge = minAge;
+}
+
+GLContext::Residents::iterator GLContext::AddResident(ITexture2D* tex, ICubemap* cube, IDataBlock* db) {
+    Resident r;
+    r.texture = tex;
+    r.cubemap = cube;
+    r.block = db;
+    return residents.insert(residents.end(), r);
+}
+
+/**
+ * Mark a resource used this frame, moving it to the back of the
+ * residents.
+ */
+void GLContext::Touch(unsigned int& lastUsed, Residents::iterator lru) {
+    lastUsed = frameCount;
+    residents.splice(residents.end(), residents, lru);
+}
+
+size_t GLContext::GetMemoryUsage() {
+    return memoryUsed;
+}
+
+void GLContext::Account(size_t& bytes, size_t newBytes) {
+    memoryUsed = memoryUsed - bytes + newBytes;
+    bytes = newBytes;
+}
+
+size_t GLContext::TextureBytes(ITexture2D* tex) {
+    size_t bytes = (size_t)tex->GetWidth() * tex->GetHeight() * 
+        tex->GetChannels() * GLTypeSize(tex->GetType());
+    // a full mipmap chain adds a third
+    return tex->UseMipmapping() ? bytes + bytes / 3 : bytes;
+}
+
+size_t GLContext::CubemapBytes(ICubemap* cube) {
+    // uploaded as RGBA32, see LoadCubemap
+    size_t bytes = 0;
+    for (int m = 0; m < cube->MipmapCount(); ++m)
+        bytes += 6 * 4 * (size_t)cube->Width(m) * cube->Height(m);
+    return bytes;
+}
+
+size_t GLContext::PixelBytes(ITexture2D* tex) {
+    return tex->GetChannels() * GLTypeSize(tex->GetType());
+}
+
+/**
+ * Delete the least recently used textures and buffers until the
+ * context is within its budget again. Only resources idle for at
+ * least the eviction age are considered, so a scene larger than the
+ * budget degrades to its working set instead of reuploading every
+ * frame.
+ */
+void GLContext::Evict() {
+    if (memoryBudget == 0 || memoryUsed <= memoryBudget || frameCount <= evictionAge) 
+        return;
+    const unsigned int cutoff = frameCount - evictionAge;
+    // residents are in the order of their last use, so the walk
+    // stops at the first one used within the eviction age.
+    Residents::iterator it = residents.begin();
+    while (it != residents.end() && memoryUsed > memoryBudget) {
+        // step past the resident before evicting, which erases it
+        Resident r = *it++;
+        if (r.texture) {
+            if (textures[r.texture].lastUsed >= cutoff) break;
+            EvictTexture(r.texture);
+        }
+        else if (r.cubemap) {
+            if (cubemaps[r.cubemap].lastUsed >= cutoff) break;
+            EvictCubemap(r.cubemap);
+        }
+        else {
+            if (vbos[r.block].lastUsed >= cutoff) break;
+            EvictVBO(r.block);
+        }
+    }
+}
+
+/**
+ * Textures loaded by the context (no data on first lookup) can be
+ * loaded again, others only while their data is still in memory.
+ */
+bool GLContext::EvictTexture(ITexture2D* tex) {
+    GLTexture& glTex = textures[tex];
+    if (renderTargets.find(tex) != renderTargets.end() ||
+        (streamer && streamer->IsPending(tex)) ||
+        (!glTex.fromSource && tex->GetVoidDataPtr() == NULL))
+        return false;
+    ForgetTexture(tex, true);
+    ++stats.resourcesEvicted;
+    return true;
+}
+
+bool GLContext::EvictCubemap(ICubemap* cube) {
+    if (cube->GetRawData(ICubemap::POSITIVE_X, 0) == NULL) return false;
+    ForgetCubemap(cube);
+    ++stats.resourcesEvicted;
+    return true;
+}
+
+bool GLContext::EvictVBO(IDataBlock* db) {
+    if (db->GetVoidDataPtr() == NULL) return false;
+    ForgetVBO(db, true);
+    ++stats.resourcesEvicted;
+    return true;
+}
+
+// ------- Released resources -------
+
+/**
+ * Drop a texture from the context, queueing its GL texture for
+ * deletion. The events of a destroyed (not alive) texture are gone
+ * with it and are not touched.
+ */
+void GLContext::ForgetTexture(ITexture2D* tex, bool alive) {
+    GLTexture& glTex = textures[tex];
+    deadTextures.push_back(glTex.id);
+    memoryUsed -= glTex.bytes;
+    residents.erase(glTex.lru);
+    if (alive) tex->ChangedEvent().Detach(*this);
+    texParameters.erase(tex);
+    renderTargets.erase(tex);
+    textures.erase(tex);
+}
+
+void GLContext::ForgetCubemap(ICubemap* cube) {
+    GLTexture& glTex = cubemaps[cube];
+    deadTextures.push_back(glTex.id);
+    memoryUsed -= glTex.bytes;
+    residents.erase(glTex.lru);
+    cubemaps.erase(cube);
+}
+
+void GLContext::ForgetVBO(IDataBlock* db, bool alive) {
+    VBO& vbo = vbos[db];
+    if (vbo.arena)
+        (vbo.target == GL_ARRAY_BUFFER ? arrayArena : elementArena).Free(vbo.id, vbo.offset);
+    else
+        deadBuffers.push_back(vbo.id);
+    memoryUsed -= vbo.bytes;
+    residents.erase(vbo.lru);
+    if (!alive) {
+        ReleaseInterleavedBuffers(db);
+        interleavedBlocks.erase(db);
+    }
+    else if (interleavedBlocks.find(db) == interleavedBlocks.end())
+        db->ChangedEvent().Detach(*this);
+    dirtyRanges.erase(db);
+    vbos.erase(db);
+    forgottenBlocks.insert(db);
+    // vertex arrays holding the buffer are rebuilt on next use
+    ++vboGeneration;
+}
+
+/**
+ * Forget the tracked resources whose last reference is gone, see
+ * LookupTexture(ITexture2DPtr).
+ */
+void GLContext::ReleaseDead() {
+    map<ITexture2D*, GLTexture>::iterator tit = textures.begin();
+    while (tit != textures.end()) {
+        map<ITexture2D*, GLTexture>::iterator cur = tit++;
+        if (cur->second.tracked && cur->second.owner.expired()) 
+            ForgetTexture(cur->first, false);
+    }
+    map<ICubemap*, GLTexture>::iterator cit = cubemaps.begin();
+    while (cit != cubemaps.end()) {
+        map<ICubemap*, GLTexture>::iterator cur = cit++;
+        if (cur->second.tracked && cur->second.owner.expired()) 
+            ForgetCubemap(cur->first);
+    }
+    map<IDataBlock*, VBO>::iterator vit = vbos.begin();
+    while (vit != vbos.end()) {
+        map<IDataBlock*, VBO>::iterator cur = vit++;
+        if (cur->second.tracked && cur->second.owner.expired()) 
+            ForgetVBO(cur->first, false);
+    }
+    // interleaved copies of blocks without a VBO of their own
+    set<IDataBlock*> dead;
+    map<vector<IDataBlock*>, InterleavedBuffer>::iterator iit = interleavedBuffers.begin();
+    for (; iit != interleavedBuffers.end(); ++iit) {
+        const vector<boost::weak_ptr<void> >& owners = iit->second.owners;
+        for (unsigned int i = 0; i < owners.size(); ++i)
+            if (owners[i].expired()) dead.insert(iit->first[i]);
+    }
+    for (set<IDataBlock*>::iterator it = dead.begin(); it != dead.end(); ++it) {
+        ReleaseInterleavedBuffers(*it);
+        interleavedBlocks.erase(*it);
+        forgottenBlocks.insert(*it);
+    }
+}
+
+/**
+ * Delete the GL objects released since the last frame.
+ */
+void GLContext::DeleteDead() {
+    bool deleted = false;
+    if (!deadTextures.empty()) {
+        glDeleteTextures(deadTextures.size(), &deadTextures[0]);
+        deadTextures.clear();
+        deleted = true;
+    }
+    if (!deadBuffers.empty()) {
+        glDeleteBuffers(deadBuffers.size(), &deadBuffers[0]);
+        deadBuffers.clear();
+        deleted = true;
+    }
+    if (!deadFramebuffers.empty()) {
+        glDeleteFramebuffers(deadFramebuffers.size(), &deadFramebuffers[0]);
+        deadFramebuffers.clear();
+        deleted = true;
+    }
+    if (!deadVertexArrays.empty()) {
+        glDeleteVertexArrays(deadVertexArrays.size(), &deadVertexArrays[0]);
+        deadVertexArrays.clear();
+        deleted = true;
+    }
+    for (unsigned int i = 0; i < deadPrograms.size(); ++i)
+        ReleaseProgram(deadPrograms[i]);
+    deadPrograms.clear();
+    // deleted ids may be handed out again
+    if (deleted) InvalidateState();
+    CHECK_FOR_GL_ERROR();
+}
+
+void GLContext::ReleaseCanvas(ICanvas* can) {
+    map<ICanvas*, GLuint>::iterator fit = fbos.find(can);
+    if (fit != fbos.end()) {
+        deadFramebuffers.push_back(fit->second);
+        fbos.erase(fit);
+    }
+    map<ICanvas*, Attachments>::iterator ait = attachments.find(can);
+    if (ait == attachments.end()) return;
+    ITexture2D* atts[3] = { ait->second.color0.get(), 
+                            ait->second.color1.get(), 
+                            ait->second.depth.get() };
+    for (unsigned int i = 0; i < 3; ++i) {
+        if (atts[i] == NULL) continue;
+        renderTargets.erase(atts[i]);
+        if (textures.find(atts[i]) != textures.end())
+            ForgetTexture(atts[i], true);
+    }
+    attachments.erase(ait);
+}
+
+/**
+ * Upload the changed ranges of a block to its VBO and the
+ * interleaved buffers containing it. Overlapping ranges, and ranges
+ * separated by less than a few hundred bytes, are merged so each
+ * upload call carries a reasonable amount of data.
+ */
+void GLContext::FlushRanges(IDataBlock* db, Ranges& ranges) {
+#if OE_SAFE
+    if (db->GetVoidDataPtr() == NULL) throw Exception("Cannot update data block with no data.");
+#endif
+    const unsigned int elmSize = GLTypeSize(db->GetType()) * db->GetDimension();
+    if (elmSize == 0) {
+        // no gap to measure in elements, so flush the whole block
+        ranges.assign(1, std::make_pair(0u, db->GetSize()));
+    }
+    else {
+        const unsigned int gap = 256 / elmSize;
+        std::sort(ranges.begin(), ranges.end());
+        unsigned int merged = 0;
+        for (unsigned int i = 1; i < ranges.size(); ++i) {
+            if (ranges[i].first <= ranges[merged].second + gap)
+                ranges[merged].second = std::max(ranges[merged].second, ranges[i].second);
+            else
+                ranges[++merged] = ranges[i];
+        }
+        ranges.resize(merged + 1);
+    }
+
+    const char* data = (const char*)db->GetVoidDataPtr();
+    map<IDataBlock*, VBO>::iterator vit = vbos.find(db);
+    if (vit != vbos.end() && vit->second.stream) {
+        // a new segment needs the whole block
+        StreamVBO(db, vit->second);
+    }
+    else if (vit != vbos.end()) {
+        BindBuffer(db->GetBlockType(), vit->second.id);
+        for (unsigned int i = 0; i < ranges.size(); ++i) {
+            unsigned int first = ranges[i].first;
+            unsigned int last = std::min(ranges[i].second, db->GetSize());
+            if (first >= last) continue;
+            glBufferSubData(db->GetBlockType(), vit->second.offset + first * elmSize,
+                            (last - first) * elmSize, data + first * elmSize);
+            stats.bufferBytes += (last - first) * elmSize;
+        }
+        CHECK_FOR_GL_ERROR();
+    }
+
+    // interleaved vertices are rewritten from all their blocks
+    vector<char> scratch;
+    map<vector<IDataBlock*>, InterleavedBuffer>::iterator it = interleavedBuffers.begin();
+    for (; it != interleavedBuffers.end(); ++it) {
+        const vector<IDataBlock*>& blocks = it->first;
+        InterleavedBuffer& ib = it->second;
+        if (ib.id == 0 || std::find(blocks.begin(), blocks.end(), db) == blocks.end()) continue;
+        BindBuffer(GL_ARRAY_BUFFER, ib.id);
+        for (unsigned int i = 0; i < ranges.size(); ++i) {
+            unsigned int first = ranges[i].first;
+            unsigned int last = std::min(ranges[i].second, db->GetSize());
+            if (first >= last) continue;
+            scratch.resize((last - first) * ib.stride);
+            for (unsigned int b = 0; b < blocks.size(); ++b) {
+                unsigned int size = GLTypeSize(blocks[b]->GetType()) * blocks[b]->GetDimension();
+                const char* src = (const char*)blocks[b]->GetVoidDataPtr() + first * size;
+                char* dst = &scratch[0] + ib.offsets[b];
+                for (unsigned int v = first; v < last; ++v, src += size, dst += ib.stride)
+                    memcpy(dst, src, size);
+            }
+            glBufferSubData(GL_ARRAY_BUFFER, first * ib.stride, scratch.size(), &scratch[0]);
+            stats.bufferBytes += scratch.size();
+        }
+        CHECK_FOR_GL_ERROR();
+    }
+
+    if (db->GetUnloadPolicy() == UNLOAD_AUTOMATIC && 
+        interleavedBlocks.find(db) == interleavedBlocks.end())
+        db->Unload();
 }
 
 
@@ -483,13 +1296,49 @@ void PrintProgramInfoLog(GLuint program) {
     }
 }
 
-GLuint GLContext::LoadShader(Shader* shad) {
+GLuint GLContext::LoadShader(Shader* shad, bool async) {
 #if OE_SAFE
     if (!shaderSupport) throw Exception("Shaders not supported.");
     if (shad == NULL) throw Exception("Cannot load NULL shader.");
 #endif
 
-    GLuint shaderId = glCreateProgram();
+#ifdef OE_IOS
+    string iosHeader = string("precision mediump float;\n");
+#endif
+    string vertexShader = shad->GetVertexShader();
+    string fragmentShader = shad->GetFragmentShader();
+#ifdef OE_IOS
+    vertexShader = iosHeader + vertexShader;
+    fragmentShader = iosHeader + fragmentShader;
+#endif
+
+    // shaders differing only in uniform values and bound data share
+    // their program.
+    string source = vertexShader + '\0' + fragmentShader;
+    map<string, GLuint>::iterator pit = programIds.find(source);
+    if (pit != programIds.end()) {
+        GLuint id = pit->second;
+        SharedProgram& prog = programs[id];
+        ++prog.refs;
+        if (!async && !prog.ready) {
+            WaitForProgram(id);
+            if (!prog.ready) {
+                ReleaseProgram(id);
+                throw Exception("Failed to link shader program");
+            }
+        }
+        return id;
+    }
+
+    if (programCache == NULL && !programCacheDir.empty() && ProgramCache::IsSupported())
+        programCache = new ProgramCache(programCacheDir);
+    GLuint shaderId = programCache ? programCache->Load(vertexShader, fragmentShader) : 0;
+    if (shaderId) {
+        RegisterProgram(shaderId, source, true);
+        return shaderId;
+    }
+
+    shaderId = glCreateProgram();
     GLuint vertexId = glCreateShader(GL_VERTEX_SHADER);
     GLuint fragmentId = glCreateShader(GL_FRAGMENT_SHADER);
     
@@ -505,16 +1354,22 @@ GLuint GLContext::LoadShader(Shader* shad) {
     glAttachShader(shaderId, fragmentId);
     CHECK_FOR_GL_ERROR();
 
-#ifdef OE_IOS
-    string iosHeader = string("precision mediump float;\n");
-#endif
+    if (async) {
+        RegisterProgram(shaderId, source, false);
+        PendingProgram& pending = pendingPrograms[shaderId];
+        pending.vertexId = vertexId;
+        pending.fragmentId = fragmentId;
+        pending.vertexShader = vertexShader;
+        pending.fragmentShader = fragmentShader;
+        pending.started = false;
+        // without parallel compile support the driver would block, so
+        // the compile waits for the start of the next frame.
+        if (parallelCompileSupport) StartCompile(shaderId, pending);
+        return shaderId;
+    }
 
     // compile vertex shader
     const GLchar* shaderBits[1];
-    string vertexShader = shad->GetVertexShader();
-#ifdef OE_IOS
-    vertexShader = iosHeader + vertexShader;
-#endif
     shaderBits[0] = vertexShader.c_str();
     glShaderSource(vertexId, 1, shaderBits, NULL);
     glCompileShader(vertexId);
@@ -534,10 +1389,6 @@ GLuint GLContext::LoadShader(Shader* shad) {
 #endif
 
     // compile fragment shader
-    string fragmentShader = shad->GetFragmentShader();;
-#ifdef OE_IOS
-    fragmentShader = iosHeader + fragmentShader;
-#endif
     shaderBits[0] = fragmentShader.c_str();
     glShaderSource(fragmentId, 1, shaderBits, NULL);
     glCompileShader(fragmentId);
@@ -555,21 +1406,280 @@ GLuint GLContext::LoadShader(Shader* shad) {
 #endif
 
     // Link the program object and print out the info log
+#ifndef OE_IOS
+    if (programCache)
+        glProgramParameteri(shaderId, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+#endif
     glLinkProgram(shaderId);
-#if OE_SAFE
     GLint linked;
     glGetProgramiv(shaderId, GL_LINK_STATUS, &linked);
+#if OE_SAFE
     if(linked == GL_FALSE) {
         PrintProgramInfoLog(shaderId);
         throw Exception("Failed to link shader program");
     }
 #endif
     CHECK_FOR_GL_ERROR();
+    if (programCache && linked == GL_TRUE) 
+        programCache->Store(shaderId, vertexShader, fragmentShader);
+
+    RegisterProgram(shaderId, source, true);
     return shaderId;
 }
 
+void GLContext::RegisterProgram(GLuint id, const string& source, bool ready) {
+    SharedProgram& prog = programs[id];
+    prog.source = source;
+    prog.refs = 1;
+    prog.owner = NULL;
+    prog.ready = ready;
+    prog.failed = false;
+    programIds[source] = id;
+}
+
+/**
+ * Issue the compile and link of a pending program without querying
+ * the results, which would wait for them.
+ */
+void GLContext::StartCompile(GLuint id, PendingProgram& pending) {
+    const GLchar* shaderBits[1];
+    shaderBits[0] = pending.vertexShader.c_str();
+    glShaderSource(pending.vertexId, 1, shaderBits, NULL);
+    glCompileShader(pending.vertexId);
+    shaderBits[0] = pending.fragmentShader.c_str();
+    glShaderSource(pending.fragmentId, 1, shaderBits, NULL);
+    glCompileShader(pending.fragmentId);
+#ifndef OE_IOS
+    if (programCache)
+        glProgramParameteri(id, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+#endif
+    glLinkProgram(id);
+    CHECK_FOR_GL_ERROR();
+    pending.started = true;
+}
+
+/**
+ * Query the link result of a pending program, waiting for it if
+ * needed. Failed programs stay not ready and are logged.
+ */
+void GLContext::FinishCompile(GLuint id, PendingProgram& pending) {
+    if (!pending.started) StartCompile(id, pending);
+    GLint linked;
+    glGetProgramiv(id, GL_LINK_STATUS, &linked);
+    if (linked == GL_FALSE) {
+        GLuint ids[2] = { pending.vertexId, pending.fragmentId };
+        for (unsigned int i = 0; i < 2; ++i) {
+            GLint compiled;
+            glGetShaderiv(ids[i], GL_COMPILE_STATUS, &compiled);
+            if (compiled == GL_TRUE) continue;
+            const int maxBufSize = 1024;
+            char buffer[maxBufSize];
+            glGetShaderInfoLog(ids[i], maxBufSize, NULL, buffer);
+            logger.error << "compile errors:\n" << buffer << logger.end;
+        }
+        PrintProgramInfoLog(id);
+        logger.error << "Failed to link shader program" << logger.end;
+        programs[id].failed = true;
+        return;
+    }
+    if (programCache) 
+        programCache->Store(id, pending.vertexShader, pending.fragmentShader);
+    programs[id].ready = true;
+}
+
+void GLContext::WaitForProgram(GLuint id) {
+    map<GLuint, PendingProgram>::iterator it = pendingPrograms.find(id);
+    if (it == pendingPrograms.end()) return;
+    FinishCompile(id, it->second);
+    pendingPrograms.erase(it);
+}
+
+// programs compiled per frame without parallel compile support
+static const unsigned int MAX_DEFERRED_COMPILES = 2;
+
+/**
+ * Finish the programs the driver is done with, and start a few of
+ * the deferred ones. Without parallel compile support a started
+ * program is finished the frame after, giving a driver which links
+ * in the background a frame to do so.
+ */
+void GLContext::PollPrograms() {
+    unsigned int compiled = 0;
+    map<GLuint, PendingProgram>::iterator it = pendingPrograms.begin();
+    while (it != pendingPrograms.end()) {
+        PendingProgram& pending = it->second;
+        GLint done = GL_FALSE;
+        if (!pending.started) {
+            if (compiled++ < MAX_DEFERRED_COMPILES) StartCompile(it->first, pending);
+        }
+        else if (!parallelCompileSupport)
+            done = GL_TRUE;
+#ifndef OE_IOS
+        else
+            glGetProgramiv(it->first, GL_COMPLETION_STATUS_KHR, &done);
+#endif
+        if (done) {
+            FinishCompile(it->first, pending);
+            pendingPrograms.erase(it++);
+        }
+        else ++it;
+    }
+}
+
+void GLContext::SetAsyncCompile(bool enable) {
+    asyncCompile = enable;
+}
+
+/**
+ * Draw a shader still compiling with a plain shader, using its
+ * vertices and either its modelview projection matrix or its per
+ * instance modelview matrices and projection. Returns 0 if the
+ * shader has none of these.
+ */
+GLuint GLContext::ApplyFallback(Shader* shader) {
+    Box<IDataBlockPtr>* vertexBox = shader->FindAttribute("vertex");
+    if (vertexBox == NULL || !vertexBox->Get()) return 0;
+
+    FallbackKind kind = FALLBACK_PLAIN;
+    Uniform* matrix = shader->FindUniform("modelViewProjectionMatrix");
+    Box<IDataBlockPtr>* instanceBox = shader->FindAttribute("instanceModelViewMatrix");
+    IDataBlockPtr instances;
+    if (instanceBox) {
+        instances = instanceBox->Get();
+        if (!instancingSupport || !instances || instances->GetDimension() != 16 ||
+            shader->GetAttributeDivisor("instanceModelViewMatrix") != 1)
+            return 0;
+        // the projection is a uniform or the first member of the
+        // FrameData block
+        matrix = shader->FindUniform("projectionMatrix");
+        if (matrix) kind = FALLBACK_INSTANCED;
+        else if (uniformBufferSupport && uniformBlocks.count("FrameData"))
+            kind = FALLBACK_INSTANCED_BLOCK;
+        else return 0;
+    }
+    else if (matrix == NULL) return 0;
+    if (matrix && matrix->GetKind() != Uniform::MAT4X4) return 0;
+
+    Fallback& fb = LookupFallback(kind);
+    GLShader& glshader = LookupShader(fb.shader);
+    if (!glshader.resolved || fb.vertex < 0 || (instances && fb.instance < 0)) return 0;
+    UseProgram(glshader.id);
+
+    // bound directly, as a vertex array or interleaved buffer for
+    // every pending mesh would only fill up the caches.
+    GLint first = fb.instance, last = instances ? fb.instance + 3 : -1;
+    for (GLint i = 0; i < (GLint)state.attribArrays.size(); ++i)
+        if (i != fb.vertex && (i < first || i > last)) DisableVertexAttribArray(i);
+    IDataBlockPtr vertices = vertexBox->Get();
+    const char* base = BindFallbackArray(vertices);
+    VertexAttribPointer(fb.vertex, vertices->GetDimension(), vertices->GetType(), 0, base);
+    EnableVertexAttribArray(fb.vertex);
+    VertexAttribDivisor(fb.vertex, 0);
+    if (instances) {
+        // a column per location, as in Apply
+        GLsizei columnSize = 4 * GLTypeSize(instances->GetType());
+        base = BindFallbackArray(instances);
+        for (GLint c = 0; c < 4; ++c) {
+            VertexAttribPointer(fb.instance + c, 4, instances->GetType(), 4 * columnSize, base + c * columnSize);
+            EnableVertexAttribArray(fb.instance + c);
+            VertexAttribDivisor(fb.instance + c, 1);
+        }
+    }
+
+    if (matrix && fb.matrix >= 0) {
+        glUniformMatrix4fv(fb.matrix, 1, GL_FALSE, matrix->GetData().fv);
+        ++stats.uniformUploads;
+    }
+    CHECK_FOR_GL_ERROR();
+    return glshader.id;
+}
+
+/**
+ * The fallback program of a kind, linked on first use.
+ */
+GLContext::Fallback& GLContext::LookupFallback(FallbackKind kind) {
+    Fallback& fb = fallbacks[kind];
+    if (fb.shader) return fb;
+
+    string vertex;
+    if (kind == FALLBACK_PLAIN)
+        vertex = "attribute vec3 vertex;\n"
+            "uniform mat4 modelViewProjectionMatrix;\n"
+            "void main() {\n"
+            "  gl_Position = modelViewProjectionMatrix * vec4(vertex, 1.0);\n"
+            "}\n";
+    else {
+        if (kind == FALLBACK_INSTANCED_BLOCK)
+            // only the head of the block, which std140 lays out the same
+            vertex = "#extension GL_ARB_uniform_buffer_object : require\n"
+                "layout(std140) uniform FrameData {\n"
+                "  mat4 projectionMatrix;\n"
+                "};\n";
+        else
+            vertex = "uniform mat4 projectionMatrix;\n";
+        vertex += "attribute vec3 vertex;\n"
+            "attribute mat4 instanceModelViewMatrix;\n"
+            "void main() {\n"
+            "  gl_Position = projectionMatrix * (instanceModelViewMatrix * vec4(vertex, 1.0));\n"
+            "}\n";
+    }
+    fb.shader = new Shader(vertex,
+                           "void main() {\n"
+                           "  gl_FragColor = vec4(0.5, 0.5, 0.5, 1.0);\n"
+                           "}\n");
+    GLuint id = LookupShader(fb.shader).id;
+    fb.matrix = glGetUniformLocation(id, kind == FALLBACK_PLAIN ? "modelViewProjectionMatrix" : "projectionMatrix");
+    fb.vertex = glGetAttribLocation(id, "vertex");
+    fb.instance = kind == FALLBACK_PLAIN ? -1 : glGetAttribLocation(id, "instanceModelViewMatrix");
+    CHECK_FOR_GL_ERROR();
+    return fb;
+}
+
+/**
+ * Bind the buffer holding a fallback attribute, returning the
+ * pointer to give VertexAttribPointer.
+ */
+const char* GLContext::BindFallbackArray(const IDataBlockPtr& db) {
+    if (vboSupport) {
+        VBO& vbo = LookupBuffer(db);
+        BindBuffer(GL_ARRAY_BUFFER, vbo.id);
+        return (const char*)NULL + vbo.offset;
+    }
+    BindBuffer(GL_ARRAY_BUFFER, 0);
+    return (const char*)db->GetVoidData();
+}
+
+void GLContext::ReleaseFallbacks() {
+    for (unsigned int i = 0; i < FALLBACK_KINDS; ++i) {
+        delete fallbacks[i].shader;
+        fallbacks[i].shader = NULL;
+    }
+}
+
+/**
+ * Drop a reference to a shared program, deleting it with its shader
+ * objects when unused.
+ */
+void GLContext::ReleaseProgram(GLuint id) {
+    map<GLuint, SharedProgram>::iterator it = programs.find(id);
+    if (it == programs.end() || --it->second.refs > 0) return;
+    programIds.erase(it->second.source);
+    programs.erase(it);
+    pendingPrograms.erase(id);
+
+    GLuint shads[2];
+    GLsizei count;
+    glGetAttachedShaders(id, 2, &count, shads);
+    for (GLsizei i = 0; i < count; ++i) {
+        glDeleteShader(shads[i]);
+    }
+    if (state.program == id) UseProgram(0);
+    glDeleteProgram(id);
+}
+
 void GLContext::BindUniform(Uniform& uniform, GLint loc) {
     const Uniform::Data data = uniform.GetData();
+    ++stats.uniformUploads;
     switch (uniform.GetKind()) {
     case Uniform::INT:
         glUniform1i(loc, data.i);
@@ -604,6 +1714,8 @@ void GLContext::BindUniform(Uniform& uniform, GLint loc) {
 GLContext::GLShader GLContext::ResolveLocations(GLuint id, Shader* shad) {
     GLContext::GLShader glshader;
     glshader.id = id;
+    glshader.program = NULL;
+    glshader.resolved = true;
     
     GLint count, maxLength;
     glGetProgramiv(id,
@@ -646,7 +1758,7 @@ GLContext::GLShader GLContext::ResolveLocations(GLuint id, Shader* shad) {
     } 
     delete[] name; 
 
-    glUseProgram(glshader.id);
+    UseProgram(glshader.id);
     // bind the uniforms set at resolve time
     for (map<Uniform*, GLint>::iterator it = glshader.uniforms.begin();
          it != glshader.uniforms.end(); ++it) {
@@ -670,7 +1782,20 @@ GLContext::GLShader GLContext::ResolveLocations(GLuint id, Shader* shad) {
         CHECK_FOR_GL_ERROR();
         ++texUnit;
     }
-    glUseProgram(0);
+    UseProgram(0);
+
+#ifndef OE_IOS
+    // bind the uniform blocks to the buffers of their names
+    GLint blocks = 0;
+    if (uniformBufferSupport) glGetProgramiv(id, GL_ACTIVE_UNIFORM_BLOCKS, &blocks);
+    for (GLint i = 0; i < blocks; ++i) {
+        char blockName[64];
+        GLsizei length = 0;
+        glGetActiveUniformBlockName(id, i, sizeof(blockName), &length, blockName);
+        glUniformBlockBinding(id, i, LookupUniformBlock(string(blockName, length)).binding);
+    }
+    CHECK_FOR_GL_ERROR();
+#endif
 
     // Attributes
     glGetProgramiv(id,
@@ -692,34 +1817,65 @@ GLContext::GLShader GLContext::ResolveLocations(GLuint id, Shader* shad) {
         GLint loc = glGetAttribLocation(id, name);
         if (loc == -1) continue;
         glshader.attributes.push_back(make_pair(&shad->GetAttribute(string(name)), loc)); 
+        glshader.divisors.push_back(shad->GetAttributeDivisor(string(name)));
     } 
     delete[] name; 
 
     return glshader;
 }
 
-GLContext::GLShader GLContext::LookupShader(Shader* shad) {
+GLContext::GLShader& GLContext::LookupShader(Shader* shad) {
+    return LookupShader(shad, true);
+}
+
+GLContext::GLShader& GLContext::LookupShader(Shader* shad, bool wait) {
     map<Shader*, GLShader>::iterator it = shaders.find(shad);
-    if (it != shaders.end())
-        return (*it).second;
-    GLuint id = LoadShader(shad);
-    GLContext::GLShader glshader = ResolveLocations(id, shad);
-    shaders[shad] = glshader;
-    shad->ChangedEvent().Attach(*this);
-    shad->UniformChangedEvent().Attach(*this);
+    if (it == shaders.end()) {
+        // lookups of known shaders are too frequent to profile
+        OE_PROFILE_SCOPE("GLContext::LookupShader");
+        bool async = asyncCompile;
+        for (unsigned int i = 0; i < FALLBACK_KINDS; ++i)
+            if (shad == fallbacks[i].shader) async = false;
+        GLuint id = LoadShader(shad, async);
+        GLContext::GLShader& glshader = shaders[shad];
+        glshader.id = id;
+        glshader.program = &programs[id];
+        glshader.resolved = false;
+        shad->ChangedEvent().Attach(*this);
+        shad->UniformChangedEvent().Attach(*this);
+        shad->DestroyedEvent().Attach(*this);
+        it = shaders.find(shad);
+        ++stats.resourcesCreated;
+    }
+    GLContext::GLShader& glshader = it->second;
+    if (!glshader.resolved) {
+        SharedProgram* prog = glshader.program;
+        if (!prog->ready && wait) WaitForProgram(glshader.id);
+        if (prog->ready) {
+            glshader = ResolveLocations(glshader.id, shad);
+            glshader.program = prog;
+            prog->owner = shad;
+        }
+    }
     return glshader;
 }
 
 void GLContext::ReleaseTextures() {
-    map<ITexture2D*, GLuint>::iterator it = textures.begin();
+    map<ITexture2D*, GLTexture>::iterator it = textures.begin();
     for (; it != textures.end(); ++it) {
-        glDeleteTextures(1, &it->second);
+        glDeleteTextures(1, &it->second.id);
+        memoryUsed -= it->second.bytes;
+        residents.erase(it->second.lru);
         it->first->ChangedEvent().Detach(*this);
     }
+    texParameters.clear();
+    if (streamer) streamer->Clear();
     
-    map<ICubemap*, GLuint>::iterator it4 = cubemaps.begin();
+    map<ICubemap*, GLTexture>::iterator it4 = cubemaps.begin();
     for (; it4 != cubemaps.end(); ++it4) {
-        glDeleteTextures(1, &it4->second);
+        glDeleteTextures(1, &it4->second.id);
+        memoryUsed -= it4->second.bytes;
+        residents.erase(it4->second.lru);
     }
     
     // also release fbos since attachments where released
@@ -731,15 +1887,46 @@ void GLContext::ReleaseTextures() {
     textures.clear();
     cubemaps.clear();
     fbos.clear();
+    InvalidateState();
 }
 
 void GLContext::ReleaseVBOs() {
-    map<IDataBlock*, GLuint>::iterator it = vbos.begin();
+    ReleaseInterleavedBuffers(NULL);
+    set<IDataBlock*>::iterator bit = interleavedBlocks.begin();
+    for (; bit != interleavedBlocks.end(); ++bit) {
+        if (vbos.find(*bit) == vbos.end()) 
+            (*bit)->ChangedEvent().Detach(*this);
+    }
+    interleavedBlocks.clear();
+
+    map<IDataBlock*, VBO>::iterator it = vbos.begin();
     for (; it != vbos.end(); ++it) {
-        glDeleteBuffers(1, &it->second);
+        if (!it->second.arena) glDeleteBuffers(1, &it->second.id);
+        memoryUsed -= it->second.bytes;
+        residents.erase(it->second.lru);
         it->first->ChangedEvent().Detach(*this);
     }
     vbos.clear();
+    dirtyRanges.clear();
+    arrayArena.Release();
+    elementArena.Release();
+    // binding points stay, as programs refer to them
+    map<string, UniformBlock>::iterator uit = uniformBlocks.begin();
+    for (; uit != uniformBlocks.end(); ++uit) {
+        if (uit->second.buffer) glDeleteBuffers(1, &uit->second.buffer);
+        uit->second.buffer = 0;
+    }
+    // every vertex array refers to a released buffer
+    map<Shader*, VertexArrays>::iterator vit = vertexArrays.begin();
+    for (; vit != vertexArrays.end(); ++vit) {
+        VertexArrays::iterator va = vit->second.begin();
+        for (; va != vit->second.end(); ++va)
+            deadVertexArrays.push_back(va->second.id);
+    }
+    vertexArrays.clear();
+    forgottenBlocks.clear();
+    ++vboGeneration;
+    InvalidateState();
 }
 
 void GLContext::ReleaseShaders() {
@@ -747,45 +1934,66 @@ void GLContext::ReleaseShaders() {
     for (; it != shaders.end(); ++it) {
         it->first->ChangedEvent().Detach(*this);
         it->first->UniformChangedEvent().Detach(*this);
-        GLuint shads[2];
-        GLsizei count;
-        glGetAttachedShaders(it->second.id, 2, &count, shads);
-        for (GLsizei i = 0; i < count; ++i) {
-            glDeleteShader(shads[i]);
-        }
-        glDeleteProgram(it->second.id);
+        it->first->DestroyedEvent().Detach(*this);
+        ReleaseProgram(it->second.id);
+        ReleaseVertexArrays(it->first);
     }
     shaders.clear();
     uniformQueue.clear();
+    ReleaseFallbacks();
+    InvalidateState();
+}
+
+/**
+ * Drop a destroyed shader right away, as a new shader may be
+ * allocated at its address, and delete its program and vertex arrays
+ * at the next BeginFrame.
+ */
+void GLContext::Handle(Shader::DestroyedEventArg arg) {
+    map<Shader*, GLShader>::iterator it = shaders.find(arg.shader);
+    if (it == shaders.end()) return;
+    deadPrograms.push_back(it->second.id);
+    map<GLuint, SharedProgram>::iterator pit = programs.find(it->second.id);
+    if (pit != programs.end() && pit->second.owner == arg.shader) 
+        pit->second.owner = NULL;
+    shaders.erase(it);
+    uniformQueue.erase(arg.shader);
+
+    map<Shader*, VertexArrays>::iterator vit = vertexArrays.find(arg.shader);
+    if (vit == vertexArrays.end()) return;
+    VertexArrays::iterator itr = vit->second.begin();
+    for (; itr != vit->second.end(); ++itr)
+        deadVertexArrays.push_back(itr->second.id);
+    vertexArrays.erase(vit);
 }
 
 void GLContext::Handle(Shader::ChangedEventArg arg) {
     // logger.info << "shader changed" << logger.end;
     GLuint newid;
     try {
-        newid = LoadShader(arg.shader);
+        newid = LoadShader(arg.shader, false);
     }
     catch (Exception e) {
         logger.error << e.what() << " Using previously working shader." << logger.end;
         return;
     }
 
-    GLuint oldid = shaders[arg.shader].id;
-
-    GLuint shads[2];
-    GLsizei count;
-    glGetAttachedShaders(oldid, 2, &count, shads);
-    for (GLsizei i = 0; i < count; ++i) {
-        glDeleteShader(shads[i]);
-    }
-    glDeleteProgram(oldid);
-    shaders[arg.shader] = ResolveLocations(newid, arg.shader);
+    ReleaseProgram(shaders[arg.shader].id);
+    GLShader& glshader = shaders[arg.shader];
+    glshader = ResolveLocations(newid, arg.shader);
+    glshader.program = &programs[newid];
+    glshader.program->owner = arg.shader;
+    uniformQueue.erase(arg.shader);
+    // attribute locations may have moved
+    ReleaseVertexArrays(arg.shader);
 }
 
 void GLContext::Handle(Uniform::ChangedEventArg arg) {
     // logger.info << "changed" << logger.end;
-    // Queue uniform for reloading
-    const GLContext::GLShader glshader = LookupShader(arg.shader);
+    // Queue uniform for reloading. Pending shaders are not waited
+    // for, their first Apply binds all uniforms.
+    const GLContext::GLShader& glshader = LookupShader(arg.shader, false);
+    if (!glshader.resolved) return;
     map<Uniform*, GLint>::const_iterator it = glshader.uniforms.find(arg.uniform);
     if (it == glshader.uniforms.end())
         return;
@@ -794,9 +2002,11 @@ void GLContext::Handle(Uniform::ChangedEventArg arg) {
 
 void GLContext::Handle(Texture2DChangedEventArg arg) {
     ITexture2D* texr = arg.resource.get();
+    // the pending upload will carry the change
+    if (streamer && streamer->IsPending(texr)) return;
     //reload texture
     GLuint texid = LookupTexture(texr);
-    glBindTexture(GL_TEXTURE_2D, texid);
+    BindTexture(GL_TEXTURE_2D, texid);
     CHECK_FOR_GL_ERROR();
 
     // Setup texture parameters
@@ -804,32 +2014,112 @@ void GLContext::Handle(Texture2DChangedEventArg arg) {
 
     GLenum colorFormat = GLColorFormat(texr->GetColorFormat());
 
-    glTexSubImage2D(GL_TEXTURE_2D,
-                    0,
-                    arg.xOffset,
-                    arg.yOffset,
-                    texr->GetWidth(),
-                    texr->GetHeight(),
-                    colorFormat,
-                    texr->GetType(),
+    // the changed rectangle, an empty one meaning the rest of the texture
+    unsigned int texWidth = texr->GetWidth(), texHeight = texr->GetHeight();
+    unsigned int x = std::min(arg.xOffset, texWidth), y = std::min(arg.yOffset, texHeight);
+    unsigned int width = arg.width ? std::min(arg.width, texWidth - x) : texWidth - x;
+    unsigned int height = arg.height ? std::min(arg.height, texHeight - y) : texHeight - y;
+    if (width == 0 || height == 0) {
+        BindTexture(GL_TEXTURE_2D, 0);
+        return;
+    }
+
+    // the data holds the whole texture, so the rectangle is picked
+    // out of it with the unpack state.
+    PixelStore(GL_UNPACK_ALIGNMENT, 1);
+#ifdef OE_IOS
+    // no row length in es 2, upload whole rows instead.
+    unsigned int rowSize = texWidth * texr->GetChannels() * GLTypeSize(texr->GetType());
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, y, texWidth, height,
+                    colorFormat, texr->GetType(),
+                    (const char*)texr->GetVoidDataPtr() + y * rowSize);
+    stats.textureBytes += texWidth * height * PixelBytes(texr);
+#else
+    PixelStore(GL_UNPACK_ROW_LENGTH, texWidth);
+    PixelStore(GL_UNPACK_SKIP_PIXELS, x);
+    PixelStore(GL_UNPACK_SKIP_ROWS, y);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, x, y, width, height,
+                    colorFormat, texr->GetType(),
                     texr->GetVoidDataPtr());
+    stats.textureBytes += width * height * PixelBytes(texr);
+    PixelStore(GL_UNPACK_ROW_LENGTH, 0);
+    PixelStore(GL_UNPACK_SKIP_PIXELS, 0);
+    PixelStore(GL_UNPACK_SKIP_ROWS, 0);
+#endif
     CHECK_FOR_GL_ERROR();
-    glBindTexture(GL_TEXTURE_2D, 0);
+    BindTexture(GL_TEXTURE_2D, 0);
 }
 
 void GLContext::Handle(IDataBlockChangedEventArg arg) {    
-    IDataBlock* bo = arg.resource.get();
-    GLuint id = bo->GetID();
-    
-    glBindBuffer(bo->GetBlockType(), id);
+    IDataBlock* db = arg.resource.get();
+    // changed ranges are uploaded at the start of the next frame
+    if (dirtyRanges.find(db) != dirtyRanges.end()) return;
+    // interleaved copies are rebuilt on next use
+    if (interleavedBlocks.find(db) != interleavedBlocks.end())
+        ReleaseInterleavedBuffers(db);
+    if (vbos.find(db) != vbos.end())
+        UpdateVBO(db);
+}
+
+void GLContext::UpdateVBO(IDataBlock* bo) {
+    map<IDataBlock*, VBO>::iterator it = vbos.find(bo);
+    if (it == vbos.end()) {
+        // first use uploads the data
+        LookupVBO(bo);
+        return;
+    }
+#if OE_SAFE
+    if (bo->GetVoidDataPtr() == NULL) throw Exception("Cannot update data block with no data.");
+#endif
+    VBO& vbo = it->second;
+    unsigned int size = GLTypeSize(bo->GetType()) * bo->GetSize() * bo->GetDimension();
+    if (vbo.stream) {
+        StreamVBO(bo, vbo);
+        if (bo->GetUnloadPolicy() == UNLOAD_AUTOMATIC)
+            bo->Unload();
+        return;
+    }
+    if (vbo.arena) {
+        BufferArena* arena = LookupArena(bo);
+        if (arena == NULL || (GLsizeiptr)size > arena->GetSize(vbo.id, vbo.offset)) {
+            // grown (or no longer static), so move the block.
+            if (arena == NULL) arena = bo->GetBlockType() == ARRAY ? &arrayArena : &elementArena;
+            arena->Free(vbo.id, vbo.offset);
+            memoryUsed -= vbo.bytes;
+            VBO moved = LoadVBO(bo);
+            moved.lru = vbo.lru;
+            moved.tracked = vbo.tracked;
+            moved.owner = vbo.owner;
+            vbo = moved;
+            Touch(vbo.lastUsed, vbo.lru);
+            return;
+        }
+        BindBuffer(bo->GetBlockType(), vbo.id);
+        glBufferSubData(bo->GetBlockType(), vbo.offset, size, bo->GetVoidDataPtr());
+        CHECK_FOR_GL_ERROR();
+        stats.bufferBytes += size;
+        BindBuffer(bo->GetBlockType(), 0);
+        if (bo->GetUnloadPolicy() == UNLOAD_AUTOMATIC)
+            bo->Unload();
+        return;
+    }
+    BindBuffer(bo->GetBlockType(), vbo.id);
     CHECK_FOR_GL_ERROR();
         
-    unsigned int size = GLTypeSize(bo->GetType()) * bo->GetSize() * bo->GetDimension();
     GLenum access = GLAccessType(bo->GetBlockType(), bo->GetUpdateMode());
-    glBufferData(bo->GetBlockType(), 
-                 size,
-                 bo->GetVoidDataPtr(), access);
-    glBindBuffer(bo->GetBlockType(), 0);
+    if (bo->GetUpdateMode() == DYNAMIC) {
+        // orphan the old storage so the driver need not wait for
+        // draws still reading it.
+        glBufferData(bo->GetBlockType(), size, NULL, access);
+        glBufferSubData(bo->GetBlockType(), 0, size, bo->GetVoidDataPtr());
+    }
+    else
+        glBufferData(bo->GetBlockType(), 
+                     size,
+                     bo->GetVoidDataPtr(), access);
+    Account(vbo.bytes, size);
+    stats.bufferBytes += size;
+    BindBuffer(bo->GetBlockType(), 0);
     
     if (bo->GetUnloadPolicy() == UNLOAD_AUTOMATIC)
         bo->Unload();
@@ -838,90 +2128,561 @@ void GLContext::Handle(IDataBlockChangedEventArg arg) {
 void GLContext::FlushUniforms(Shader* shader, GLContext::GLShader& glshader) {
     map<Shader*, set<Uniform*> >::iterator it = uniformQueue.find(shader);
     if (it == uniformQueue.end()) return;
-    set<Uniform*> uniforms = it->second;
-    for (set<Uniform*>::iterator it = uniforms.begin();
-         it != uniforms.end(); 
-         ++it) {
-        BindUniform(**it, glshader.uniforms[*it]);
+    set<Uniform*>& uniforms = it->second;
+    for (set<Uniform*>::iterator itr = uniforms.begin();
+         itr != uniforms.end(); 
+         ++itr) {
+        BindUniform(**itr, glshader.uniforms[*itr]);
     }
     uniformQueue.erase(it);
 }
 
-// Bind/unbind (gl state) routines
+void GLContext::BindUniforms(Shader* shader, GLContext::GLShader& glshader) {
+    for (map<Uniform*, GLint>::iterator it = glshader.uniforms.begin();
+         it != glshader.uniforms.end(); ++it) {
+        if (it->first->GetKind() != Uniform::UNKNOWN)
+            BindUniform(*it->first, it->second);
+    }
+    uniformQueue.erase(shader);
+}
+
+// Bind (gl state) routines
 
 void GLContext::BindAttributes(GLContext::GLShader& glshader) {
-    vector<pair<Box<IDataBlockPtr>*, GLint> >::iterator it = glshader.attributes.begin();
-    for (; it != glshader.attributes.end(); ++it) {
-        GLint loc = it->second;
-        IDataBlock* db = it->first->Get().get();
-        if (VBOSupport()) {
-            glBindBuffer(GL_ARRAY_BUFFER, LookupVBO(db));
-            glEnableVertexAttribArray(loc);
-            glVertexAttribPointer(loc, db->GetDimension(), db->GetType(), 0, 0, 0);
-            glBindBuffer(GL_ARRAY_BUFFER, 0);
+    InterleavedBuffer* ib = NULL;
+    if (VBOSupport() && interleave) {
+        vertexArrayKey.clear();
+        for (unsigned int i = 0; i < glshader.attributes.size(); ++i)
+            vertexArrayKey.push_back(glshader.attributes[i].first->Get().get());
+        ib = LookupInterleavedBuffer(vertexArrayKey, glshader);
+    }
+
+    vector<bool> used(state.attribArrays.size(), false);
+    for (unsigned int i = 0; i < glshader.attributes.size(); ++i) {
+        GLuint loc = glshader.attributes[i].second;
+        IDataBlock* db = glshader.attributes[i].first->Get().get();
+        GLuint divisor = glshader.divisors[i];
+
+        // matrix attributes are given as blocks of dimension 9 or 16
+        // and occupy a location per column.
+        GLint size = db->GetDimension(), columns = 1;
+        if (size == 9) columns = 3;
+        else if (size == 16) columns = 4;
+        size /= columns;
+        GLsizei stride = columns > 1 ? db->GetDimension() * GLTypeSize(db->GetType()) : 0;
+
+        const char* base = NULL;
+        if (ib) {
+            BindBuffer(GL_ARRAY_BUFFER, ib->id);
+            base += ib->offsets[i];
+            stride = ib->stride;
+        }
+        else if (VBOSupport()) {
+            VBO& vbo = LookupBuffer(glshader.attributes[i].first->Get());
+            BindBuffer(GL_ARRAY_BUFFER, vbo.id);
+            base += vbo.offset;
         }
         else {
-            glEnableVertexAttribArray(loc);
-            IDataBlock* db = it->first->Get().get();
-            glVertexAttribPointer(loc, db->GetDimension(), db->GetType(), 0, 0, db->GetVoidData());
+            BindBuffer(GL_ARRAY_BUFFER, 0);
+            base = (const char*)db->GetVoidData();
+        }
+        for (GLint c = 0; c < columns; ++c) {
+            VertexAttribPointer(loc + c, size, db->GetType(), stride, 
+                                base + c * size * GLTypeSize(db->GetType()));
+            EnableVertexAttribArray(loc + c);
+            VertexAttribDivisor(loc + c, divisor);
+            if (loc + c >= used.size()) used.resize(loc + c + 1, false);
+            used[loc + c] = true;
         }
         CHECK_FOR_GL_ERROR();
     }
+    // disable arrays left enabled by previously applied shaders
+    for (GLuint loc = 0; loc < state.attribArrays.size(); ++loc) {
+        if (state.attribArrays[loc] != 0 && !used[loc]) 
+            DisableVertexAttribArray(loc);
+    }
 }
 
-void GLContext::UnbindAttributes(GLContext::GLShader& glshader) {
+/**
+ * Find the vertex array object of a shader for the current contents
+ * of its attribute boxes, building it if needed. Cached objects are
+ * checked against the VBO ids only when VBOs have been (re)created
+ * since the last check.
+ */
+GLuint GLContext::LookupVertexArray(Shader* shader, GLContext::GLShader& glshader) {
+    vertexArrayKey.clear();
+    for (unsigned int i = 0; i < glshader.attributes.size(); ++i)
+        vertexArrayKey.push_back(glshader.attributes[i].first->Get().get());
+
+    VertexArrays& arrays = vertexArrays[shader];
+    VertexArrays::iterator it = arrays.find(vertexArrayKey);
+    if (it != arrays.end()) {
+        VertexArray& va = it->second;
+        if (va.lastUsed != frameCount) {
+            // the buffers are bound through the vertex array, so
+            // keep them from being evicted as idle.
+            va.lastUsed = frameCount;
+            for (unsigned int i = 0; i < vertexArrayKey.size(); ++i) {
+                map<IDataBlock*, VBO>::iterator vit = vbos.find(vertexArrayKey[i]);
+                if (vit != vbos.end()) Touch(vit->second.lastUsed, vit->second.lru);
+            }
+        }
+        if (va.generation == vboGeneration) return va.id;
+        InterleavedBuffer* ib = LookupInterleavedBuffer(vertexArrayKey, glshader);
+        bool valid = true;
+        for (unsigned int i = 0; valid && i < vertexArrayKey.size(); ++i) {
+            if (ib) valid = ib->id == va.buffers[i];
+            else {
+                VBO& vbo = LookupBuffer(vertexArrayKey[i]);
+                valid = vbo.id == va.buffers[i] && vbo.offset == va.offsets[i];
+            }
+        }
+        if (valid) {
+            va.generation = vboGeneration;
+            return va.id;
+        }
+        // same attributes, so the pointers are recorded over the old ones
+        return BuildVertexArray(glshader, va);
+    }
+    VertexArray& va = arrays[vertexArrayKey];
+    va.id = 0;
+    return BuildVertexArray(glshader, va);
+}
+
+GLuint GLContext::BuildVertexArray(GLContext::GLShader& glshader, VertexArray& va) {
+    // look up (and upload) the buffers before recording
+    InterleavedBuffer* ib = LookupInterleavedBuffer(vertexArrayKey, glshader);
+    va.buffers.clear();
+    va.offsets.clear();
     for (unsigned int i = 0; i < glshader.attributes.size(); ++i) {
-        glDisableVertexAttribArray(i);
-        CHECK_FOR_GL_ERROR();
+        if (ib) {
+            va.buffers.push_back(ib->id);
+            va.offsets.push_back(ib->offsets[i]);
+        }
+        else {
+            VBO& vbo = LookupBuffer(glshader.attributes[i].first->Get());
+            va.buffers.push_back(vbo.id);
+            va.offsets.push_back(vbo.offset);
+        }
     }
+    va.generation = vboGeneration;
+    va.lastUsed = frameCount;
+
+    if (va.id == 0) glGenVertexArrays(1, &va.id);
+    BindVertexArray(va.id);
+    // the vertex array is either new or holds the same attributes,
+    // so the state is recorded directly without the shadowed routines.
+    for (unsigned int i = 0; i < glshader.attributes.size(); ++i) {
+        GLuint loc = glshader.attributes[i].second;
+        IDataBlock* db = glshader.attributes[i].first->Get().get();
+        GLint size = db->GetDimension(), columns = 1;
+        if (size == 9) columns = 3;
+        else if (size == 16) columns = 4;
+        size /= columns;
+        GLsizei stride = columns > 1 ? db->GetDimension() * GLTypeSize(db->GetType()) : 0;
+        const char* base = (const char*)NULL + va.offsets[i];
+        if (ib) stride = ib->stride;
+
+        BindBuffer(GL_ARRAY_BUFFER, va.buffers[i]);
+        for (GLint c = 0; c < columns; ++c) {
+            glVertexAttribPointer(loc + c, size, db->GetType(), GL_FALSE, stride, 
+                                  base + c * size * GLTypeSize(db->GetType()));
+            glEnableVertexAttribArray(loc + c);
+#ifndef OE_IOS
+            if (glshader.divisors[i] != 0 && instancingSupport)
+                glVertexAttribDivisorARB(loc + c, glshader.divisors[i]);
+#endif
+        }
+    }
+    CHECK_FOR_GL_ERROR();
+    return va.id;
+}
+
+/**
+ * Drop the vertex arrays with a forgotten block in their key. The
+ * block may be destroyed, so a new block at its address must not find
+ * them, and the cache would otherwise grow with every block.
+ */
+void GLContext::ReleaseForgottenVertexArrays() {
+    if (forgottenBlocks.empty()) return;
+    map<Shader*, VertexArrays>::iterator it = vertexArrays.begin();
+    for (; it != vertexArrays.end(); ++it) {
+        VertexArrays::iterator va = it->second.begin();
+        while (va != it->second.end()) {
+            VertexArrays::iterator cur = va++;
+            const vector<IDataBlock*>& key = cur->first;
+            for (unsigned int i = 0; i < key.size(); ++i) {
+                if (forgottenBlocks.find(key[i]) == forgottenBlocks.end()) continue;
+                deadVertexArrays.push_back(cur->second.id);
+                it->second.erase(cur);
+                break;
+            }
+        }
+    }
+    forgottenBlocks.clear();
+}
+
+void GLContext::ReleaseVertexArrays(Shader* shader) {
+    map<Shader*, VertexArrays>::iterator it = vertexArrays.find(shader);
+    if (it == vertexArrays.end()) return;
+    VertexArrays::iterator itr = it->second.begin();
+    for (; itr != it->second.end(); ++itr) {
+        if (state.vertexArray == itr->second.id) BindVertexArray(0);
+        glDeleteVertexArrays(1, &itr->second.id);
+    }
+    vertexArrays.erase(it);
 }
 
 void GLContext::BindTextures2D(GLContext::GLShader& glshader) {
     GLuint texUnit = 0;
     for (; texUnit < glshader.textures.size(); ++texUnit) {
-        glActiveTexture(GL_TEXTURE0 + texUnit);
-        glBindTexture(GL_TEXTURE_2D, LookupTexture(glshader.textures[texUnit].first->Get().get()));
+        GLuint id = LookupTexture(glshader.textures[texUnit].first->Get());
+        BindTexture(texUnit, GL_TEXTURE_2D, id);
         CHECK_FOR_GL_ERROR();
     }
     texUnit = glshader.textures.size();
     for (unsigned int i = 0; i < glshader.cubemaps.size(); ++i) {
-        glActiveTexture(GL_TEXTURE0 + texUnit);
-        glBindTexture(GL_TEXTURE_CUBE_MAP, LookupCubemap(glshader.cubemaps[i].first->Get().get()));
+        GLuint id = LookupCubemap(glshader.cubemaps[i].first->Get());
+        BindTexture(texUnit, GL_TEXTURE_CUBE_MAP, id);
         CHECK_FOR_GL_ERROR();
         ++texUnit;
     }
 }
 
-void GLContext::UnbindTextures2D(GLContext::GLShader& glshader) {
-    GLint texUnit = 0;
-    for (unsigned int i = 0; i < glshader.textures.size(); ++i) {
-        glActiveTexture(GL_TEXTURE0 + texUnit);
-        glBindTexture(GL_TEXTURE_2D, 0);
-        CHECK_FOR_GL_ERROR();
-        ++texUnit;
+GLuint GLContext::Apply(Shader* shader) {
+    GLContext::GLShader& glshader = LookupShader(shader, false);
+    if (!glshader.resolved && glshader.program->failed) {
+        UseProgram(0);
+        return 0;
     }
-    for (unsigned int i = 0; i < glshader.cubemaps.size(); ++i) {
-        glActiveTexture(GL_TEXTURE0 + texUnit);
-        glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
-        CHECK_FOR_GL_ERROR();
-        ++texUnit;
+    if (!glshader.resolved) {
+        // never wait for the link, the draw is skipped if there is
+        // nothing to draw in its place
+        GLuint id = ApplyFallback(shader);
+        if (id == 0) UseProgram(0);
+        return id;
     }
-}
-
-GLuint GLContext::Apply(Shader* shader) {
-    GLContext::GLShader glshader = LookupShader(shader);
-    glUseProgram(glshader.id);
-    FlushUniforms(shader, glshader);
-    BindAttributes(glshader);
+    UseProgram(glshader.id);
+    // a shared program holds the uniforms of the last shader applied
+    if (glshader.program->owner != shader) {
+        BindUniforms(shader, glshader);
+        glshader.program->owner = shader;
+    }
+    else
+        FlushUniforms(shader, glshader);
+    if (vaoSupport) 
+        BindVertexArray(LookupVertexArray(shader, glshader));
+    else 
+        BindAttributes(glshader);
     BindTextures2D(glshader);
     return glshader.id;
 }
 
 void GLContext::Release(Shader* shader) {
-    GLContext::GLShader glshader = LookupShader(shader);
-    UnbindAttributes(glshader);        
-    UnbindTextures2D(glshader);        
-    glUseProgram(0);
+    // Bindings are left in place and only changed by the next
+    // Apply if needed. Use ResetState to unbind everything.
+}
+
+// ------- Statistics -------
+GLContext::Statistics::Statistics()
+    : drawCalls(0)
+    , primitives(0)
+    , programSwitches(0)
+    , textureBinds(0)
+    , bufferBinds(0)
+    , framebufferSwitches(0)
+    , uniformUploads(0)
+    , bufferBytes(0)
+    , textureBytes(0)
+    , resourcesCreated(0)
+    , resourcesEvicted(0)
+{}
+
+GLContext::Statistics GLContext::Statistics::operator-(const Statistics& other) const {
+    // unsigned, so a counter which wrapped in between still subtracts right
+    Statistics s;
+    s.drawCalls = drawCalls - other.drawCalls;
+    s.primitives = primitives - other.primitives;
+    s.programSwitches = programSwitches - other.programSwitches;
+    s.textureBinds = textureBinds - other.textureBinds;
+    s.bufferBinds = bufferBinds - other.bufferBinds;
+    s.framebufferSwitches = framebufferSwitches - other.framebufferSwitches;
+    s.uniformUploads = uniformUploads - other.uniformUploads;
+    s.bufferBytes = bufferBytes - other.bufferBytes;
+    s.textureBytes = textureBytes - other.textureBytes;
+    s.resourcesCreated = resourcesCreated - other.resourcesCreated;
+    s.resourcesEvicted = resourcesEvicted - other.resourcesEvicted;
+    return s;
+}
+
+GLContext::Statistics& GLContext::Statistics::operator+=(const Statistics& other) {
+    drawCalls += other.drawCalls;
+    primitives += other.primitives;
+    programSwitches += other.programSwitches;
+    textureBinds += other.textureBinds;
+    bufferBinds += other.bufferBinds;
+    framebufferSwitches += other.framebufferSwitches;
+    uniformUploads += other.uniformUploads;
+    bufferBytes += other.bufferBytes;
+    textureBytes += other.textureBytes;
+    resourcesCreated += other.resourcesCreated;
+    resourcesEvicted += other.resourcesEvicted;
+    return *this;
+}
+
+/**
+ * Count a draw call of count vertices per instance.
+ */
+void GLContext::CountDraw(GLenum mode, GLsizei count, GLsizei instances) {
+    ++stats.drawCalls;
+    if (count <= 0 || instances <= 0) return;
+    unsigned int primitives = 0;
+    switch (mode) {
+    case GL_POINTS:
+    case GL_LINE_LOOP:
+        primitives = count;
+        break;
+    case GL_LINES:
+        primitives = count / 2;
+        break;
+    case GL_LINE_STRIP:
+        primitives = count - 1;
+        break;
+    case GL_TRIANGLES:
+        primitives = count / 3;
+        break;
+    case GL_TRIANGLE_STRIP:
+    case GL_TRIANGLE_FAN:
+        primitives = count > 2 ? count - 2 : 0;
+        break;
+#ifndef OE_IOS
+    case GL_QUADS:
+        primitives = count / 4;
+        break;
+    case GL_QUAD_STRIP:
+        primitives = count > 3 ? count / 2 - 1 : 0;
+        break;
+    case GL_POLYGON:
+        primitives = 1;
+        break;
+#endif
+    }
+    stats.primitives += primitives * instances;
+}
+
+void GLContext::Uniform1i(GLint loc, GLint v0) {
+    glUniform1i(loc, v0);
+    ++stats.uniformUploads;
+}
+
+void GLContext::Uniform2f(GLint loc, GLfloat v0, GLfloat v1) {
+    glUniform2f(loc, v0, v1);
+    ++stats.uniformUploads;
+}
+
+void GLContext::Uniform4fv(GLint loc, GLsizei count, const GLfloat* value) {
+    glUniform4fv(loc, count, value);
+    ++stats.uniformUploads;
+}
+
+void GLContext::DrawArrays(GLenum mode, GLint first, GLsizei count) {
+    glDrawArrays(mode, first, count);
+    CountDraw(mode, count, 1);
+}
+
+void GLContext::DrawElements(GLenum mode, GLsizei count, GLenum type, const GLvoid* indices) {
+    glDrawElements(mode, count, type, indices);
+    CountDraw(mode, count, 1);
+}
+
+void GLContext::DrawElementsInstanced(GLenum mode, GLsizei count, GLenum type, 
+                                      const GLvoid* indices, GLsizei instances) {
+#ifndef OE_IOS
+    glDrawElementsInstancedARB(mode, count, type, indices, instances);
+    CountDraw(mode, count, instances);
+#endif
+}
+
+// ------- State -------
+void GLContext::UseProgram(GLuint id) {
+    if (state.program == id) return;
+    glUseProgram(id);
+    state.program = id;
+    ++stats.programSwitches;
+}
+
+void GLContext::BindVertexArray(GLuint id) {
+    if (!vaoSupport || state.vertexArray == id) return;
+    glBindVertexArray(id);
+    state.vertexArray = id;
+    // the element buffer binding belongs to the vertex array
+    state.elementBuffer = UNKNOWN_ID;
+}
+
+void GLContext::BindBuffer(GLenum target, GLuint id) {
+    GLuint* bound;
+    switch (target) {
+    case GL_ARRAY_BUFFER: 
+        bound = &state.arrayBuffer; 
+        break;
+    case GL_ELEMENT_ARRAY_BUFFER: 
+        bound = &state.elementBuffer; 
+        break;
+    default: 
+        glBindBuffer(target, id);
+        ++stats.bufferBinds;
+        return;
+    }
+    if (*bound == id) return;
+    glBindBuffer(target, id);
+    *bound = id;
+    ++stats.bufferBinds;
+}
+
+void GLContext::BindFramebuffer(GLuint fbo) {
+    if (state.framebuffer == fbo) return;
+    glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+    state.framebuffer = fbo;
+    ++stats.framebufferSwitches;
+}
+
+GLuint GLContext::GetFramebuffer() {
+    if (state.framebuffer == UNKNOWN_ID) {
+        GLint fbo;
+        glGetIntegerv(GL_FRAMEBUFFER_BINDING, &fbo);
+        state.framebuffer = fbo;
+    }
+    return state.framebuffer;
+}
+
+void GLContext::ActiveTexture(GLuint unit) {
+    if (state.textureUnit == unit) return;
+    glActiveTexture(GL_TEXTURE0 + unit);
+    state.textureUnit = unit;
+}
+
+void GLContext::BindTexture(GLenum target, GLuint id) {
+    if (state.textureUnit == UNKNOWN_ID) ActiveTexture(0);
+    vector<GLuint>& bound = (target == GL_TEXTURE_CUBE_MAP) ? state.texturesCube : state.textures2D;
+    const GLuint unit = state.textureUnit;
+    if (unit >= bound.size()) bound.resize(unit + 1, UNKNOWN_ID);
+    if (bound[unit] == id) return;
+    glBindTexture(target, id);
+    bound[unit] = id;
+    ++stats.textureBinds;
+}
+
+void GLContext::BindTexture(GLuint unit, GLenum target, GLuint id) {
+    vector<GLuint>& bound = (target == GL_TEXTURE_CUBE_MAP) ? state.texturesCube : state.textures2D;
+    if (unit < bound.size() && bound[unit] == id) return;
+    ActiveTexture(unit);
+    BindTexture(target, id);
+}
+
+void GLContext::EnableVertexAttribArray(GLuint loc) {
+    BindVertexArray(0);
+    if (loc >= state.attribArrays.size()) state.attribArrays.resize(loc + 1, -1);
+    if (state.attribArrays[loc] == 1) return;
+    glEnableVertexAttribArray(loc);
+    state.attribArrays[loc] = 1;
+}
+
+void GLContext::DisableVertexAttribArray(GLuint loc) {
+    BindVertexArray(0);
+    if (loc >= state.attribArrays.size()) state.attribArrays.resize(loc + 1, -1);
+    if (state.attribArrays[loc] == 0) return;
+    glDisableVertexAttribArray(loc);
+    state.attribArrays[loc] = 0;
+}
+
+void GLContext::VertexAttribPointer(GLuint loc, GLint size, GLenum type, 
+                                    GLsizei stride, const GLvoid* pointer) {
+    BindVertexArray(0);
+    if (loc >= state.attribPointers.size()) {
+        AttribPointer unknown = { UNKNOWN_ID, 0, 0, 0, NULL };
+        state.attribPointers.resize(loc + 1, unknown);
+    }
+    AttribPointer& p = state.attribPointers[loc];
+    // the pointer is relative to the buffer bound at specification time.
+    if (p.buffer == state.arrayBuffer && p.size == size && p.type == type && 
+        p.stride == stride && p.pointer == pointer) return;
+    glVertexAttribPointer(loc, size, type, GL_FALSE, stride, pointer);
+    p.buffer = state.arrayBuffer;
+    p.size = size;
+    p.type = type;
+    p.stride = stride;
+    p.pointer = pointer;
+}
+
+void GLContext::VertexAttribDivisor(GLuint loc, GLuint divisor) {
+    BindVertexArray(0);
+    if (loc >= state.attribDivisors.size()) state.attribDivisors.resize(loc + 1, -1);
+    if (state.attribDivisors[loc] == (GLint)divisor) return;
+    // without instancing support all divisors are zero
+    if (!instancingSupport) return;
+#ifndef OE_IOS
+    glVertexAttribDivisorARB(loc, divisor);
+#endif
+    state.attribDivisors[loc] = divisor;
+}
+
+void GLContext::Enable(GLenum cap) {
+    map<GLenum, bool>::iterator it = state.capabilities.find(cap);
+    if (it != state.capabilities.end() && it->second) return;
+    glEnable(cap);
+    state.capabilities[cap] = true;
+}
+
+void GLContext::Disable(GLenum cap) {
+    map<GLenum, bool>::iterator it = state.capabilities.find(cap);
+    if (it != state.capabilities.end() && !it->second) return;
+    glDisable(cap);
+    state.capabilities[cap] = false;
+}
+
+void GLContext::DepthMask(GLboolean flag) {
+    if (state.depthMask == (GLint)flag) return;
+    glDepthMask(flag);
+    state.depthMask = flag;
+}
+
+void GLContext::PixelStore(GLenum pname, GLint param) {
+    map<GLenum, GLint>::iterator it = state.pixelStore.find(pname);
+    if (it != state.pixelStore.end() && it->second == param) return;
+    glPixelStorei(pname, param);
+    state.pixelStore[pname] = param;
+}
+
+void GLContext::InvalidateState() {
+    state.program = UNKNOWN_ID;
+    state.vertexArray = UNKNOWN_ID;
+    state.arrayBuffer = UNKNOWN_ID;
+    state.elementBuffer = UNKNOWN_ID;
+    state.framebuffer = UNKNOWN_ID;
+    state.textureUnit = UNKNOWN_ID;
+    state.textures2D.clear();
+    state.texturesCube.clear();
+    state.attribArrays.clear();
+    state.attribPointers.clear();
+    state.attribDivisors.clear();
+    state.capabilities.clear();
+    state.depthMask = -1;
+    state.pixelStore.clear();
+}
+
+void GLContext::ResetState() {
+    UseProgram(0);
+    BindVertexArray(0);
+    BindBuffer(GL_ARRAY_BUFFER, 0);
+    BindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+    for (GLuint unit = 0; unit < state.textures2D.size(); ++unit)
+        if (state.textures2D[unit] != 0) BindTexture(unit, GL_TEXTURE_2D, 0);
+    for (GLuint unit = 0; unit < state.texturesCube.size(); ++unit)
+        if (state.texturesCube[unit] != 0) BindTexture(unit, GL_TEXTURE_CUBE_MAP, 0);
+    ActiveTexture(0);
+    for (GLuint loc = 0; loc < state.attribArrays.size(); ++loc)
+        DisableVertexAttribArray(loc);
+    CHECK_FOR_GL_ERROR();
 }
 
 
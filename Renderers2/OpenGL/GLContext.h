@@ -14,8 +14,13 @@
 #include <Resources/IDataBlock.h>
 #include <Resources2/Shader.h>
 #include <Meta/OpenGL.h>
+#include <Renderers2/OpenGL/BufferArena.h>
+#include <Renderers2/OpenGL/TextureStreamer.h>
+#include <Renderers2/OpenGL/ProgramCache.h>
 #include <Core/IListener.h>
 #include <Utils/Box.h>
+#include <boost/weak_ptr.hpp>
+#include <list>
 #include <map>
 #include <vector>
 #include <set>
@@ -51,10 +56,12 @@ using Display2::Canvas2D;
 using Display2::Canvas3D;
 using Core::IListener;
 using Utils::Box;
+using std::list;
 using std::map;
 using std::pair;
 using std::vector;
 using std::set;
+using std::string;
 
 /**
  * OpenGL Shader Language versions
@@ -69,15 +76,28 @@ enum GLSLVersion { GLSL_UNKNOWN, GLSL_NONE, GLSL_14, GLSL_20 };
  * @class GLContext GLContext.h Renderers2/OpenGL/GLContext.h
  */
 class GLContext: public IListener<Shader::ChangedEventArg>
+               , public IListener<Shader::DestroyedEventArg>
                , public IListener<Uniform::ChangedEventArg>
                , public IListener<Texture2DChangedEventArg> 
                , public IListener<IDataBlockChangedEventArg> {
 public:
+    // a GL program shared by all shaders with the same source.
+    struct SharedProgram {
+        string source;      // key in the programs map
+        unsigned int refs;
+        Shader* owner;      // shader whose uniform values the program holds
+        bool ready;         // linked, false while compiling or if it failed
+        bool failed;        // compile or link failed, never drawn
+    };
+
     // structure containing the uniform locations.
     struct GLShader {
         GLuint id;
+        SharedProgram* program;
+        bool resolved;      // false until the locations below are known
         map<Uniform*, GLint> uniforms;
         vector<pair<Box<IDataBlockPtr>*, GLint> > attributes;
+        vector<GLuint> divisors; // instance divisor of each attribute
         vector<pair<Box<ITexture2DPtr>*, GLint> > textures;
         vector<pair<Box<ICubemapPtr>*, GLint> > cubemaps;
     };
@@ -85,35 +105,256 @@ public:
         ITexture2DPtr color0, color1, depth;
     };
 
+    // work sent to GL since the context was created. The difference
+    // of two readings is the work done in between.
+    struct Statistics {
+        unsigned int drawCalls;
+        unsigned int primitives;        // points, lines or triangles drawn
+        unsigned int programSwitches;
+        unsigned int textureBinds;
+        unsigned int bufferBinds;
+        unsigned int framebufferSwitches;
+        unsigned int uniformUploads;
+        size_t bufferBytes;             // uploaded to buffers
+        size_t textureBytes;            // uploaded to textures
+        unsigned int resourcesCreated;  // textures, buffers, framebuffers and shaders
+        unsigned int resourcesEvicted;  // by the memory budget
+        Statistics();
+        Statistics operator-(const Statistics& other) const;
+        Statistics& operator+=(const Statistics& other);
+    };
+
+    // marks a shadowed binding whose driver value is not known.
+    static const GLuint UNKNOWN_ID = 0xFFFFFFFF;
+
 private:
+    // last attribute pointer specified for a location.
+    struct AttribPointer {
+        GLuint buffer;
+        GLint size;
+        GLenum type;
+        GLsizei stride;
+        const GLvoid* pointer;
+    };
+
+    // shadow copy of the GL state changed through the context. Only
+    // changes against this copy are forwarded to the driver.
+    struct GLState {
+        GLuint program;
+        GLuint vertexArray;
+        GLuint arrayBuffer, elementBuffer;
+        GLuint framebuffer;
+        GLuint textureUnit;
+        vector<GLuint> textures2D, texturesCube; // per texture unit
+        // attribute state of vertex array object 0
+        vector<GLint> attribArrays;              // -1 unknown, 0 disabled, 1 enabled
+        vector<AttribPointer> attribPointers;
+        vector<GLint> attribDivisors;            // -1 unknown
+        map<GLenum, bool> capabilities;
+        GLint depthMask;                         // -1 unknown
+        map<GLenum, GLint> pixelStore;
+    };
+
+    // sampler parameters last set on a texture.
+    struct TexParameters {
+        Resources::Wrapping wrapping;
+        Resources::Filtering filtering;
+        bool mipmapping;
+    };
+
     GLSLVersion glslversion;
-    bool init, fboSupport, vboSupport, shaderSupport;
+    // vertex array object capturing the attribute bindings of a
+    // shader for one set of attribute data blocks.
+    struct VertexArray {
+        GLuint id;
+        vector<GLuint> buffers;   // VBO ids of the blocks at build time
+        vector<GLintptr> offsets; // and their offsets into the VBOs
+        unsigned int generation;  // vboGeneration at last validation
+        unsigned int lastUsed;    // frame its buffers were last touched
+    };
+    typedef map<vector<IDataBlock*>, VertexArray> VertexArrays;
+
+    // resource holding device memory, one of the pointers set.
+    struct Resident {
+        ITexture2D* texture;
+        ICubemap* cubemap;
+        IDataBlock* block;
+    };
+    typedef list<Resident> Residents;
+
+    // number of segments in the buffer of a streamed block.
+    static const unsigned int STREAM_SEGMENTS = 3;
+
+    // buffer holding a data block. Blocks in an arena share their
+    // buffer with other blocks. Streamed (dynamic) blocks write each
+    // update to the next segment of a ring, offset pointing at the
+    // current one.
+    struct VBO {
+        GLuint id;
+        GLintptr offset;
+        GLenum target;
+        bool arena;
+        bool stream;
+        GLsizeiptr capacity;                    // segment size
+        unsigned int segment;
+        unsigned int frames[STREAM_SEGMENTS];   // frame each segment was written in
+        size_t bytes;                           // device memory held
+        unsigned int lastUsed;                  // frame of the last lookup
+        Residents::iterator lru;                // position in residents
+        bool tracked;                           // owner is set, see ReleaseDead
+        boost::weak_ptr<void> owner;
+    };
+
+    // texture object with its memory accounting.
+    struct GLTexture {
+        GLuint id;
+        size_t bytes;
+        unsigned int lastUsed;                  // frame of the last lookup
+        bool fromSource;                        // loaded by the context, see Evict
+        Residents::iterator lru;                // position in residents
+        bool tracked;                           // owner is set, see ReleaseDead
+        boost::weak_ptr<void> owner;
+    };
+
+    // attribute blocks of a shader interleaved into one buffer.
+    struct InterleavedBuffer {
+        GLuint id;                // 0 if the blocks cannot be interleaved
+        GLsizei stride;
+        vector<GLuint> offsets;   // byte offset of each block in a vertex
+        size_t bytes;
+        vector<boost::weak_ptr<void> > owners;
+    };
+
+    bool init, fboSupport, vboSupport, shaderSupport, instancingSupport, vaoSupport, syncSupport;
+    bool uniformBufferSupport;
     map<ICanvas*, Attachments> attachments; // color attachments and depth attachment
     map<ICanvas*, GLuint> fbos;             // association with fbo
-    map<ITexture2D*, GLuint> textures;
-    map<IDataBlock*, GLuint> vbos;
-    map<ICubemap*, GLuint> cubemaps;
+    map<ITexture2D*, GLTexture> textures;
+    map<ITexture2D*, TexParameters> texParameters;
+    set<ITexture2D*> renderTargets;     // canvas attachments, never streamed
+    TextureStreamer* streamer;
+    map<IDataBlock*, VBO> vbos;
+    BufferArena arrayArena, elementArena;
+    GLsizeiptr arenaBlockSize;          // largest block put in an arena
+    map<ICubemap*, GLTexture> cubemaps;
     map<Shader*, GLShader> shaders;
 
+    // buffer backing the uniform blocks of a name in all programs.
+    struct UniformBlock {
+        GLuint buffer;
+        GLuint binding;     // binding point, fixed per name
+    };
+    map<string, UniformBlock> uniformBlocks;
+    string programCacheDir;
+    ProgramCache* programCache;
+    map<string, GLuint> programIds;        // vertex and fragment source to program
+    map<GLuint, SharedProgram> programs;
+
+    // program compiled in the background, see SetAsyncCompile.
+    struct PendingProgram {
+        GLuint vertexId, fragmentId;
+        string vertexShader, fragmentShader;
+        bool started;       // compile and link issued
+    };
+    map<GLuint, PendingProgram> pendingPrograms;
+    bool asyncCompile, parallelCompileSupport;
+    // gray programs drawn while a program compiles, see ApplyFallback.
+    enum FallbackKind {
+        FALLBACK_PLAIN,             // modelViewProjectionMatrix uniform
+        FALLBACK_INSTANCED,         // per instance modelview, projectionMatrix uniform
+        FALLBACK_INSTANCED_BLOCK,   // per instance modelview, FrameData projection
+        FALLBACK_KINDS
+    };
+    struct Fallback {
+        Shader* shader;
+        GLint matrix;               // matrix uniform, -1 if read from the block
+        GLint vertex, instance;     // attributes, -1 if unused
+    };
+    Fallback fallbacks[FALLBACK_KINDS];
+    map<Shader*, VertexArrays> vertexArrays;
+    vector<IDataBlock*> vertexArrayKey; // scratch key for lookups
+    set<IDataBlock*> forgottenBlocks;   // vertex arrays using these are dropped by BeginFrame
+    unsigned int vboGeneration;         // incremented when VBO ids change
+    bool interleave;
+    map<vector<IDataBlock*>, InterleavedBuffer> interleavedBuffers;
+    set<IDataBlock*> interleavedBlocks;
+    // changed element ranges [first, last) of blocks, uploaded by BeginFrame.
+    typedef vector<pair<unsigned int, unsigned int> > Ranges;
+    map<IDataBlock*, Ranges> dirtyRanges;
+    unsigned int frameCount;            // frames begun, starting at 1
+    size_t memoryUsed, memoryBudget;    // bytes, a budget of 0 never evicts
+    unsigned int evictionAge;           // frames a resource must be idle to be evicted
+    Residents residents;                // least recently used first
+    // GL objects of released resources, deleted by the next BeginFrame.
+    vector<GLuint> deadTextures, deadBuffers, deadFramebuffers, deadVertexArrays, deadPrograms;
+#ifndef OE_IOS
+    GLsync frameFences[STREAM_SEGMENTS]; // end of frame fences, by frame modulo segments
+#endif
+
     map<Shader*, set<Uniform*> > uniformQueue; // queue to delay uniform updates.
 
+    GLState state;
+    Statistics stats;
+
     // GPU creation routines
     Attachments LoadCanvas(ICanvas* can);
-    GLuint LoadTexture(ITexture2D* tex);
-    GLuint LoadVBO(IDataBlock* db);
-    GLuint LoadShader(Shader* shad);
+    GLuint LoadTexture(ITexture2D* tex, ITexture2DPtr owner);
+    GLuint LoadPlaceholder(ITexture2DPtr tex);
+    VBO LoadVBO(IDataBlock* db);
+    inline VBO& LookupBuffer(IDataBlock* db);
+    inline VBO& LookupBuffer(const IDataBlockPtr& db);
+    inline BufferArena* LookupArena(IDataBlock* db);
+    GLTexture& LookupGLTexture(ITexture2D* tex, ITexture2DPtr owner);
+    GLTexture& LookupGLCubemap(ICubemap* cube);
+    GLuint LoadShader(Shader* shad, bool async);
+    void RegisterProgram(GLuint id, const string& source, bool ready);
+    void ReleaseProgram(GLuint id);
+    void StartCompile(GLuint id, PendingProgram& pending);
+    void FinishCompile(GLuint id, PendingProgram& pending);
+    void WaitForProgram(GLuint id);
+    void PollPrograms();
+    GLuint ApplyFallback(Shader* shader);
+    Fallback& LookupFallback(FallbackKind kind);
+    const char* BindFallbackArray(const IDataBlockPtr& db);
+    void ReleaseFallbacks();
     GLuint LoadCubemap(ICubemap* cube);
     inline void BindUniform(Uniform& uniform, GLint loc);
     inline GLShader ResolveLocations(GLuint id, Shader* shad);
+    inline UniformBlock& LookupUniformBlock(const string& name);
     inline void SetupTexParameters(ITexture2D* tex);
 
 
     // inline void BindUniforms(GLContext::GLShader& glshader);
     inline void FlushUniforms(Shader* shader, GLShader& glshader);
+    inline void BindUniforms(Shader* shader, GLShader& glshader);
     inline void BindAttributes(GLContext::GLShader& glshader);
-    inline void UnbindAttributes(GLContext::GLShader& glshader);
+    inline GLuint LookupVertexArray(Shader* shader, GLContext::GLShader& glshader);
+    inline GLuint BuildVertexArray(GLContext::GLShader& glshader, VertexArray& va);
+    inline InterleavedBuffer* LookupInterleavedBuffer(const vector<IDataBlock*>& blocks, GLShader& glshader);
+    InterleavedBuffer LoadInterleavedBuffer(const vector<IDataBlock*>& blocks, GLShader& glshader);
+    void ReleaseInterleavedBuffers(IDataBlock* db);
+    void FlushRanges(IDataBlock* db, Ranges& ranges);
+    void StreamVBO(IDataBlock* db, VBO& vbo);
+    void WaitForFrame(unsigned int frame);
+    void ReleaseVertexArrays(Shader* shader);
+    void ReleaseForgottenVertexArrays();
+    inline void Account(size_t& bytes, size_t newBytes);
+    static size_t TextureBytes(ITexture2D* tex);
+    static size_t CubemapBytes(ICubemap* cube);
+    static size_t PixelBytes(ITexture2D* tex);
+    inline void CountDraw(GLenum mode, GLsizei count, GLsizei instances);
+    inline Residents::iterator AddResident(ITexture2D* tex, ICubemap* cube, IDataBlock* db);
+    inline void Touch(unsigned int& lastUsed, Residents::iterator lru);
+    void Evict();
+    bool EvictTexture(ITexture2D* tex);
+    bool EvictCubemap(ICubemap* cube);
+    bool EvictVBO(IDataBlock* db);
+    void ForgetTexture(ITexture2D* tex, bool alive);
+    void ForgetCubemap(ICubemap* cube);
+    void ForgetVBO(IDataBlock* db, bool alive);
+    void ReleaseDead();
+    void DeleteDead();
     inline void BindTextures2D(GLContext::GLShader& glshader);
-    inline void UnbindTextures2D(GLContext::GLShader& glshader);
 
 
 public:
@@ -125,6 +366,9 @@ public:
     bool FBOSupport();
     bool VBOSupport();
     bool ShaderSupport();
+    bool InstancingSupport();
+    bool VertexArraySupport();
+    bool UniformBufferSupport();
         
     // lookup routines. If no map contains the requested object the
     // creation routines will be invoked.
@@ -133,9 +377,90 @@ public:
     Attachments& LookupCanvas(ICanvas* can);
     GLuint LookupTexture(ITexture2D* tex);
     GLuint LookupVBO(IDataBlock* db);
-    GLShader LookupShader(Shader* shad);
+    // byte offset of the block in its VBO, to be added to the pointer
+    // or index offset of draw calls.
+    GLintptr LookupVBOOffset(IDataBlock* db);
+    GLShader& LookupShader(Shader* shad);
+    // without wait a compiling shader is returned unresolved (see
+    // GLShader::resolved) instead of waiting for the link.
+    GLShader& LookupShader(Shader* shad, bool wait);
     GLuint LookupCubemap(ICubemap* cube);
 
+    // as above, and the GL objects are deleted by the next BeginFrame
+    // after the last reference to the resource is gone. Resources
+    // only ever looked up by pointer are kept until released.
+    GLuint LookupTexture(ITexture2DPtr tex);
+    GLuint LookupVBO(IDataBlockPtr db);
+    GLintptr LookupVBOOffset(IDataBlockPtr db);
+    GLuint LookupCubemap(ICubemapPtr cube);
+
+    // delete the framebuffer of a canvas and its attachments, e.g.
+    // before destroying the canvas.
+    void ReleaseCanvas(ICanvas* can);
+
+    // upload the current contents of a data block to its VBO.
+    void UpdateVBO(IDataBlock* db);
+
+    // mark count elements from first as changed. Ranges are merged
+    // and uploaded by the next BeginFrame, and a changed event on
+    // the block no longer causes a full upload.
+    void UpdateVBORange(IDataBlock* db, unsigned int first, unsigned int count);
+
+    // replace the contents of the buffer backing the uniform blocks
+    // called name, e.g. once per frame for data shared by all shaders.
+    // Programs are bound to the buffer when their locations are
+    // resolved, so the data is not uploaded per shader.
+    void UpdateUniformBlock(string name, const void* data, GLsizeiptr size);
+
+    // per frame housekeeping, called before rendering a frame.
+    void BeginFrame();
+
+    // load textures without data on worker threads and upload at
+    // most bytesPerFrame per frame, showing a gray placeholder until
+    // then. 0 loads textures on first use, as do lookups by raw
+    // pointer, which give the streamer no reference to hold.
+    void SetTextureStreaming(unsigned int bytesPerFrame);
+
+    // store linked programs in a directory and load them from there
+    // instead of compiling, if supported. Empty disables the cache.
+    void SetProgramCache(string directory);
+
+    // compile new shaders in the background. Apply never waits for
+    // them: shaders still compiling are drawn with a plain gray
+    // shader if they have a "vertex" attribute and either a
+    // "modelViewProjectionMatrix" uniform or a per instance
+    // "instanceModelViewMatrix" attribute with the projection in a
+    // "projectionMatrix" uniform or the "FrameData" block, and are
+    // skipped (Apply returns 0) otherwise.
+    // Without KHR_parallel_shader_compile the driver is only asked to
+    // compile and link a few programs per frame, and BeginFrame reads
+    // their results the frame after. A driver which does not link in
+    // the background then still stalls BeginFrame on that read.
+    void SetAsyncCompile(bool enable);
+
+    // upload the attribute blocks of a shader interleaved into one
+    // VBO. Only static blocks of equal size are interleaved, and
+    // their data is kept in memory for rebuilding.
+    void SetInterleaving(bool enable);
+
+    // sub-allocate static blocks of at most maxSize bytes from a few
+    // large shared buffers. A size of 0 disables the arenas.
+    void SetBufferArena(GLsizeiptr maxSize);
+
+    // keep textures and buffers within a device memory budget. When
+    // over budget, BeginFrame deletes the least recently used ones not
+    // used in the last minAge frames, as long as their data can be
+    // loaded again, and the next lookup uploads them anew. Render
+    // targets are never evicted. A budget of 0 disables eviction.
+    void SetMemoryBudget(size_t bytes, unsigned int minAge = 60);
+    // estimated bytes of device memory held by textures and buffers.
+    size_t GetMemoryUsage();
+    // recount a texture whose storage was specified outside the context.
+    void UpdateTextureMemory(ITexture2D* tex);
+
+    // counts of the work sent to GL, see Statistics.
+    const Statistics& GetStatistics();
+
     // mainly for debugging and testing
     void ReleaseTextures();
     void ReleaseVBOs();
@@ -148,6 +473,7 @@ public:
     static unsigned int GLTypeSize(Type t);
 
     void Handle(Shader::ChangedEventArg arg);
+    void Handle(Shader::DestroyedEventArg arg);
     void Handle(Uniform::ChangedEventArg arg);
     void Handle(Texture2DChangedEventArg arg);
     void Handle(IDataBlockChangedEventArg arg);
@@ -155,6 +481,45 @@ public:
     GLuint Apply(Shader* shader);
     void Release(Shader* shader);
 
+    // state routines. Changes are checked against the shadowed state,
+    // so redundant calls never reach the driver. Code which changes
+    // the same state directly must call InvalidateState afterwards.
+    // The vertex attribute routines bind vertex array object 0.
+    void UseProgram(GLuint id);
+    void BindVertexArray(GLuint id);
+    void BindBuffer(GLenum target, GLuint id);
+    void BindFramebuffer(GLuint fbo);
+    GLuint GetFramebuffer();
+    void ActiveTexture(GLuint unit);
+    void BindTexture(GLenum target, GLuint id);
+    void BindTexture(GLuint unit, GLenum target, GLuint id);
+    void EnableVertexAttribArray(GLuint loc);
+    void DisableVertexAttribArray(GLuint loc);
+    void VertexAttribPointer(GLuint loc, GLint size, GLenum type, 
+                             GLsizei stride, const GLvoid* pointer);
+    void VertexAttribDivisor(GLuint loc, GLuint divisor);
+    void Enable(GLenum cap);
+    void Disable(GLenum cap);
+    void DepthMask(GLboolean flag);
+    void PixelStore(GLenum pname, GLint param);
+
+    // draw routines, counting the draw calls and primitives.
+    void DrawArrays(GLenum mode, GLint first, GLsizei count);
+    void DrawElements(GLenum mode, GLsizei count, GLenum type, const GLvoid* indices);
+    void DrawElementsInstanced(GLenum mode, GLsizei count, GLenum type, 
+                               const GLvoid* indices, GLsizei instances);
+
+    // uniform routines for the bound program, counting the uploads.
+    void Uniform1i(GLint loc, GLint v0);
+    void Uniform2f(GLint loc, GLfloat v0, GLfloat v1);
+    void Uniform4fv(GLint loc, GLsizei count, const GLfloat* value);
+
+    // forget the shadowed state, forcing the next changes to the driver.
+    void InvalidateState();
+    // unbind programs, buffers and textures and disable all attribute
+    // arrays, e.g. before handing GL to fixed function code.
+    void ResetState();
+
 };
 
 } // NS OpenGL
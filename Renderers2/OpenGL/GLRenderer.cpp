@@ -12,6 +12,8 @@
 #include <Renderers2/OpenGL/RenderingView.h>
 #include <Renderers2/OpenGL/LightVisitor.h>
 #include <Renderers2/OpenGL/CanvasVisitor.h>
+#include <Renderers2/BoundsCache.h>
+#include <Renderers2/BoundingVolumeHierarchy.h>
 #include <Resources/ResourceManager.h>
 #include <Resources2/ShaderResource.h>
 #include <Resources/DataBlock.h>
@@ -23,6 +25,7 @@
 #include <Meta/OpenGL.h>
 
 #include <Logging/Logger.h>
+#include <Utils/Profiler.h>
 
 namespace OpenEngine {
 namespace Renderers2 {
@@ -40,12 +43,21 @@ using namespace Math;
 
 GLRenderer::GLRenderer(GLContext* ctx)
     : ctx(ctx)
+    , bounds(new BoundsCache())
+    , occlusionCuller(NULL)
     , canvas(NULL)
     , init(false)
     , level(0)
+    , frame(1)
     , rv(new RenderingView())
     , lv(new LightVisitor())
     , cv(new CanvasVisitor(*this))
+    , initialize("initialize")
+    , preProcess("preprocess")
+    , process("process")
+    , postProcess("postprocess")
+    , deinitialize("deinitialize")
+    , timer(NULL)
     , arg(Core::ProcessEventArg(Time(), 0))
     , stage(RENDERER_UNINITIALIZE)
 {
@@ -57,32 +69,40 @@ GLRenderer::GLRenderer(GLContext* ctx)
 }
     
 GLRenderer::~GLRenderer() {
-
+    map<ISceneNode*, BoundingVolumeHierarchy*>::iterator it = hierarchies.begin();
+    for (; it != hierarchies.end(); ++it)
+        delete it->second;
+    delete bounds;
+    delete timer;
 }
 
 void GLRenderer::Render(CompositeCanvas* canvas) {
+    OE_PROFILE_SCOPE("GLRenderer::Render(CompositeCanvas)");
     // logger.info << "render composite: " << canvas << logger.end;
     ++level;
     canvas->AcceptChildren(*cv);
     --level;
+    if (timer) timer->Begin("composite");
+    // the children counted themselves
+    GLContext::Statistics start = ctx->GetStatistics();
 
-    GLint prevFbo;
+    GLuint prevFbo = 0;
 
     if (ctx->FBOSupport() && level > 0) {
         // logger.info << "hip!" << logger.end;
-        glGetIntegerv(GL_FRAMEBUFFER_BINDING, &prevFbo);
-        glBindFramebuffer(GL_FRAMEBUFFER, ctx->LookupFBO(canvas));
+        prevFbo = ctx->GetFramebuffer();
+        ctx->BindFramebuffer(ctx->LookupFBO(canvas));
         glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, 
                                ctx->LookupTexture(ctx->LookupCanvas(canvas).color0.get()), 0);
         CHECK_FRAMEBUFFER_STATUS();
    }
 
-    glEnable(GL_BLEND);
-    glDisable(GL_DEPTH_TEST);
-    glDepthMask(GL_FALSE);
+    ctx->Enable(GL_BLEND);
+    ctx->Disable(GL_DEPTH_TEST);
+    ctx->DepthMask(GL_FALSE);
     glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
     glBlendEquation(GL_FUNC_ADD);
-    glActiveTexture(GL_TEXTURE0);
+    ctx->ActiveTexture(0);
 
     glViewport(0, 0, canvas->GetWidth(), canvas->GetHeight());
     RGBAColor bgc = canvas->GetBackgroundColor();
@@ -99,18 +119,20 @@ void GLRenderer::Render(CompositeCanvas* canvas) {
 #if FIXED_FUNCTION
     if (ctx->ShaderSupport()) {
 #endif
-        GLContext::GLShader glShader = ctx->LookupShader(quadShader.get());
+        GLContext::GLShader& glShader = ctx->LookupShader(quadShader.get());
         GLuint shaderId = glShader.id;
-        glUseProgram(shaderId);
+        ctx->UseProgram(shaderId);
                         
-        glEnableVertexAttribArray(vsLoc);
-        glEnableVertexAttribArray(tcLoc);
+        ctx->EnableVertexAttribArray(vsLoc);
+        ctx->EnableVertexAttribArray(tcLoc);
         CHECK_FOR_GL_ERROR();
  
-        glVertexAttribPointer(tcLoc, 2, GL_FLOAT, GL_FALSE, 0, texc);
+        // client side arrays
+        ctx->BindBuffer(GL_ARRAY_BUFFER, 0);
+        ctx->VertexAttribPointer(tcLoc, 2, GL_FLOAT, 0, texc);
         CHECK_FOR_GL_ERROR();
 
-        glUniform2f(dimLoc, (float)canvas->GetWidth(), (float)canvas->GetHeight());
+        ctx->Uniform2f(dimLoc, (float)canvas->GetWidth(), (float)canvas->GetHeight());
         CHECK_FOR_GL_ERROR();
 
         CompositeCanvas::ContainerIterator it = canvas->CanvasesBegin();
@@ -130,23 +152,23 @@ void GLRenderer::Render(CompositeCanvas* canvas) {
             float col[4];
             it->color.ToArray(col);
             col[3] = it->opacity;
-            glUniform4fv(clLoc, 1, col);
+            ctx->Uniform4fv(clLoc, 1, col);
             CHECK_FOR_GL_ERROR();
 
-            glBindTexture(GL_TEXTURE_2D, ctx->LookupTexture(ctx->LookupCanvas(it->canvas).color0.get()));
-            glUniform1i(txLoc, 0);
+            ctx->BindTexture(GL_TEXTURE_2D, ctx->LookupTexture(ctx->LookupCanvas(it->canvas).color0.get()));
+            ctx->Uniform1i(txLoc, 0);
             CHECK_FOR_GL_ERROR();
 
-            glVertexAttribPointer(vsLoc, 2, GL_FLOAT, GL_FALSE, 0, vert);            
+            ctx->VertexAttribPointer(vsLoc, 2, GL_FLOAT, 0, vert);            
             CHECK_FOR_GL_ERROR();
 
-            glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+            ctx->DrawArrays(GL_TRIANGLE_STRIP, 0, 4);
             CHECK_FOR_GL_ERROR();
         }
 
-        glUseProgram(0);
-        glDisableVertexAttribArray(vsLoc);
-        glDisableVertexAttribArray(tcLoc);
+        ctx->UseProgram(0);
+        ctx->DisableVertexAttribArray(vsLoc);
+        ctx->DisableVertexAttribArray(tcLoc);
 
 #if FIXED_FUNCTION
     }
@@ -193,8 +215,8 @@ void GLRenderer::Render(CompositeCanvas* canvas) {
             col[3] = col[7] = col[11] = col[15] =  it->opacity;
             glColorPointer(4, GL_FLOAT, 0, col);
 
-            glBindTexture(GL_TEXTURE_2D, ctx->LookupTexture(ctx->LookupCanvas(it->canvas).color0.get()));
-            glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+            ctx->BindTexture(GL_TEXTURE_2D, ctx->LookupTexture(ctx->LookupCanvas(it->canvas).color0.get()));
+            ctx->DrawArrays(GL_TRIANGLE_STRIP, 0, 4);
             CHECK_FOR_GL_ERROR();
         }
 
@@ -208,30 +230,34 @@ void GLRenderer::Render(CompositeCanvas* canvas) {
     if (ctx->FBOSupport()) {
         if (level > 0) {
             //bind the previous back buffer again
-            glBindFramebuffer(GL_FRAMEBUFFER, prevFbo);
+            ctx->BindFramebuffer(prevFbo);
         }
     }
     else {
-        glBindTexture(GL_TEXTURE_2D, ctx->LookupTexture(ctx->LookupCanvas(canvas).color0.get()));
+        ctx->BindTexture(GL_TEXTURE_2D, ctx->LookupTexture(ctx->LookupCanvas(canvas).color0.get()));
         CHECK_FOR_GL_ERROR();
         glCopyTexImage2D(GL_TEXTURE_2D, 0, GLContext::GLInternalColorFormat(canvas->GetColorFormat()), 
                          0, 0, canvas->GetWidth(), canvas->GetHeight(), 0);
         CHECK_FOR_GL_ERROR();
     }
-    glBindTexture(GL_TEXTURE_2D, 0);
-    glEnable(GL_DEPTH_TEST);
-    glDepthMask(GL_TRUE);
+    ctx->BindTexture(GL_TEXTURE_2D, 0);
+    ctx->Enable(GL_DEPTH_TEST);
+    ctx->DepthMask(GL_TRUE);
     glColorMask (GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
-    glDisable(GL_BLEND);
+    ctx->Disable(GL_BLEND);
+    statistics.canvases.push_back(std::make_pair((ICanvas*)canvas, ctx->GetStatistics() - start));
+    if (timer) timer->End();
 }
 
 void GLRenderer::Render(Canvas3D* canvas) {
-    GLint prevFbo;
+    OE_PROFILE_SCOPE("GLRenderer::Render(Canvas3D)");
+    GLContext::Statistics start = ctx->GetStatistics();
+    GLuint prevFbo = 0;
 
     if (ctx->FBOSupport() && level > 0) {
         // logger.info << "hey!" << logger.end;
-        glGetIntegerv(GL_FRAMEBUFFER_BINDING, &prevFbo);
-        glBindFramebuffer(GL_FRAMEBUFFER, ctx->LookupFBO(canvas));
+        prevFbo = ctx->GetFramebuffer();
+        ctx->BindFramebuffer(ctx->LookupFBO(canvas));
         glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, 
                                ctx->LookupTexture(ctx->LookupCanvas(canvas).color0.get()), 0);
         glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, 
@@ -284,24 +310,24 @@ void GLRenderer::Render(Canvas3D* canvas) {
     if (ctx->FBOSupport()) {
         if (level > 0) {
             //bind the previous back buffer again
-            glBindFramebuffer(GL_FRAMEBUFFER, prevFbo);
+            ctx->BindFramebuffer(prevFbo);
         }
     }
     else {
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, ctx->LookupTexture(ctx->LookupCanvas(canvas).color0.get()));
+        ctx->BindTexture(0, GL_TEXTURE_2D, ctx->LookupTexture(ctx->LookupCanvas(canvas).color0.get()));
         CHECK_FOR_GL_ERROR();
         glCopyTexImage2D(GL_TEXTURE_2D, 0, GLContext::GLInternalColorFormat(canvas->GetColorFormat()), 
                          0, 0, canvas->GetWidth(), canvas->GetHeight(), 0);
         CHECK_FOR_GL_ERROR();
-        glBindTexture(GL_TEXTURE_2D, 0);
+        ctx->BindTexture(0, GL_TEXTURE_2D, 0);
     }
+    statistics.canvases.push_back(std::make_pair((ICanvas*)canvas, ctx->GetStatistics() - start));
 }
 
 void GLRenderer::Handle(Core::InitializeEventArg arg) {
     ctx->Init();
     // Enable depth testing
-    glEnable(GL_DEPTH_TEST);						   
+    ctx->Enable(GL_DEPTH_TEST);						   
     CHECK_FOR_GL_ERROR();
 
 #if FIXED_FUNCTION
@@ -324,7 +350,7 @@ void GLRenderer::Handle(Core::InitializeEventArg arg) {
 
 
     // resolve quadShader locations
-    GLContext::GLShader glShader = ctx->LookupShader(quadShader.get());
+    GLContext::GLShader& glShader = ctx->LookupShader(quadShader.get());
     GLuint shaderId = glShader.id;
     vsLoc = glGetAttribLocation(shaderId, "vertex");
     tcLoc = glGetAttribLocation(shaderId, "tcIn");
@@ -380,11 +406,11 @@ if (ctx->ShaderSupport()) {
                                      canvas->GetViewingVolume()->GetProjectionMatrix()).GetInverse();
     skybox->GetUniform("oe_ViewProjMatrixInverse").Set(viewProjInv);
 
-    glDisable(GL_DEPTH_TEST);
-    ctx->Apply(skybox);
-    glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+    ctx->Disable(GL_DEPTH_TEST);
+    if (ctx->Apply(skybox))
+        ctx->DrawArrays(GL_TRIANGLE_STRIP, 0, 4);
     ctx->Release(skybox);
-    glEnable(GL_DEPTH_TEST);
+    ctx->Enable(GL_DEPTH_TEST);
 
 #if FIXED_FUNCTION
  }        
@@ -396,9 +422,23 @@ void GLRenderer::Handle(Core::DeinitializeEventArg arg) {
 }
     
 void GLRenderer::Handle(Core::ProcessEventArg arg) {
+    OE_PROFILE_SCOPE("GLRenderer frame");
     // logger.info << "hep!" << logger.end;
     this->arg = arg;
+    ++frame;
+    GLContext::Statistics start = ctx->GetStatistics();
+    statistics.frame = frame;
+    statistics.canvases.clear();
+    ctx->BeginFrame();
+    bounds->ReleaseDead();
+    if (timer) {
+        timer->BeginFrame(frame);
+        timer->Begin("frame");
+    }
     canvas->Accept(*cv);
+    if (timer) timer->End();
+    statistics.total = ctx->GetStatistics() - start;
+    statisticsEvent.Notify(statistics);
 }
 
 IEvent<RenderingEventArg>& GLRenderer::InitializeEvent() {
@@ -421,6 +461,10 @@ IEvent<RenderingEventArg>& GLRenderer::DeinitializeEvent() {
     return deinitialize;
 }
 
+IEvent<FrameStatistics>& GLRenderer::FrameStatisticsEvent() {
+    return statisticsEvent;
+}
+
 void GLRenderer::SetCanvas(ICanvas* canvas) {
     this->canvas = canvas;
 }
@@ -468,6 +512,69 @@ GLContext* GLRenderer::GetContext() {
     return ctx;
 }
 
+BoundsCache* GLRenderer::GetBoundsCache() {
+    return bounds;
+}
+
+BoundingVolumeHierarchy* GLRenderer::CreateBoundingVolumeHierarchy(ISceneNode* scene) {
+    BoundingVolumeHierarchy*& bvh = hierarchies[scene];
+    if (bvh == NULL) 
+        bvh = new BoundingVolumeHierarchy(scene, bounds);
+    return bvh;
+}
+
+void GLRenderer::DestroyBoundingVolumeHierarchy(ISceneNode* scene) {
+    map<ISceneNode*, BoundingVolumeHierarchy*>::iterator it = hierarchies.find(scene);
+    if (it == hierarchies.end()) return;
+    delete it->second;
+    hierarchies.erase(it);
+}
+
+BoundingVolumeHierarchy* GLRenderer::LookupBoundingVolumeHierarchy(ISceneNode* scene) {
+    map<ISceneNode*, BoundingVolumeHierarchy*>::iterator it = hierarchies.find(scene);
+    if (it == hierarchies.end()) return NULL;
+    it->second->Update(frame);
+    return it->second;
+}
+
+void GLRenderer::SetOcclusionCuller(OcclusionCuller* culler) {
+    occlusionCuller = culler;
+}
+
+OcclusionCuller* GLRenderer::GetOcclusionCuller() {
+    return occlusionCuller;
+}
+
+void GLRenderer::SetTriangleSorting(Geometry::MeshPtr mesh, bool enable) {
+    rv->SetTriangleSorting(mesh, enable);
+}
+
+unsigned int GLRenderer::GetFrame() {
+    return frame;
+}
+
+void GLRenderer::SetTiming(bool enable) {
+    if (enable == (timer != NULL)) return;
+    if (enable) timer = new FrameTimer();
+    else {
+        delete timer;
+        timer = NULL;
+    }
+    initialize.SetTimer(timer);
+    preProcess.SetTimer(timer);
+    process.SetTimer(timer);
+    postProcess.SetTimer(timer);
+    deinitialize.SetTimer(timer);
+}
+
+FrameTimer* GLRenderer::GetFrameTimer() {
+    return timer;
+}
+
+const FrameStatistics& GLRenderer::GetFrameStatistics() {
+    return statistics;
+}
+
 } // NS OpenGL
 } // NS Renderers
 } // NS OpenEngine
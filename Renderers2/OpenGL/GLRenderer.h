@@ -17,6 +17,7 @@
 #include <Math/RGBAColor.h>
 
 #include <Renderers2/OpenGL/GLContext.h>
+#include <Renderers2/OpenGL/FrameTimer.h>
 
 namespace OpenEngine {
     namespace Display {
@@ -33,7 +34,17 @@ namespace OpenEngine {
         class Shader;
         typedef boost::shared_ptr<ShaderResource> ShaderResourcePtr;
     }
+    namespace Scene {
+        class ISceneNode;
+    }
+    namespace Geometry {
+        class Mesh;
+        typedef boost::shared_ptr<Mesh> MeshPtr;
+    }
 namespace Renderers2 {
+    class BoundsCache;
+    class BoundingVolumeHierarchy;
+    class OcclusionCuller;
 namespace OpenGL {
 
 using Display2::ICanvas;
@@ -46,6 +57,7 @@ using Core::IModule;
 using Core::IEvent;
 using Core::Event;
 using Math::RGBAColor;
+using Scene::ISceneNode;
 
 class GLRenderer;
 class RenderingView;
@@ -62,6 +74,20 @@ public:
         : canvas(canvas), renderer(renderer), time(time), approx(approx) {}
 };
 
+/**
+ * Work sent to GL by the renderer in a frame, in total and for each
+ * canvas rendered. The work of a composite canvas does not include
+ * its children, and work outside the canvases, like uploads of
+ * changed data at the start of the frame, only counts in the total.
+ */
+class FrameStatistics {
+public:
+    unsigned int frame;
+    GLContext::Statistics total;
+    vector<pair<ICanvas*, GLContext::Statistics> > canvases; // in rendering order
+    FrameStatistics(): frame(0) {}
+};
+
 /**
  * OpenGL Renderer
  *
@@ -71,20 +97,27 @@ class GLRenderer :
         public IModule {
 private:
     GLContext* ctx;
+    BoundsCache* bounds;
+    map<ISceneNode*, BoundingVolumeHierarchy*> hierarchies;
+    OcclusionCuller* occlusionCuller;
     ICanvas* canvas;
     bool init;
     int level; // canvas recursion level
+    unsigned int frame;
 
     RenderingView* rv;
     LightVisitor* lv;
     CanvasVisitor* cv;
 
     // Event lists for the rendering phases.
-    Event<RenderingEventArg> initialize;
-    Event<RenderingEventArg> preProcess;
-    Event<RenderingEventArg> process;
-    Event<RenderingEventArg> postProcess;
-    Event<RenderingEventArg> deinitialize;
+    TimedEvent<RenderingEventArg> initialize;
+    TimedEvent<RenderingEventArg> preProcess;
+    TimedEvent<RenderingEventArg> process;
+    TimedEvent<RenderingEventArg> postProcess;
+    TimedEvent<RenderingEventArg> deinitialize;
+    FrameTimer* timer;
+    FrameStatistics statistics;
+    Event<FrameStatistics> statisticsEvent;
 
     void ApplyViewingVolume(Display::IViewingVolume& volume);
 
@@ -134,6 +167,11 @@ public:
     IEvent<RenderingEventArg>& PostProcessEvent();
     IEvent<RenderingEventArg>& DeinitializeEvent();
 
+    /**
+     * Statistics of each frame, notified after the frame is rendered.
+     */
+    IEvent<FrameStatistics>& FrameStatisticsEvent();
+
     /**
      * Get the current renderer stage.
      */
@@ -147,6 +185,61 @@ public:
 
     GLContext* GetContext();
 
+    /**
+     * Bounding boxes of the vertex data blocks, shared by the
+     * culling visitors.
+     */
+    BoundsCache* GetBoundsCache();
+
+    /**
+     * Build a bounding volume hierarchy over a scene, used for
+     * hierarchical culling when rendering the scene. Call Rebuild on
+     * the hierarchy when nodes are added or removed.
+     */
+    BoundingVolumeHierarchy* CreateBoundingVolumeHierarchy(ISceneNode* scene);
+    void DestroyBoundingVolumeHierarchy(ISceneNode* scene);
+
+    /**
+     * Get the hierarchy of a scene, refitted to the current frame,
+     * or NULL if none has been created.
+     */
+    BoundingVolumeHierarchy* LookupBoundingVolumeHierarchy(ISceneNode* scene);
+
+    /**
+     * Set the occlusion culler used when rendering 3d canvases, or
+     * NULL to disable occlusion culling. The culler is not owned by
+     * the renderer.
+     */
+    void SetOcclusionCuller(OcclusionCuller* culler);
+    OcclusionCuller* GetOcclusionCuller();
+
+    /**
+     * Sort the triangles of a large transparent mesh back to front
+     * every frame, instead of splitting it into smaller meshes.
+     */
+    void SetTriangleSorting(Geometry::MeshPtr mesh, bool enable);
+
+    /**
+     * Number of processed frames.
+     */
+    unsigned int GetFrame();
+
+    /**
+     * Time the rendering phases and each of their listeners on the
+     * CPU and GPU. Results lag a few frames behind, see FrameTimer.
+     * Do not call it while rendering.
+     */
+    void SetTiming(bool enable);
+
+    /**
+     * The frame timer, or NULL if timing is disabled.
+     */
+    FrameTimer* GetFrameTimer();
+
+    /**
+     * Statistics of the last rendered frame.
+     */
+    const FrameStatistics& GetFrameStatistics();
 
 protected:
     RendererStage stage;
@@ -14,6 +14,7 @@
 #include <Scene/DirectionalLightNode.h>
 #include <Scene/PointLightNode.h>
 #include <Scene/SpotLightNode.h>
+#include <Utils/Profiler.h>
 
 #include <Logging/Logger.h>
 
@@ -178,6 +179,7 @@ void LightVisitor::VisitSpotLightNode(SpotLightNode* node) {
 }
 
 void LightVisitor::Handle(RenderingEventArg arg) {
+    OE_PROFILE_SCOPE("LightVisitor::Handle");
     lights.clear();
     modelViewMatrix = arg.canvas->GetViewingVolume()->GetViewMatrix();
     #if OE_SAFE
@@ -0,0 +1,944 @@
+// Recording GL backend without a driver.
+// -------------------------------------------------------------------
+// Copyright (C) 2007 OpenEngine.dk (See AUTHORS)
+//
+// This program is free software; It is covered by the GNU General
+// Public License version 2 or any later version.
+// See the GNU General Public License for more details (see LICENSE).
+//--------------------------------------------------------------------
+
+#include <Meta/OpenGL.h>
+#include <Renderers2/OpenGL/NullGL.h>
+#include <cstdlib>
+#include <cstring>
+#include <cctype>
+#include <sstream>
+#include <algorithm>
+
+#ifndef GL_COMPLETION_STATUS_KHR
+#define GL_COMPLETION_STATUS_KHR 0x91B1
+#endif
+
+namespace OpenEngine {
+namespace Renderers2 {
+namespace OpenGL {
+
+using std::string;
+using std::vector;
+using std::map;
+using std::set;
+
+NullGL::Statistics NullGL::stats;
+std::ostream* NullGL::log = NULL;
+set<string> NullGL::disabled;
+GLuint NullGL::nextName = 1;
+map<GLuint, NullGL::ShaderObject> NullGL::shaders;
+map<GLuint, NullGL::ProgramObject> NullGL::programs;
+map<GLuint, GLsizeiptr> NullGL::bufferSizes;
+map<GLenum, GLuint> NullGL::boundBuffers;
+GLuint NullGL::framebuffer = 0;
+vector<char> NullGL::mapped;
+
+// Source reflection. The shaders are run through a minimal
+// preprocessor handling defines and conditionals, after which the
+// top level uniform, attribute and struct declarations are read.
+namespace {
+
+struct Member {
+    string type, name;
+    int size; // 0 if not an array
+};
+typedef map<string, vector<Member> > Structs;
+typedef map<string, string> Defines;
+
+bool IsIdentifier(char c) {
+    return isalnum(c) || c == '_';
+}
+
+vector<string> Tokenize(const string& s) {
+    vector<string> tokens;
+    unsigned int i = 0;
+    while (i < s.size()) {
+        if (isspace(s[i])) { ++i; continue; }
+        unsigned int start = i;
+        if (IsIdentifier(s[i]))
+            while (i < s.size() && (IsIdentifier(s[i]) || s[i] == '.')) ++i;
+        else ++i;
+        tokens.push_back(s.substr(start, i - start));
+    }
+    return tokens;
+}
+
+string StripComments(const string& s) {
+    string out;
+    for (unsigned int i = 0; i < s.size(); ++i) {
+        if (s[i] == '/' && i + 1 < s.size() && s[i+1] == '/') {
+            while (i < s.size() && s[i] != '\n') ++i;
+            out += '\n';
+        }
+        else if (s[i] == '/' && i + 1 < s.size() && s[i+1] == '*') {
+            i += 2;
+            while (i + 1 < s.size() && !(s[i] == '*' && s[i+1] == '/')) ++i;
+            ++i;
+            out += ' ';
+        }
+        else out += s[i];
+    }
+    return out;
+}
+
+string Resolve(string token, const Defines& defines) {
+    // follow object-like macros, bounded in case of cycles
+    for (unsigned int i = 0; i < 8; ++i) {
+        Defines::const_iterator it = defines.find(token);
+        if (it == defines.end()) break;
+        token = it->second;
+    }
+    return token;
+}
+
+/**
+ * Evaluates the conditions of #if and #elif: defined(), macros,
+ * numbers, !, && and || with parentheses. Anything else is false.
+ */
+class Condition {
+    const vector<string>& t;
+    const Defines& defines;
+    unsigned int i;
+
+    bool Next(const char* s) {
+        if (i < t.size() && t[i] == s) { ++i; return true; }
+        return false;
+    }
+    bool Or() {
+        bool v = And();
+        while (i + 1 < t.size() && t[i] == "|" && t[i+1] == "|") {
+            i += 2;
+            v = And() || v;
+        }
+        return v;
+    }
+    bool And() {
+        bool v = Unary();
+        while (i + 1 < t.size() && t[i] == "&" && t[i+1] == "&") {
+            i += 2;
+            v = Unary() && v;
+        }
+        return v;
+    }
+    bool Unary() {
+        if (i >= t.size()) return false;
+        if (Next("!")) return !Unary();
+        if (Next("(")) {
+            bool v = Or();
+            Next(")");
+            return v;
+        }
+        if (Next("defined")) {
+            bool paren = Next("(");
+            bool v = i < t.size() && defines.find(t[i]) != defines.end();
+            ++i;
+            if (paren) Next(")");
+            return v;
+        }
+        return atoi(Resolve(t[i++], defines).c_str()) != 0;
+    }
+
+public:
+    Condition(const vector<string>& t, const Defines& defines)
+        : t(t), defines(defines), i(0) {}
+    bool Evaluate() { return Or(); }
+};
+
+string Preprocess(const string& source, Defines& defines) {
+    // each level: active, some branch taken
+    vector<std::pair<bool, bool> > levels;
+    bool active = true;
+    string out;
+    std::istringstream in(StripComments(source));
+    string line;
+    while (std::getline(in, line)) {
+        unsigned int i = 0;
+        while (i < line.size() && isspace(line[i])) ++i;
+        if (i == line.size() || line[i] != '#') {
+            if (active) out += line + '\n';
+            continue;
+        }
+        vector<string> t = Tokenize(line.substr(i + 1));
+        if (t.empty()) continue;
+        if (t[0] == "ifdef" || t[0] == "ifndef" || t[0] == "if") {
+            bool v;
+            if (t[0] == "if")
+                v = Condition(vector<string>(t.begin() + 1, t.end()), defines).Evaluate();
+            else
+                v = t.size() > 1 && (defines.find(t[1]) != defines.end()) == (t[0] == "ifdef");
+            levels.push_back(std::make_pair(active && v, v));
+        }
+        else if (t[0] == "elif" && !levels.empty()) {
+            bool outer = levels.size() < 2 || levels[levels.size() - 2].first;
+            bool v = !levels.back().second &&
+                Condition(vector<string>(t.begin() + 1, t.end()), defines).Evaluate();
+            levels.back() = std::make_pair(outer && v, levels.back().second || v);
+        }
+        else if (t[0] == "else" && !levels.empty()) {
+            bool outer = levels.size() < 2 || levels[levels.size() - 2].first;
+            levels.back() = std::make_pair(outer && !levels.back().second, true);
+        }
+        else if (t[0] == "endif" && !levels.empty())
+            levels.pop_back();
+        else if (t[0] == "define" && active && t.size() > 1)
+            defines[t[1]] = t.size() > 2 && t[2] != "(" ? t[2] : "1";
+        else if (t[0] == "undef" && active && t.size() > 1)
+            defines.erase(t[1]);
+        active = levels.empty() || levels.back().first;
+    }
+    return out;
+}
+
+GLenum GLType(const string& type) {
+    if (type == "float") return GL_FLOAT;
+    if (type == "vec2") return GL_FLOAT_VEC2;
+    if (type == "vec3") return GL_FLOAT_VEC3;
+    if (type == "vec4") return GL_FLOAT_VEC4;
+    if (type == "int") return GL_INT;
+    if (type == "bool") return GL_BOOL;
+    if (type == "mat2") return GL_FLOAT_MAT2;
+    if (type == "mat3") return GL_FLOAT_MAT3;
+    if (type == "mat4") return GL_FLOAT_MAT4;
+    if (type == "sampler2D") return GL_SAMPLER_2D;
+    if (type == "sampler2DShadow") return GL_SAMPLER_2D_SHADOW;
+    if (type == "samplerCube") return GL_SAMPLER_CUBE;
+    return GL_FLOAT;
+}
+
+// skip a bracketed group starting at t[i], returning the index past it
+unsigned int Skip(const vector<string>& t, unsigned int i) {
+    const string open = t[i];
+    const string close = open == "(" ? ")" : open == "[" ? "]" : "}";
+    int depth = 0;
+    for (; i < t.size(); ++i) {
+        if (t[i] == open) ++depth;
+        else if (t[i] == close && --depth == 0) return i + 1;
+    }
+    return i;
+}
+
+bool IsQualifier(const string& s) {
+    return s == "lowp" || s == "mediump" || s == "highp" ||
+        s == "const" || s == "invariant" || s == "flat";
+}
+
+/**
+ * Read the declarators following a type: "a, b[N];". Returns the
+ * index past the terminating semicolon.
+ */
+unsigned int Declarators(const vector<string>& t, unsigned int i, const string& type,
+                         const Defines& defines, vector<Member>& out) {
+    while (i < t.size() && t[i] != ";") {
+        Member m;
+        m.type = type;
+        m.name = t[i++];
+        m.size = 0;
+        if (i < t.size() && t[i] == "[") {
+            if (i + 1 < t.size()) m.size = atoi(Resolve(t[i+1], defines).c_str());
+            if (m.size < 1) m.size = 1;
+            i = Skip(t, i);
+        }
+        out.push_back(m);
+        // skip initializers up to the next declarator
+        while (i < t.size() && t[i] != "," && t[i] != ";") {
+            if (t[i] == "(" || t[i] == "[" || t[i] == "{") i = Skip(t, i);
+            else ++i;
+        }
+        if (i < t.size() && t[i] == ",") ++i;
+    }
+    return i + 1;
+}
+
+void Expand(const string& name, const Member& m, const Structs& structs,
+            vector<Member>& out) {
+    Structs::const_iterator s = structs.find(m.type);
+    if (s == structs.end()) {
+        Member leaf = m;
+        leaf.name = m.size ? name + "[0]" : name;
+        out.push_back(leaf);
+        return;
+    }
+    unsigned int count = m.size ? m.size : 1;
+    for (unsigned int e = 0; e < count; ++e) {
+        string prefix = name;
+        if (m.size) {
+            std::ostringstream os;
+            os << name << "[" << e << "]";
+            prefix = os.str();
+        }
+        for (unsigned int j = 0; j < s->second.size(); ++j)
+            Expand(prefix + "." + s->second[j].name, s->second[j], structs, out);
+    }
+}
+
+void Parse(const string& source, bool vertex, vector<Member>& uniforms,
+           vector<Member>& attributes, vector<string>& blocks) {
+    Defines defines;
+    vector<string> t = Tokenize(Preprocess(source, defines));
+    Structs structs;
+    unsigned int i = 0;
+    while (i < t.size()) {
+        if (t[i] == "(" || t[i] == "{") {
+            // function parameters, bodies and layout qualifiers
+            i = Skip(t, i);
+        }
+        else if (t[i] == "struct" && i + 2 < t.size() && t[i+2] == "{") {
+            vector<Member>& members = structs[t[i+1]];
+            i += 3;
+            while (i < t.size() && t[i] != "}") {
+                while (i < t.size() && IsQualifier(t[i])) ++i;
+                if (i >= t.size()) break;
+                string type = Resolve(t[i], defines);
+                i = Declarators(t, i + 1, type, defines, members);
+            }
+            while (i < t.size() && t[i] != ";") ++i;
+            ++i;
+        }
+        else if (t[i] == "uniform" || t[i] == "attribute" || (vertex && t[i] == "in")) {
+            bool uniform = t[i] == "uniform";
+            ++i;
+            while (i < t.size() && IsQualifier(t[i])) ++i;
+            if (i >= t.size()) break;
+            if (uniform && i + 1 < t.size() && t[i+1] == "{") {
+                blocks.push_back(t[i]);
+                i = Skip(t, i + 1);
+                while (i < t.size() && t[i] != ";") ++i;
+                ++i;
+                continue;
+            }
+            string type = Resolve(t[i], defines);
+            vector<Member> declared;
+            i = Declarators(t, i + 1, type, defines, declared);
+            for (unsigned int j = 0; j < declared.size(); ++j) {
+                if (uniform) Expand(declared[j].name, declared[j], structs, uniforms);
+                else if (vertex) Expand(declared[j].name, declared[j], structs, attributes);
+            }
+        }
+        else ++i;
+    }
+}
+
+} // anonymous namespace
+
+void NullGL::Reflect(ProgramObject& program) {
+    program.uniforms.clear();
+    program.attributes.clear();
+    program.blocks.clear();
+    GLint uniformLocation = 0, attributeLocation = 0;
+    for (unsigned int i = 0; i < program.shaders.size(); ++i) {
+        map<GLuint, ShaderObject>::iterator shader = shaders.find(program.shaders[i]);
+        if (shader == shaders.end()) continue;
+        vector<Member> uniforms, attributes;
+        vector<string> blocks;
+        Parse(shader->second.source, shader->second.type == GL_VERTEX_SHADER,
+              uniforms, attributes, blocks);
+
+        // shared declarations are reported once
+        GLint offset;
+        for (unsigned int j = 0; j < uniforms.size(); ++j) {
+            if (Find(program.uniforms, uniforms[j].name.c_str(), offset)) continue;
+            Variable v;
+            v.name = uniforms[j].name;
+            v.type = GLType(uniforms[j].type);
+            v.size = uniforms[j].size ? uniforms[j].size : 1;
+            v.location = uniformLocation;
+            uniformLocation += v.size;
+            program.uniforms.push_back(v);
+        }
+        for (unsigned int j = 0; j < attributes.size(); ++j) {
+            if (Find(program.attributes, attributes[j].name.c_str(), offset)) continue;
+            Variable v;
+            v.name = attributes[j].name;
+            v.type = GLType(attributes[j].type);
+            v.size = attributes[j].size ? attributes[j].size : 1;
+            v.location = attributeLocation;
+            // matrices take a location per column
+            GLint columns = v.type == GL_FLOAT_MAT4 ? 4 : v.type == GL_FLOAT_MAT3 ? 3 : v.type == GL_FLOAT_MAT2 ? 2 : 1;
+            attributeLocation += v.size * columns;
+            program.attributes.push_back(v);
+        }
+        for (unsigned int j = 0; j < blocks.size(); ++j) {
+            bool known = false;
+            for (unsigned int k = 0; k < program.blocks.size(); ++k)
+                known = known || program.blocks[k] == blocks[j];
+            if (!known) program.blocks.push_back(blocks[j]);
+        }
+    }
+}
+
+/**
+ * Find a variable by name. Array elements "a[i]" and the array name
+ * "a" match the variable "a[0]", with the element in offset.
+ */
+const NullGL::Variable* NullGL::Find(const vector<Variable>& vars, const GLchar* name, GLint& offset) {
+    string n(name);
+    offset = 0;
+    string base = n;
+    string::size_type bracket = n.rfind('[');
+    if (bracket != string::npos && n[n.size() - 1] == ']') {
+        offset = atoi(n.substr(bracket + 1).c_str());
+        base = n.substr(0, bracket);
+    }
+    for (unsigned int i = 0; i < vars.size(); ++i) {
+        if (vars[i].name == n) {
+            offset = 0;
+            return &vars[i];
+        }
+        if (vars[i].name == base + "[0]" && offset < vars[i].size)
+            return &vars[i];
+    }
+    return NULL;
+}
+
+void NullGL::Copy(const string& s, GLsizei bufSize, GLsizei* length, GLchar* dst) {
+    GLsizei n = 0;
+    if (bufSize > 0 && dst) {
+        n = std::min<GLsizei>(s.size(), bufSize - 1);
+        memcpy(dst, s.c_str(), n);
+        dst[n] = '\0';
+    }
+    if (length) *length = n;
+}
+
+void NullGL::Record(const char* function) {
+    ++stats.calls;
+    ++stats.functions[function];
+    if (log) *log << function << '\n';
+}
+
+void NullGL::State(const char* function) {
+    Record(function);
+    ++stats.stateChanges;
+}
+
+void NullGL::Upload(const char* function, unsigned long long bytes) {
+    Record(function);
+    stats.bytesUploaded += bytes;
+}
+
+void NullGL::Draw(const char* function, unsigned long long vertices) {
+    Record(function);
+    ++stats.drawCalls;
+    stats.vertices += vertices;
+}
+
+void NullGL::Generate(GLsizei n, GLuint* names) {
+    for (GLsizei i = 0; i < n; ++i)
+        names[i] = nextName++;
+    stats.objectsCreated += n;
+}
+
+void NullGL::Delete(GLsizei n, const GLuint* names) {
+    for (GLsizei i = 0; i < n; ++i)
+        if (names[i]) ++stats.objectsDeleted;
+}
+
+unsigned int NullGL::PixelSize(GLenum format, GLenum type) {
+    unsigned int channels;
+    switch (format) {
+    case GL_RGBA:
+    case GL_BGRA: channels = 4; break;
+    case GL_RGB:
+    case GL_BGR: channels = 3; break;
+    case GL_LUMINANCE_ALPHA: channels = 2; break;
+    default: channels = 1;
+    }
+    switch (type) {
+    case GL_FLOAT:
+    case GL_INT:
+    case GL_UNSIGNED_INT: return channels * 4;
+    case GL_SHORT:
+    case GL_UNSIGNED_SHORT: return channels * 2;
+    default: return channels;
+    }
+}
+
+const NullGL::Statistics& NullGL::GetStatistics() {
+    return stats;
+}
+
+void NullGL::ResetStatistics() {
+    stats = Statistics();
+}
+
+void NullGL::SetLog(std::ostream* log) {
+    NullGL::log = log;
+}
+
+void NullGL::SetExtension(const string& name, bool supported) {
+    if (supported) disabled.erase(name);
+    else disabled.insert(name);
+}
+
+bool NullGL::IsSupported(const string& name) {
+    return disabled.find(name) == disabled.end();
+}
+
+// GLEW
+
+GLenum NullGL::Init() {
+    return GLEW_OK;
+}
+
+GLboolean NullGL::GetExtension(const char* name) {
+    return IsSupported(name) ? GL_TRUE : GL_FALSE;
+}
+
+GLboolean NullGL::IsSupportedGL(const char* name) {
+    // a space separated list, as for glewIsSupported
+    std::istringstream names(name);
+    string n;
+    while (names >> n)
+        if (!IsSupported(n)) return GL_FALSE;
+    return GL_TRUE;
+}
+
+const GLubyte* NullGL::GetGLEWString(GLenum name) {
+    return (const GLubyte*)"null";
+}
+
+const GLubyte* NullGL::GetErrorString(GLenum error) {
+    return (const GLubyte*)"";
+}
+
+// state
+
+void NullGL::Enable(GLenum cap) { State("glEnable"); }
+void NullGL::Disable(GLenum cap) { State("glDisable"); }
+void NullGL::EnableClientState(GLenum array) { State("glEnableClientState"); }
+void NullGL::DisableClientState(GLenum array) { State("glDisableClientState"); }
+void NullGL::BlendFunc(GLenum sfactor, GLenum dfactor) { State("glBlendFunc"); }
+void NullGL::BlendEquation(GLenum mode) { State("glBlendEquation"); }
+void NullGL::BlendColor(GLclampf r, GLclampf g, GLclampf b, GLclampf a) { State("glBlendColor"); }
+void NullGL::DepthMask(GLboolean flag) { State("glDepthMask"); }
+void NullGL::ColorMask(GLboolean r, GLboolean g, GLboolean b, GLboolean a) { State("glColorMask"); }
+void NullGL::CullFace(GLenum mode) { State("glCullFace"); }
+void NullGL::PolygonMode(GLenum face, GLenum mode) { State("glPolygonMode"); }
+void NullGL::PolygonOffset(GLfloat factor, GLfloat units) { State("glPolygonOffset"); }
+void NullGL::ShadeModel(GLenum mode) { State("glShadeModel"); }
+void NullGL::Hint(GLenum target, GLenum mode) { State("glHint"); }
+void NullGL::Viewport(GLint x, GLint y, GLsizei width, GLsizei height) { State("glViewport"); }
+void NullGL::ClearColor(GLclampf r, GLclampf g, GLclampf b, GLclampf a) { State("glClearColor"); }
+void NullGL::Clear(GLbitfield mask) { Record("glClear"); }
+void NullGL::PixelStorei(GLenum pname, GLint param) { State("glPixelStorei"); }
+
+GLenum NullGL::GetError() {
+    Record("glGetError");
+    return GL_NO_ERROR;
+}
+
+void NullGL::GetIntegerv(GLenum pname, GLint* params) {
+    Record("glGetIntegerv");
+    switch (pname) {
+    case GL_MAX_LIGHTS: *params = 8; break;
+    case GL_FRAMEBUFFER_BINDING: *params = framebuffer; break;
+    case GL_MAX_TEXTURE_SIZE: *params = 8192; break;
+    case GL_MAX_TEXTURE_UNITS:
+    case GL_MAX_TEXTURE_IMAGE_UNITS:
+    case GL_MAX_VERTEX_ATTRIBS: *params = 16; break;
+    default: *params = 0;
+    }
+}
+
+const GLubyte* NullGL::GetString(GLenum name) {
+    Record("glGetString");
+    switch (name) {
+    case GL_VENDOR: return (const GLubyte*)"OpenEngine";
+    case GL_RENDERER: return (const GLubyte*)"Null";
+    case GL_VERSION: return (const GLubyte*)"2.1 Null";
+    case GL_SHADING_LANGUAGE_VERSION: return (const GLubyte*)"1.20";
+    default: return (const GLubyte*)"";
+    }
+}
+
+// fixed function
+
+void NullGL::MatrixMode(GLenum mode) { State("glMatrixMode"); }
+void NullGL::LoadIdentity() { Record("glLoadIdentity"); }
+void NullGL::MultMatrixf(const GLfloat* m) { Record("glMultMatrixf"); }
+void NullGL::PushMatrix() { Record("glPushMatrix"); }
+void NullGL::PopMatrix() { Record("glPopMatrix"); }
+void NullGL::Ortho(GLdouble left, GLdouble right, GLdouble bottom, GLdouble top, GLdouble zNear, GLdouble zFar) { Record("glOrtho"); }
+void NullGL::Lightf(GLenum light, GLenum pname, GLfloat param) { State("glLightf"); }
+void NullGL::Lightfv(GLenum light, GLenum pname, const GLfloat* params) { State("glLightfv"); }
+void NullGL::LightModelfv(GLenum pname, const GLfloat* params) { State("glLightModelfv"); }
+void NullGL::Materialf(GLenum face, GLenum pname, GLfloat param) { State("glMaterialf"); }
+void NullGL::Materialfv(GLenum face, GLenum pname, const GLfloat* params) { State("glMaterialfv"); }
+void NullGL::TexEnvi(GLenum target, GLenum pname, GLint param) { State("glTexEnvi"); }
+void NullGL::ClientActiveTexture(GLenum texture) { State("glClientActiveTexture"); }
+void NullGL::VertexPointer(GLint size, GLenum type, GLsizei stride, const GLvoid* pointer) { State("glVertexPointer"); }
+void NullGL::NormalPointer(GLenum type, GLsizei stride, const GLvoid* pointer) { State("glNormalPointer"); }
+void NullGL::ColorPointer(GLint size, GLenum type, GLsizei stride, const GLvoid* pointer) { State("glColorPointer"); }
+void NullGL::TexCoordPointer(GLint size, GLenum type, GLsizei stride, const GLvoid* pointer) { State("glTexCoordPointer"); }
+void NullGL::Begin(GLenum mode) { Record("glBegin"); }
+void NullGL::End() { Draw("glEnd", 0); }
+
+// textures
+
+void NullGL::GenTextures(GLsizei n, GLuint* textures) {
+    Record("glGenTextures");
+    Generate(n, textures);
+}
+
+void NullGL::DeleteTextures(GLsizei n, const GLuint* textures) {
+    Record("glDeleteTextures");
+    Delete(n, textures);
+}
+
+void NullGL::BindTexture(GLenum target, GLuint texture) { State("glBindTexture"); }
+void NullGL::ActiveTexture(GLenum texture) { State("glActiveTexture"); }
+void NullGL::TexParameteri(GLenum target, GLenum pname, GLint param) { State("glTexParameteri"); }
+
+void NullGL::TexImage2D(GLenum target, GLint level, GLint internalFormat, GLsizei width, GLsizei height,
+                        GLint border, GLenum format, GLenum type, const GLvoid* pixels) {
+    // data comes from the pointer or a bound unpack buffer
+    bool data = pixels != NULL || boundBuffers[GL_PIXEL_UNPACK_BUFFER] != 0;
+    Upload("glTexImage2D", data ? (unsigned long long)width * height * PixelSize(format, type) : 0);
+}
+
+void NullGL::TexSubImage2D(GLenum target, GLint level, GLint xoffset, GLint yoffset, GLsizei width, GLsizei height,
+                           GLenum format, GLenum type, const GLvoid* pixels) {
+    Upload("glTexSubImage2D", (unsigned long long)width * height * PixelSize(format, type));
+}
+
+void NullGL::CopyTexImage2D(GLenum target, GLint level, GLenum internalFormat, GLint x, GLint y,
+                            GLsizei width, GLsizei height, GLint border) {
+    Record("glCopyTexImage2D");
+}
+
+// buffers
+
+void NullGL::GenBuffers(GLsizei n, GLuint* buffers) {
+    Record("glGenBuffers");
+    Generate(n, buffers);
+}
+
+void NullGL::DeleteBuffers(GLsizei n, const GLuint* buffers) {
+    Record("glDeleteBuffers");
+    Delete(n, buffers);
+    for (GLsizei i = 0; i < n; ++i)
+        bufferSizes.erase(buffers[i]);
+}
+
+void NullGL::BindBuffer(GLenum target, GLuint buffer) {
+    State("glBindBuffer");
+    boundBuffers[target] = buffer;
+}
+
+void NullGL::BindBufferBase(GLenum target, GLuint index, GLuint buffer) {
+    State("glBindBufferBase");
+    boundBuffers[target] = buffer;
+}
+
+void NullGL::BufferData(GLenum target, GLsizeiptr size, const GLvoid* data, GLenum usage) {
+    // allocation without data (orphaning) uploads nothing
+    Upload("glBufferData", data ? size : 0);
+    bufferSizes[boundBuffers[target]] = size;
+}
+
+void NullGL::BufferSubData(GLenum target, GLintptr offset, GLsizeiptr size, const GLvoid* data) {
+    Upload("glBufferSubData", size);
+}
+
+GLvoid* NullGL::MapBuffer(GLenum target, GLenum access) {
+    Record("glMapBuffer");
+    mapped.resize(std::max<GLsizeiptr>(bufferSizes[boundBuffers[target]], 1));
+    return &mapped[0];
+}
+
+GLvoid* NullGL::MapBufferRange(GLenum target, GLintptr offset, GLsizeiptr length, GLbitfield access) {
+    Record("glMapBufferRange");
+    mapped.resize(std::max<GLsizeiptr>(length, 1));
+    return &mapped[0];
+}
+
+GLboolean NullGL::UnmapBuffer(GLenum target) {
+    // whatever was mapped is taken as written
+    Upload("glUnmapBuffer", mapped.size());
+    mapped.clear();
+    return GL_TRUE;
+}
+
+void NullGL::GenVertexArrays(GLsizei n, GLuint* arrays) {
+    Record("glGenVertexArrays");
+    Generate(n, arrays);
+}
+
+void NullGL::DeleteVertexArrays(GLsizei n, const GLuint* arrays) {
+    Record("glDeleteVertexArrays");
+    Delete(n, arrays);
+}
+
+void NullGL::BindVertexArray(GLuint array) { State("glBindVertexArray"); }
+
+// framebuffers
+
+void NullGL::GenFramebuffers(GLsizei n, GLuint* framebuffers) {
+    Record("glGenFramebuffers");
+    Generate(n, framebuffers);
+}
+
+void NullGL::DeleteFramebuffers(GLsizei n, const GLuint* framebuffers) {
+    Record("glDeleteFramebuffers");
+    Delete(n, framebuffers);
+}
+
+void NullGL::BindFramebuffer(GLenum target, GLuint framebuffer) {
+    State("glBindFramebuffer");
+    NullGL::framebuffer = framebuffer;
+}
+
+void NullGL::FramebufferTexture2D(GLenum target, GLenum attachment, GLenum textarget, GLuint texture, GLint level) {
+    State("glFramebufferTexture2D");
+}
+
+GLenum NullGL::CheckFramebufferStatus(GLenum target) {
+    Record("glCheckFramebufferStatus");
+    return GL_FRAMEBUFFER_COMPLETE_EXT;
+}
+
+// shaders
+
+GLuint NullGL::CreateShader(GLenum type) {
+    Record("glCreateShader");
+    GLuint id;
+    Generate(1, &id);
+    shaders[id].type = type;
+    return id;
+}
+
+void NullGL::DeleteShader(GLuint shader) {
+    Record("glDeleteShader");
+    Delete(1, &shader);
+    shaders.erase(shader);
+}
+
+void NullGL::ShaderSource(GLuint shader, GLsizei count, const GLchar* const* sources, const GLint* lengths) {
+    Record("glShaderSource");
+    string& source = shaders[shader].source;
+    source.clear();
+    for (GLsizei i = 0; i < count; ++i) {
+        if (lengths && lengths[i] >= 0) source.append(sources[i], lengths[i]);
+        else source.append(sources[i]);
+    }
+}
+
+void NullGL::CompileShader(GLuint shader) { Record("glCompileShader"); }
+
+void NullGL::GetShaderiv(GLuint shader, GLenum pname, GLint* params) {
+    Record("glGetShaderiv");
+    switch (pname) {
+    case GL_SHADER_TYPE: *params = shaders[shader].type; break;
+    case GL_COMPILE_STATUS:
+    case GL_COMPLETION_STATUS_KHR: *params = GL_TRUE; break;
+    default: *params = 0;
+    }
+}
+
+void NullGL::GetShaderInfoLog(GLuint shader, GLsizei bufSize, GLsizei* length, GLchar* infoLog) {
+    Record("glGetShaderInfoLog");
+    Copy("", bufSize, length, infoLog);
+}
+
+GLuint NullGL::CreateProgram() {
+    Record("glCreateProgram");
+    GLuint id;
+    Generate(1, &id);
+    programs[id];
+    return id;
+}
+
+void NullGL::DeleteProgram(GLuint program) {
+    Record("glDeleteProgram");
+    Delete(1, &program);
+    programs.erase(program);
+}
+
+void NullGL::AttachShader(GLuint program, GLuint shader) {
+    Record("glAttachShader");
+    programs[program].shaders.push_back(shader);
+}
+
+void NullGL::GetAttachedShaders(GLuint program, GLsizei maxCount, GLsizei* count, GLuint* shaders) {
+    Record("glGetAttachedShaders");
+    const vector<GLuint>& attached = programs[program].shaders;
+    GLsizei n = std::min<GLsizei>(attached.size(), maxCount);
+    for (GLsizei i = 0; i < n; ++i)
+        shaders[i] = attached[i];
+    if (count) *count = n;
+}
+
+void NullGL::LinkProgram(GLuint program) {
+    Record("glLinkProgram");
+    Reflect(programs[program]);
+}
+
+void NullGL::UseProgram(GLuint program) { State("glUseProgram"); }
+void NullGL::ProgramParameteri(GLuint program, GLenum pname, GLint value) { Record("glProgramParameteri"); }
+
+void NullGL::ProgramBinary(GLuint program, GLenum binaryFormat, const GLvoid* binary, GLsizei length) {
+    Upload("glProgramBinary", length);
+}
+
+void NullGL::GetProgramBinary(GLuint program, GLsizei bufSize, GLsizei* length, GLenum* binaryFormat, GLvoid* binary) {
+    Record("glGetProgramBinary");
+    if (length) *length = 0;
+    if (binaryFormat) *binaryFormat = 0;
+}
+
+void NullGL::GetProgramiv(GLuint program, GLenum pname, GLint* params) {
+    Record("glGetProgramiv");
+    ProgramObject& p = programs[program];
+    GLint maxLength = 0;
+    switch (pname) {
+    case GL_LINK_STATUS:
+    case GL_VALIDATE_STATUS:
+    case GL_COMPLETION_STATUS_KHR: *params = GL_TRUE; break;
+    case GL_ATTACHED_SHADERS: *params = p.shaders.size(); break;
+    case GL_ACTIVE_UNIFORMS: *params = p.uniforms.size(); break;
+    case GL_ACTIVE_ATTRIBUTES: *params = p.attributes.size(); break;
+    case GL_ACTIVE_UNIFORM_BLOCKS: *params = p.blocks.size(); break;
+    case GL_ACTIVE_UNIFORM_MAX_LENGTH:
+        for (unsigned int i = 0; i < p.uniforms.size(); ++i)
+            maxLength = std::max<GLint>(maxLength, p.uniforms[i].name.size() + 1);
+        *params = maxLength;
+        break;
+    case GL_ACTIVE_ATTRIBUTE_MAX_LENGTH:
+        for (unsigned int i = 0; i < p.attributes.size(); ++i)
+            maxLength = std::max<GLint>(maxLength, p.attributes[i].name.size() + 1);
+        *params = maxLength;
+        break;
+    default: *params = 0;
+    }
+}
+
+void NullGL::GetProgramInfoLog(GLuint program, GLsizei bufSize, GLsizei* length, GLchar* infoLog) {
+    Record("glGetProgramInfoLog");
+    Copy("", bufSize, length, infoLog);
+}
+
+void NullGL::GetActiveUniform(GLuint program, GLuint index, GLsizei bufSize, GLsizei* length,
+                              GLint* size, GLenum* type, GLchar* name) {
+    Record("glGetActiveUniform");
+    const Variable& v = programs[program].uniforms.at(index);
+    Copy(v.name, bufSize, length, name);
+    *size = v.size;
+    *type = v.type;
+}
+
+void NullGL::GetActiveAttrib(GLuint program, GLuint index, GLsizei bufSize, GLsizei* length,
+                             GLint* size, GLenum* type, GLchar* name) {
+    Record("glGetActiveAttrib");
+    const Variable& v = programs[program].attributes.at(index);
+    Copy(v.name, bufSize, length, name);
+    *size = v.size;
+    *type = v.type;
+}
+
+void NullGL::GetActiveUniformBlockName(GLuint program, GLuint index, GLsizei bufSize, GLsizei* length, GLchar* name) {
+    Record("glGetActiveUniformBlockName");
+    Copy(programs[program].blocks.at(index), bufSize, length, name);
+}
+
+void NullGL::UniformBlockBinding(GLuint program, GLuint index, GLuint binding) { Record("glUniformBlockBinding"); }
+
+GLint NullGL::GetUniformLocation(GLuint program, const GLchar* name) {
+    Record("glGetUniformLocation");
+    GLint offset;
+    const Variable* v = Find(programs[program].uniforms, name, offset);
+    return v ? v->location + offset : -1;
+}
+
+GLint NullGL::GetAttribLocation(GLuint program, const GLchar* name) {
+    Record("glGetAttribLocation");
+    GLint offset;
+    const Variable* v = Find(programs[program].attributes, name, offset);
+    return v ? v->location + offset : -1;
+}
+
+void NullGL::MaxShaderCompilerThreads(GLuint count) { Record("glMaxShaderCompilerThreads"); }
+
+// uniforms and attributes
+
+void NullGL::Uniform1i(GLint location, GLint v0) { Record("glUniform1i"); ++stats.uniforms; }
+void NullGL::Uniform1f(GLint location, GLfloat v0) { Record("glUniform1f"); ++stats.uniforms; }
+void NullGL::Uniform2f(GLint location, GLfloat v0, GLfloat v1) { Record("glUniform2f"); ++stats.uniforms; }
+void NullGL::Uniform2fv(GLint location, GLsizei count, const GLfloat* value) { Record("glUniform2fv"); ++stats.uniforms; }
+void NullGL::Uniform3fv(GLint location, GLsizei count, const GLfloat* value) { Record("glUniform3fv"); ++stats.uniforms; }
+void NullGL::Uniform4fv(GLint location, GLsizei count, const GLfloat* value) { Record("glUniform4fv"); ++stats.uniforms; }
+void NullGL::UniformMatrix3fv(GLint location, GLsizei count, GLboolean transpose, const GLfloat* value) { Record("glUniformMatrix3fv"); ++stats.uniforms; }
+void NullGL::UniformMatrix4fv(GLint location, GLsizei count, GLboolean transpose, const GLfloat* value) { Record("glUniformMatrix4fv"); ++stats.uniforms; }
+void NullGL::EnableVertexAttribArray(GLuint index) { State("glEnableVertexAttribArray"); }
+void NullGL::DisableVertexAttribArray(GLuint index) { State("glDisableVertexAttribArray"); }
+
+void NullGL::VertexAttribPointer(GLuint index, GLint size, GLenum type, GLboolean normalized,
+                                 GLsizei stride, const GLvoid* pointer) {
+    State("glVertexAttribPointer");
+}
+
+void NullGL::VertexAttribDivisor(GLuint index, GLuint divisor) { State("glVertexAttribDivisor"); }
+
+// drawing
+
+void NullGL::DrawArrays(GLenum mode, GLint first, GLsizei count) {
+    Draw("glDrawArrays", count);
+}
+
+void NullGL::DrawElements(GLenum mode, GLsizei count, GLenum type, const GLvoid* indices) {
+    Draw("glDrawElements", count);
+}
+
+void NullGL::DrawElementsInstanced(GLenum mode, GLsizei count, GLenum type, const GLvoid* indices, GLsizei primcount) {
+    Draw("glDrawElementsInstanced", (unsigned long long)count * primcount);
+}
+
+// queries and syncs
+
+void NullGL::GenQueries(GLsizei n, GLuint* ids) {
+    Record("glGenQueries");
+    Generate(n, ids);
+}
+
+void NullGL::DeleteQueries(GLsizei n, const GLuint* ids) {
+    Record("glDeleteQueries");
+    Delete(n, ids);
+}
+
+void NullGL::QueryCounter(GLuint id, GLenum target) { Record("glQueryCounter"); }
+
+void NullGL::GetQueryObjectuiv(GLuint id, GLenum pname, GLuint* params) {
+    Record("glGetQueryObjectuiv");
+    *params = pname == GL_QUERY_RESULT_AVAILABLE ? GL_TRUE : 0;
+}
+
+void NullGL::GetQueryObjectui64v(GLuint id, GLenum pname, GLuint64* params) {
+    Record("glGetQueryObjectui64v");
+    *params = 0;
+}
+
+GLsync NullGL::FenceSync(GLenum condition, GLbitfield flags) {
+    Record("glFenceSync");
+    GLuint id;
+    Generate(1, &id);
+    return (GLsync)(size_t)id;
+}
+
+GLenum NullGL::ClientWaitSync(GLsync sync, GLbitfield flags, GLuint64 timeout) {
+    Record("glClientWaitSync");
+    return GL_ALREADY_SIGNALED;
+}
+
+void NullGL::DeleteSync(GLsync sync) {
+    Record("glDeleteSync");
+    if (sync) ++stats.objectsDeleted;
+}
+
+} // NS OpenGL
+} // NS Renderers2
+} // NS OpenEngine
@@ -0,0 +1,532 @@
+// Recording GL backend without a driver.
+// -------------------------------------------------------------------
+// Copyright (C) 2007 OpenEngine.dk (See AUTHORS)
+//
+// This program is free software; It is covered by the GNU General
+// Public License version 2 or any later version.
+// See the GNU General Public License for more details (see LICENSE).
+//--------------------------------------------------------------------
+
+#ifndef _OE_OPENGL_NULL_GL_H_
+#define _OE_OPENGL_NULL_GL_H_
+
+// Included by Meta/OpenGL.h after the GL headers when OE_NULL_GL is
+// defined, replacing every GL entry point used by the renderer.
+
+#include <string>
+#include <vector>
+#include <map>
+#include <set>
+#include <ostream>
+
+namespace OpenEngine {
+namespace Renderers2 {
+namespace OpenGL {
+
+/**
+ * Null GL backend
+ *
+ * Stands in for the driver when the renderer is built with
+ * OE_NULL_GL (the RENDERER2_NULL_GL CMake option). The GL calls do
+ * no rendering. Instead they are counted along with the bytes they
+ * upload, the draw calls, the vertices drawn and the state changes,
+ * and can be logged one call per line. The results are deterministic,
+ * so the renderer can be benchmarked and regression tested headless.
+ *
+ * Object names are handed out in sequence, shader and program
+ * queries report success, and syncs and queries are always done.
+ * Linked programs report the uniforms, uniform blocks and attributes
+ * declared in their sources, so shaders are bound as with a
+ * driver. Every extension is reported as supported unless disabled
+ * with SetExtension.
+ *
+ * @class NullGL NullGL.h Renderers2/OpenGL/NullGL.h
+ */
+class NullGL {
+public:
+    struct Statistics {
+        unsigned int calls;
+        unsigned int drawCalls;
+        unsigned long long vertices;      // vertices or indices drawn
+        unsigned long long bytesUploaded; // buffer and texture data
+        unsigned int stateChanges;        // enables, binds, blend state, ...
+        unsigned int uniforms;            // uniform updates
+        unsigned int objectsCreated, objectsDeleted;
+        std::map<std::string, unsigned int> functions; // calls per GL function
+    };
+
+private:
+    struct Variable {
+        std::string name;
+        GLenum type;
+        GLint size;
+        GLint location;
+    };
+    struct ShaderObject {
+        GLenum type;
+        std::string source;
+    };
+    struct ProgramObject {
+        std::vector<GLuint> shaders;
+        std::vector<Variable> uniforms, attributes;
+        std::vector<std::string> blocks;
+    };
+
+    static Statistics stats;
+    static std::ostream* log;
+    static std::set<std::string> disabled;
+    static GLuint nextName;
+    static std::map<GLuint, ShaderObject> shaders;
+    static std::map<GLuint, ProgramObject> programs;
+    static std::map<GLuint, GLsizeiptr> bufferSizes;
+    static std::map<GLenum, GLuint> boundBuffers;
+    static GLuint framebuffer;
+    static std::vector<char> mapped;
+
+    static void Record(const char* function);
+    static void State(const char* function);
+    static void Upload(const char* function, unsigned long long bytes);
+    static void Draw(const char* function, unsigned long long vertices);
+    static void Generate(GLsizei n, GLuint* names);
+    static void Delete(GLsizei n, const GLuint* names);
+    static unsigned int PixelSize(GLenum format, GLenum type);
+    static void Reflect(ProgramObject& program);
+    static const Variable* Find(const std::vector<Variable>& vars, const GLchar* name, GLint& offset);
+    static void Copy(const std::string& s, GLsizei bufSize, GLsizei* length, GLchar* dst);
+
+public:
+    static const Statistics& GetStatistics();
+    static void ResetStatistics();
+
+    /**
+     * Write the name of every GL call to a stream, or NULL to stop.
+     */
+    static void SetLog(std::ostream* log);
+
+    /**
+     * Report an extension or GL version, as named by GLEW, as
+     * (un)supported.
+     */
+    static void SetExtension(const std::string& name, bool supported);
+    static bool IsSupported(const std::string& name);
+
+    // GLEW
+    static GLenum Init();
+    static GLboolean GetExtension(const char* name);
+    static GLboolean IsSupportedGL(const char* name);
+    static const GLubyte* GetGLEWString(GLenum name);
+    static const GLubyte* GetErrorString(GLenum error);
+
+    // state
+    static void Enable(GLenum cap);
+    static void Disable(GLenum cap);
+    static void EnableClientState(GLenum array);
+    static void DisableClientState(GLenum array);
+    static void BlendFunc(GLenum sfactor, GLenum dfactor);
+    static void BlendEquation(GLenum mode);
+    static void BlendColor(GLclampf r, GLclampf g, GLclampf b, GLclampf a);
+    static void DepthMask(GLboolean flag);
+    static void ColorMask(GLboolean r, GLboolean g, GLboolean b, GLboolean a);
+    static void CullFace(GLenum mode);
+    static void PolygonMode(GLenum face, GLenum mode);
+    static void PolygonOffset(GLfloat factor, GLfloat units);
+    static void ShadeModel(GLenum mode);
+    static void Hint(GLenum target, GLenum mode);
+    static void Viewport(GLint x, GLint y, GLsizei width, GLsizei height);
+    static void ClearColor(GLclampf r, GLclampf g, GLclampf b, GLclampf a);
+    static void Clear(GLbitfield mask);
+    static void PixelStorei(GLenum pname, GLint param);
+    static GLenum GetError();
+    static void GetIntegerv(GLenum pname, GLint* params);
+    static const GLubyte* GetString(GLenum name);
+
+    // fixed function
+    static void MatrixMode(GLenum mode);
+    static void LoadIdentity();
+    static void MultMatrixf(const GLfloat* m);
+    static void PushMatrix();
+    static void PopMatrix();
+    static void Ortho(GLdouble left, GLdouble right, GLdouble bottom, GLdouble top, GLdouble zNear, GLdouble zFar);
+    static void Lightf(GLenum light, GLenum pname, GLfloat param);
+    static void Lightfv(GLenum light, GLenum pname, const GLfloat* params);
+    static void LightModelfv(GLenum pname, const GLfloat* params);
+    static void Materialf(GLenum face, GLenum pname, GLfloat param);
+    static void Materialfv(GLenum face, GLenum pname, const GLfloat* params);
+    static void TexEnvi(GLenum target, GLenum pname, GLint param);
+    static void ClientActiveTexture(GLenum texture);
+    static void VertexPointer(GLint size, GLenum type, GLsizei stride, const GLvoid* pointer);
+    static void NormalPointer(GLenum type, GLsizei stride, const GLvoid* pointer);
+    static void ColorPointer(GLint size, GLenum type, GLsizei stride, const GLvoid* pointer);
+    static void TexCoordPointer(GLint size, GLenum type, GLsizei stride, const GLvoid* pointer);
+    static void Begin(GLenum mode);
+    static void End();
+
+    // textures
+    static void GenTextures(GLsizei n, GLuint* textures);
+    static void DeleteTextures(GLsizei n, const GLuint* textures);
+    static void BindTexture(GLenum target, GLuint texture);
+    static void ActiveTexture(GLenum texture);
+    static void TexParameteri(GLenum target, GLenum pname, GLint param);
+    static void TexImage2D(GLenum target, GLint level, GLint internalFormat, GLsizei width, GLsizei height,
+                           GLint border, GLenum format, GLenum type, const GLvoid* pixels);
+    static void TexSubImage2D(GLenum target, GLint level, GLint xoffset, GLint yoffset, GLsizei width, GLsizei height,
+                              GLenum format, GLenum type, const GLvoid* pixels);
+    static void CopyTexImage2D(GLenum target, GLint level, GLenum internalFormat, GLint x, GLint y,
+                               GLsizei width, GLsizei height, GLint border);
+
+    // buffers
+    static void GenBuffers(GLsizei n, GLuint* buffers);
+    static void DeleteBuffers(GLsizei n, const GLuint* buffers);
+    static void BindBuffer(GLenum target, GLuint buffer);
+    static void BindBufferBase(GLenum target, GLuint index, GLuint buffer);
+    static void BufferData(GLenum target, GLsizeiptr size, const GLvoid* data, GLenum usage);
+    static void BufferSubData(GLenum target, GLintptr offset, GLsizeiptr size, const GLvoid* data);
+    static GLvoid* MapBuffer(GLenum target, GLenum access);
+    static GLvoid* MapBufferRange(GLenum target, GLintptr offset, GLsizeiptr length, GLbitfield access);
+    static GLboolean UnmapBuffer(GLenum target);
+    static void GenVertexArrays(GLsizei n, GLuint* arrays);
+    static void DeleteVertexArrays(GLsizei n, const GLuint* arrays);
+    static void BindVertexArray(GLuint array);
+
+    // framebuffers
+    static void GenFramebuffers(GLsizei n, GLuint* framebuffers);
+    static void DeleteFramebuffers(GLsizei n, const GLuint* framebuffers);
+    static void BindFramebuffer(GLenum target, GLuint framebuffer);
+    static void FramebufferTexture2D(GLenum target, GLenum attachment, GLenum textarget, GLuint texture, GLint level);
+    static GLenum CheckFramebufferStatus(GLenum target);
+
+    // shaders
+    static GLuint CreateShader(GLenum type);
+    static void DeleteShader(GLuint shader);
+    static void ShaderSource(GLuint shader, GLsizei count, const GLchar* const* sources, const GLint* lengths);
+    static void CompileShader(GLuint shader);
+    static void GetShaderiv(GLuint shader, GLenum pname, GLint* params);
+    static void GetShaderInfoLog(GLuint shader, GLsizei bufSize, GLsizei* length, GLchar* infoLog);
+    static GLuint CreateProgram();
+    static void DeleteProgram(GLuint program);
+    static void AttachShader(GLuint program, GLuint shader);
+    static void GetAttachedShaders(GLuint program, GLsizei maxCount, GLsizei* count, GLuint* shaders);
+    static void LinkProgram(GLuint program);
+    static void UseProgram(GLuint program);
+    static void ProgramParameteri(GLuint program, GLenum pname, GLint value);
+    static void ProgramBinary(GLuint program, GLenum binaryFormat, const GLvoid* binary, GLsizei length);
+    static void GetProgramBinary(GLuint program, GLsizei bufSize, GLsizei* length, GLenum* binaryFormat, GLvoid* binary);
+    static void GetProgramiv(GLuint program, GLenum pname, GLint* params);
+    static void GetProgramInfoLog(GLuint program, GLsizei bufSize, GLsizei* length, GLchar* infoLog);
+    static void GetActiveUniform(GLuint program, GLuint index, GLsizei bufSize, GLsizei* length,
+                                 GLint* size, GLenum* type, GLchar* name);
+    static void GetActiveAttrib(GLuint program, GLuint index, GLsizei bufSize, GLsizei* length,
+                                GLint* size, GLenum* type, GLchar* name);
+    static void GetActiveUniformBlockName(GLuint program, GLuint index, GLsizei bufSize, GLsizei* length, GLchar* name);
+    static void UniformBlockBinding(GLuint program, GLuint index, GLuint binding);
+    static GLint GetUniformLocation(GLuint program, const GLchar* name);
+    static GLint GetAttribLocation(GLuint program, const GLchar* name);
+    static void MaxShaderCompilerThreads(GLuint count);
+
+    // uniforms and attributes
+    static void Uniform1i(GLint location, GLint v0);
+    static void Uniform1f(GLint location, GLfloat v0);
+    static void Uniform2f(GLint location, GLfloat v0, GLfloat v1);
+    static void Uniform2fv(GLint location, GLsizei count, const GLfloat* value);
+    static void Uniform3fv(GLint location, GLsizei count, const GLfloat* value);
+    static void Uniform4fv(GLint location, GLsizei count, const GLfloat* value);
+    static void UniformMatrix3fv(GLint location, GLsizei count, GLboolean transpose, const GLfloat* value);
+    static void UniformMatrix4fv(GLint location, GLsizei count, GLboolean transpose, const GLfloat* value);
+    static void EnableVertexAttribArray(GLuint index);
+    static void DisableVertexAttribArray(GLuint index);
+    static void VertexAttribPointer(GLuint index, GLint size, GLenum type, GLboolean normalized,
+                                    GLsizei stride, const GLvoid* pointer);
+    static void VertexAttribDivisor(GLuint index, GLuint divisor);
+
+    // drawing
+    static void DrawArrays(GLenum mode, GLint first, GLsizei count);
+    static void DrawElements(GLenum mode, GLsizei count, GLenum type, const GLvoid* indices);
+    static void DrawElementsInstanced(GLenum mode, GLsizei count, GLenum type, const GLvoid* indices, GLsizei primcount);
+
+    // queries and syncs
+    static void GenQueries(GLsizei n, GLuint* ids);
+    static void DeleteQueries(GLsizei n, const GLuint* ids);
+    static void QueryCounter(GLuint id, GLenum target);
+    static void GetQueryObjectuiv(GLuint id, GLenum pname, GLuint* params);
+    static void GetQueryObjectui64v(GLuint id, GLenum pname, GLuint64* params);
+    static GLsync FenceSync(GLenum condition, GLbitfield flags);
+    static GLenum ClientWaitSync(GLsync sync, GLbitfield flags, GLuint64 timeout);
+    static void DeleteSync(GLsync sync);
+};
+
+} // NS OpenGL
+} // NS Renderers2
+} // NS OpenEngine
+
+// Replace the GL, GLEW and GLU entry points.
+#define OE_NULL_GL_FUNCTION(f) ::OpenEngine::Renderers2::OpenGL::NullGL::f
+
+#undef glewInit
+#undef glewGetExtension
+#undef glewIsSupported
+#undef glewGetString
+#undef glewGetErrorString
+#define glewInit OE_NULL_GL_FUNCTION(Init)
+#define glewGetExtension OE_NULL_GL_FUNCTION(GetExtension)
+#define glewIsSupported OE_NULL_GL_FUNCTION(IsSupportedGL)
+#define glewGetString OE_NULL_GL_FUNCTION(GetGLEWString)
+#define glewGetErrorString OE_NULL_GL_FUNCTION(GetErrorString)
+#define gluErrorString OE_NULL_GL_FUNCTION(GetErrorString)
+
+#undef GLEW_ARB_vertex_shader
+#undef GLEW_ARB_fragment_shader
+#undef GLEW_ARB_draw_instanced
+#undef GLEW_ARB_instanced_arrays
+#undef GLEW_ARB_vertex_array_object
+#undef GLEW_ARB_sync
+#undef GLEW_ARB_pixel_buffer_object
+#undef GLEW_ARB_get_program_binary
+#undef GLEW_ARB_uniform_buffer_object
+#undef GLEW_ARB_timer_query
+#undef GLEW_ARB_map_buffer_range
+#define GLEW_ARB_vertex_shader OE_NULL_GL_FUNCTION(IsSupported)("GL_ARB_vertex_shader")
+#define GLEW_ARB_fragment_shader OE_NULL_GL_FUNCTION(IsSupported)("GL_ARB_fragment_shader")
+#define GLEW_ARB_draw_instanced OE_NULL_GL_FUNCTION(IsSupported)("GL_ARB_draw_instanced")
+#define GLEW_ARB_instanced_arrays OE_NULL_GL_FUNCTION(IsSupported)("GL_ARB_instanced_arrays")
+#define GLEW_ARB_vertex_array_object OE_NULL_GL_FUNCTION(IsSupported)("GL_ARB_vertex_array_object")
+#define GLEW_ARB_sync OE_NULL_GL_FUNCTION(IsSupported)("GL_ARB_sync")
+#define GLEW_ARB_pixel_buffer_object OE_NULL_GL_FUNCTION(IsSupported)("GL_ARB_pixel_buffer_object")
+#define GLEW_ARB_get_program_binary OE_NULL_GL_FUNCTION(IsSupported)("GL_ARB_get_program_binary")
+#define GLEW_ARB_uniform_buffer_object OE_NULL_GL_FUNCTION(IsSupported)("GL_ARB_uniform_buffer_object")
+#define GLEW_ARB_timer_query OE_NULL_GL_FUNCTION(IsSupported)("GL_ARB_timer_query")
+#define GLEW_ARB_map_buffer_range OE_NULL_GL_FUNCTION(IsSupported)("GL_ARB_map_buffer_range")
+
+#undef glEnable
+#undef glDisable
+#undef glEnableClientState
+#undef glDisableClientState
+#undef glBlendFunc
+#undef glBlendEquation
+#undef glBlendColor
+#undef glDepthMask
+#undef glColorMask
+#undef glCullFace
+#undef glPolygonMode
+#undef glPolygonOffset
+#undef glShadeModel
+#undef glHint
+#undef glViewport
+#undef glClearColor
+#undef glClear
+#undef glPixelStorei
+#undef glGetError
+#undef glGetIntegerv
+#undef glGetString
+#define glEnable OE_NULL_GL_FUNCTION(Enable)
+#define glDisable OE_NULL_GL_FUNCTION(Disable)
+#define glEnableClientState OE_NULL_GL_FUNCTION(EnableClientState)
+#define glDisableClientState OE_NULL_GL_FUNCTION(DisableClientState)
+#define glBlendFunc OE_NULL_GL_FUNCTION(BlendFunc)
+#define glBlendEquation OE_NULL_GL_FUNCTION(BlendEquation)
+#define glBlendColor OE_NULL_GL_FUNCTION(BlendColor)
+#define glDepthMask OE_NULL_GL_FUNCTION(DepthMask)
+#define glColorMask OE_NULL_GL_FUNCTION(ColorMask)
+#define glCullFace OE_NULL_GL_FUNCTION(CullFace)
+#define glPolygonMode OE_NULL_GL_FUNCTION(PolygonMode)
+#define glPolygonOffset OE_NULL_GL_FUNCTION(PolygonOffset)
+#define glShadeModel OE_NULL_GL_FUNCTION(ShadeModel)
+#define glHint OE_NULL_GL_FUNCTION(Hint)
+#define glViewport OE_NULL_GL_FUNCTION(Viewport)
+#define glClearColor OE_NULL_GL_FUNCTION(ClearColor)
+#define glClear OE_NULL_GL_FUNCTION(Clear)
+#define glPixelStorei OE_NULL_GL_FUNCTION(PixelStorei)
+#define glGetError OE_NULL_GL_FUNCTION(GetError)
+#define glGetIntegerv OE_NULL_GL_FUNCTION(GetIntegerv)
+#define glGetString OE_NULL_GL_FUNCTION(GetString)
+
+#undef glMatrixMode
+#undef glLoadIdentity
+#undef glMultMatrixf
+#undef glPushMatrix
+#undef glPopMatrix
+#undef glOrtho
+#undef glLightf
+#undef glLightfv
+#undef glLightModelfv
+#undef glMaterialf
+#undef glMaterialfv
+#undef glTexEnvi
+#undef glClientActiveTexture
+#undef glVertexPointer
+#undef glNormalPointer
+#undef glColorPointer
+#undef glTexCoordPointer
+#undef glBegin
+#undef glEnd
+#define glMatrixMode OE_NULL_GL_FUNCTION(MatrixMode)
+#define glLoadIdentity OE_NULL_GL_FUNCTION(LoadIdentity)
+#define glMultMatrixf OE_NULL_GL_FUNCTION(MultMatrixf)
+#define glPushMatrix OE_NULL_GL_FUNCTION(PushMatrix)
+#define glPopMatrix OE_NULL_GL_FUNCTION(PopMatrix)
+#define glOrtho OE_NULL_GL_FUNCTION(Ortho)
+#define glLightf OE_NULL_GL_FUNCTION(Lightf)
+#define glLightfv OE_NULL_GL_FUNCTION(Lightfv)
+#define glLightModelfv OE_NULL_GL_FUNCTION(LightModelfv)
+#define glMaterialf OE_NULL_GL_FUNCTION(Materialf)
+#define glMaterialfv OE_NULL_GL_FUNCTION(Materialfv)
+#define glTexEnvi OE_NULL_GL_FUNCTION(TexEnvi)
+#define glClientActiveTexture OE_NULL_GL_FUNCTION(ClientActiveTexture)
+#define glVertexPointer OE_NULL_GL_FUNCTION(VertexPointer)
+#define glNormalPointer OE_NULL_GL_FUNCTION(NormalPointer)
+#define glColorPointer OE_NULL_GL_FUNCTION(ColorPointer)
+#define glTexCoordPointer OE_NULL_GL_FUNCTION(TexCoordPointer)
+#define glBegin OE_NULL_GL_FUNCTION(Begin)
+#define glEnd OE_NULL_GL_FUNCTION(End)
+
+#undef glGenTextures
+#undef glDeleteTextures
+#undef glBindTexture
+#undef glActiveTexture
+#undef glTexParameteri
+#undef glTexImage2D
+#undef glTexSubImage2D
+#undef glCopyTexImage2D
+#define glGenTextures OE_NULL_GL_FUNCTION(GenTextures)
+#define glDeleteTextures OE_NULL_GL_FUNCTION(DeleteTextures)
+#define glBindTexture OE_NULL_GL_FUNCTION(BindTexture)
+#define glActiveTexture OE_NULL_GL_FUNCTION(ActiveTexture)
+#define glTexParameteri OE_NULL_GL_FUNCTION(TexParameteri)
+#define glTexImage2D OE_NULL_GL_FUNCTION(TexImage2D)
+#define glTexSubImage2D OE_NULL_GL_FUNCTION(TexSubImage2D)
+#define glCopyTexImage2D OE_NULL_GL_FUNCTION(CopyTexImage2D)
+
+#undef glGenBuffers
+#undef glDeleteBuffers
+#undef glBindBuffer
+#undef glBindBufferBase
+#undef glBufferData
+#undef glBufferSubData
+#undef glMapBuffer
+#undef glMapBufferRange
+#undef glUnmapBuffer
+#undef glGenVertexArrays
+#undef glDeleteVertexArrays
+#undef glBindVertexArray
+#define glGenBuffers OE_NULL_GL_FUNCTION(GenBuffers)
+#define glDeleteBuffers OE_NULL_GL_FUNCTION(DeleteBuffers)
+#define glBindBuffer OE_NULL_GL_FUNCTION(BindBuffer)
+#define glBindBufferBase OE_NULL_GL_FUNCTION(BindBufferBase)
+#define glBufferData OE_NULL_GL_FUNCTION(BufferData)
+#define glBufferSubData OE_NULL_GL_FUNCTION(BufferSubData)
+#define glMapBuffer OE_NULL_GL_FUNCTION(MapBuffer)
+#define glMapBufferRange OE_NULL_GL_FUNCTION(MapBufferRange)
+#define glUnmapBuffer OE_NULL_GL_FUNCTION(UnmapBuffer)
+#define glGenVertexArrays OE_NULL_GL_FUNCTION(GenVertexArrays)
+#define glDeleteVertexArrays OE_NULL_GL_FUNCTION(DeleteVertexArrays)
+#define glBindVertexArray OE_NULL_GL_FUNCTION(BindVertexArray)
+
+#undef glGenFramebuffers
+#undef glDeleteFramebuffers
+#undef glBindFramebuffer
+#undef glFramebufferTexture2D
+#undef glCheckFramebufferStatusEXT
+#define glGenFramebuffers OE_NULL_GL_FUNCTION(GenFramebuffers)
+#define glDeleteFramebuffers OE_NULL_GL_FUNCTION(DeleteFramebuffers)
+#define glBindFramebuffer OE_NULL_GL_FUNCTION(BindFramebuffer)
+#define glFramebufferTexture2D OE_NULL_GL_FUNCTION(FramebufferTexture2D)
+#define glCheckFramebufferStatusEXT OE_NULL_GL_FUNCTION(CheckFramebufferStatus)
+
+#undef glCreateShader
+#undef glDeleteShader
+#undef glShaderSource
+#undef glCompileShader
+#undef glGetShaderiv
+#undef glGetShaderInfoLog
+#undef glCreateProgram
+#undef glDeleteProgram
+#undef glAttachShader
+#undef glGetAttachedShaders
+#undef glLinkProgram
+#undef glUseProgram
+#undef glProgramParameteri
+#undef glProgramBinary
+#undef glGetProgramBinary
+#undef glGetProgramiv
+#undef glGetProgramInfoLog
+#undef glGetActiveUniform
+#undef glGetActiveAttrib
+#undef glGetActiveUniformBlockName
+#undef glUniformBlockBinding
+#undef glGetUniformLocation
+#undef glGetAttribLocation
+#undef glMaxShaderCompilerThreadsKHR
+#define glCreateShader OE_NULL_GL_FUNCTION(CreateShader)
+#define glDeleteShader OE_NULL_GL_FUNCTION(DeleteShader)
+#define glShaderSource OE_NULL_GL_FUNCTION(ShaderSource)
+#define glCompileShader OE_NULL_GL_FUNCTION(CompileShader)
+#define glGetShaderiv OE_NULL_GL_FUNCTION(GetShaderiv)
+#define glGetShaderInfoLog OE_NULL_GL_FUNCTION(GetShaderInfoLog)
+#define glCreateProgram OE_NULL_GL_FUNCTION(CreateProgram)
+#define glDeleteProgram OE_NULL_GL_FUNCTION(DeleteProgram)
+#define glAttachShader OE_NULL_GL_FUNCTION(AttachShader)
+#define glGetAttachedShaders OE_NULL_GL_FUNCTION(GetAttachedShaders)
+#define glLinkProgram OE_NULL_GL_FUNCTION(LinkProgram)
+#define glUseProgram OE_NULL_GL_FUNCTION(UseProgram)
+#define glProgramParameteri OE_NULL_GL_FUNCTION(ProgramParameteri)
+#define glProgramBinary OE_NULL_GL_FUNCTION(ProgramBinary)
+#define glGetProgramBinary OE_NULL_GL_FUNCTION(GetProgramBinary)
+#define glGetProgramiv OE_NULL_GL_FUNCTION(GetProgramiv)
+#define glGetProgramInfoLog OE_NULL_GL_FUNCTION(GetProgramInfoLog)
+#define glGetActiveUniform OE_NULL_GL_FUNCTION(GetActiveUniform)
+#define glGetActiveAttrib OE_NULL_GL_FUNCTION(GetActiveAttrib)
+#define glGetActiveUniformBlockName OE_NULL_GL_FUNCTION(GetActiveUniformBlockName)
+#define glUniformBlockBinding OE_NULL_GL_FUNCTION(UniformBlockBinding)
+#define glGetUniformLocation OE_NULL_GL_FUNCTION(GetUniformLocation)
+#define glGetAttribLocation OE_NULL_GL_FUNCTION(GetAttribLocation)
+#define glMaxShaderCompilerThreadsKHR OE_NULL_GL_FUNCTION(MaxShaderCompilerThreads)
+
+#undef glUniform1i
+#undef glUniform1f
+#undef glUniform2f
+#undef glUniform2fv
+#undef glUniform3fv
+#undef glUniform4fv
+#undef glUniformMatrix3fv
+#undef glUniformMatrix4fv
+#undef glEnableVertexAttribArray
+#undef glDisableVertexAttribArray
+#undef glVertexAttribPointer
+#undef glVertexAttribDivisorARB
+#define glUniform1i OE_NULL_GL_FUNCTION(Uniform1i)
+#define glUniform1f OE_NULL_GL_FUNCTION(Uniform1f)
+#define glUniform2f OE_NULL_GL_FUNCTION(Uniform2f)
+#define glUniform2fv OE_NULL_GL_FUNCTION(Uniform2fv)
+#define glUniform3fv OE_NULL_GL_FUNCTION(Uniform3fv)
+#define glUniform4fv OE_NULL_GL_FUNCTION(Uniform4fv)
+#define glUniformMatrix3fv OE_NULL_GL_FUNCTION(UniformMatrix3fv)
+#define glUniformMatrix4fv OE_NULL_GL_FUNCTION(UniformMatrix4fv)
+#define glEnableVertexAttribArray OE_NULL_GL_FUNCTION(EnableVertexAttribArray)
+#define glDisableVertexAttribArray OE_NULL_GL_FUNCTION(DisableVertexAttribArray)
+#define glVertexAttribPointer OE_NULL_GL_FUNCTION(VertexAttribPointer)
+#define glVertexAttribDivisorARB OE_NULL_GL_FUNCTION(VertexAttribDivisor)
+
+#undef glDrawArrays
+#undef glDrawElements
+#undef glDrawElementsInstancedARB
+#define glDrawArrays OE_NULL_GL_FUNCTION(DrawArrays)
+#define glDrawElements OE_NULL_GL_FUNCTION(DrawElements)
+#define glDrawElementsInstancedARB OE_NULL_GL_FUNCTION(DrawElementsInstanced)
+
+#undef glGenQueries
+#undef glDeleteQueries
+#undef glQueryCounter
+#undef glGetQueryObjectuiv
+#undef glGetQueryObjectui64v
+#undef glFenceSync
+#undef glClientWaitSync
+#undef glDeleteSync
+#define glGenQueries OE_NULL_GL_FUNCTION(GenQueries)
+#define glDeleteQueries OE_NULL_GL_FUNCTION(DeleteQueries)
+#define glQueryCounter OE_NULL_GL_FUNCTION(QueryCounter)
+#define glGetQueryObjectuiv OE_NULL_GL_FUNCTION(GetQueryObjectuiv)
+#define glGetQueryObjectui64v OE_NULL_GL_FUNCTION(GetQueryObjectui64v)
+#define glFenceSync OE_NULL_GL_FUNCTION(FenceSync)
+#define glClientWaitSync OE_NULL_GL_FUNCTION(ClientWaitSync)
+#define glDeleteSync OE_NULL_GL_FUNCTION(DeleteSync)
+
+#endif // _OE_OPENGL_NULL_GL_H_
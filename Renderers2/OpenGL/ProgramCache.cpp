@@ -0,0 +1,122 @@
+// On-disk cache of linked GL program binaries.
+// -------------------------------------------------------------------
+// Copyright (C) 2007 OpenEngine.dk (See AUTHORS)
+//
+// This program is free software; It is covered by the GNU General
+// Public License version 2 or any later version.
+// See the GNU General Public License for more details (see LICENSE).
+//--------------------------------------------------------------------
+
+#include <Renderers2/OpenGL/ProgramCache.h>
+#include <Logging/Logger.h>
+#include <fstream>
+#include <vector>
+#include <cstdio>
+
+namespace OpenEngine {
+namespace Renderers2 {
+namespace OpenGL {
+
+using std::ifstream;
+using std::ofstream;
+using std::ios;
+using std::vector;
+
+// file header, followed by the binary format and the binary.
+static const char MAGIC[4] = { 'O', 'E', 'P', 'B' };
+
+ProgramCache::ProgramCache(string directory)
+    : directory(directory)
+    , driverHash(14695981039346656037ULL)
+{
+#ifndef OE_IOS
+    const GLenum names[3] = { GL_VENDOR, GL_RENDERER, GL_VERSION };
+    for (unsigned int i = 0; i < 3; ++i) {
+        const char* s = (const char*)glGetString(names[i]);
+        driverHash = Hash(s ? s : "", driverHash);
+    }
+#endif
+}
+
+ProgramCache::~ProgramCache() {}
+
+bool ProgramCache::IsSupported() {
+#ifdef OE_IOS
+    return false;
+#else
+    return GLEW_ARB_get_program_binary;
+#endif
+}
+
+uint64_t ProgramCache::Hash(const string& s, uint64_t hash) {
+    for (unsigned int i = 0; i < s.size(); ++i) {
+        hash ^= (unsigned char)s[i];
+        hash *= 1099511628211ULL;
+    }
+    // separator, so "ab" + "c" and "a" + "bc" differ
+    hash ^= 0xFF;
+    hash *= 1099511628211ULL;
+    return hash;
+}
+
+string ProgramCache::Filename(const string& vertexShader, const string& fragmentShader) {
+    uint64_t hash = Hash(fragmentShader, Hash(vertexShader, driverHash));
+    char name[32];
+    sprintf(name, "%08x%08x.bin", (unsigned int)(hash >> 32), (unsigned int)hash);
+    return directory + "/" + name;
+}
+
+GLuint ProgramCache::Load(const string& vertexShader, const string& fragmentShader) {
+#ifdef OE_IOS
+    return 0;
+#else
+    ifstream file(Filename(vertexShader, fragmentShader).c_str(), ios::in | ios::binary);
+    if (!file.is_open()) return 0;
+
+    char magic[4];
+    GLenum format;
+    file.read(magic, 4);
+    file.read((char*)&format, sizeof(format));
+    if (!file.good() || string(magic, 4) != string(MAGIC, 4)) return 0;
+    vector<char> binary((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    if (binary.empty()) return 0;
+
+    GLuint id = glCreateProgram();
+    glProgramBinary(id, format, &binary[0], binary.size());
+    GLint linked;
+    glGetProgramiv(id, GL_LINK_STATUS, &linked);
+    if (linked == GL_FALSE) {
+        glDeleteProgram(id);
+        // clear the error of a rejected binary
+        while (glGetError() != GL_NO_ERROR);
+        return 0;
+    }
+    return id;
+#endif
+}
+
+void ProgramCache::Store(GLuint program, const string& vertexShader, const string& fragmentShader) {
+#ifndef OE_IOS
+    GLint length = 0;
+    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+    if (length <= 0) return;
+    vector<char> binary(length);
+    GLenum format;
+    glGetProgramBinary(program, length, NULL, &format, &binary[0]);
+    CHECK_FOR_GL_ERROR();
+
+    string filename = Filename(vertexShader, fragmentShader);
+    ofstream file(filename.c_str(), ios::out | ios::binary | ios::trunc);
+    if (!file.is_open()) {
+        logger.warning << "Could not write program cache file " << filename << logger.end;
+        return;
+    }
+    file.write(MAGIC, 4);
+    file.write((const char*)&format, sizeof(format));
+    file.write(&binary[0], length);
+#endif
+}
+
+} // NS OpenGL
+} // NS Renderers2
+} // NS OpenEngine
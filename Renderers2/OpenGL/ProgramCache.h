@@ -0,0 +1,69 @@
+// On-disk cache of linked GL program binaries.
+// -------------------------------------------------------------------
+// Copyright (C) 2007 OpenEngine.dk (See AUTHORS)
+//
+// This program is free software; It is covered by the GNU General
+// Public License version 2 or any later version.
+// See the GNU General Public License for more details (see LICENSE).
+//--------------------------------------------------------------------
+
+#ifndef _OE_OPENGL_PROGRAM_CACHE_H_
+#define _OE_OPENGL_PROGRAM_CACHE_H_
+
+#include <Meta/OpenGL.h>
+#include <string>
+#include <stdint.h>
+
+namespace OpenEngine {
+namespace Renderers2 {
+namespace OpenGL {
+
+using std::string;
+
+/**
+ * Program binary cache
+ *
+ * Stores linked programs with glGetProgramBinary in a directory, one
+ * file per program named by a 64 bit FNV-1a hash of the final vertex
+ * and fragment source and the GL vendor, renderer and version
+ * strings. Edited (reloaded) sources and driver updates therefore
+ * miss the cache instead of loading stale binaries, and binaries the
+ * driver rejects are simply recompiled.
+ *
+ * Requires ARB_get_program_binary. Create it with a current GL
+ * context, as the driver strings are read on construction.
+ *
+ * @class ProgramCache ProgramCache.h Renderers2/OpenGL/ProgramCache.h
+ */
+class ProgramCache {
+private:
+    string directory;
+    uint64_t driverHash;
+
+    static uint64_t Hash(const string& s, uint64_t hash);
+    string Filename(const string& vertexShader, const string& fragmentShader);
+
+public:
+    ProgramCache(string directory);
+    virtual ~ProgramCache();
+
+    static bool IsSupported();
+
+    /**
+     * Create a program from the cached binary for the sources.
+     * Returns 0 if there is none or the driver rejects it.
+     */
+    GLuint Load(const string& vertexShader, const string& fragmentShader);
+
+    /**
+     * Write the binary of a linked program. The program should be
+     * linked with GL_PROGRAM_BINARY_RETRIEVABLE_HINT set.
+     */
+    void Store(GLuint program, const string& vertexShader, const string& fragmentShader);
+};
+
+} // NS OpenGL
+} // NS Renderers2
+} // NS OpenEngine
+
+#endif // _OE_OPENGL_PROGRAM_CACHE_H_
@@ -20,6 +20,16 @@
 #include <Geometry/Mesh.h>
 #include <Geometry/Material.h>
 #include <Logging/Logger.h>
+#include <Utils/RadixSort.h>
+#include <Utils/Profiler.h>
+#include <Renderers2/BoundsCache.h>
+#include <Renderers2/Frustum.h>
+#include <Renderers2/BoundingVolumeHierarchy.h>
+#include <Renderers2/OcclusionCuller.h>
+#include <Resources/DataBlock.h>
+
+#include <cstring>
+#include <algorithm>
 
 
 namespace OpenEngine {
@@ -32,6 +42,8 @@ using namespace Scene;
 
 using Resources2::Uniform;
 using Resources2::PhongShader;
+using Resources::DataBlock;
+namespace Types = Resources::Types;
 
 /**
  * Rendering view constructor.
@@ -41,9 +53,13 @@ using Resources2::PhongShader;
 RenderingView::RenderingView()
     : ctx(NULL)
     , renderer(NULL)
+    , bvh(NULL)
+    , occlusion(NULL)
     , currentRenderState(new RenderStateNode())
     , renderTexture(true)
     , renderShader(true)
+    , frameBlock(false)
+    , releaseFrame(0)
 {
     currentRenderState = new RenderStateNode();
     currentRenderState->EnableOption(RenderStateNode::TEXTURE);
@@ -54,119 +70,241 @@ RenderingView::RenderingView()
     currentRenderState->DisableOption(RenderStateNode::WIREFRAME);
 }
 
-RenderingView::~RenderingView() {}
+RenderingView::~RenderingView() {
+    map<MeshKey, PhongShader*>::iterator sit = shaders.begin();
+    for (; sit != shaders.end(); ++sit)
+        delete sit->second;
+    map<MeshKey, InstanceData>::iterator iit = instanceData.begin();
+    for (; iit != instanceData.end(); ++iit)
+        delete iit->second.shader;
+    map<MeshKey, TriangleOrder*>::iterator it = triangleOrders.begin();
+    for (; it != triangleOrders.end(); ++it)
+        delete it->second;
+}
+
+/**
+ * Delete the shaders and triangle orders of destroyed meshes, and
+ * with them their references to the vertex data and textures.
+ */
+void RenderingView::ReleaseDead() {
+    map<MeshKey, PhongShader*>::iterator sit = shaders.begin();
+    while (sit != shaders.end()) {
+        map<MeshKey, PhongShader*>::iterator cur = sit++;
+        if (!cur->first.expired()) continue;
+        delete cur->second;
+        shaders.erase(cur);
+    }
+    map<MeshKey, InstanceData>::iterator iit = instanceData.begin();
+    while (iit != instanceData.end()) {
+        map<MeshKey, InstanceData>::iterator cur = iit++;
+        if (!cur->first.expired()) continue;
+        delete cur->second.shader;
+        instanceData.erase(cur);
+    }
+    map<MeshKey, TriangleOrder*>::iterator tit = triangleOrders.begin();
+    while (tit != triangleOrders.end()) {
+        map<MeshKey, TriangleOrder*>::iterator cur = tit++;
+        if (!cur->first.expired()) continue;
+        delete cur->second;
+        triangleOrders.erase(cur);
+    }
+}
 
 void RenderingView::Handle(RenderingEventArg arg) {
+    OE_PROFILE_SCOPE("RenderingView::Handle");
 #if OE_SAFE
     if (arg.canvas->GetScene() == NULL) 
         throw Exception("Scene was NULL while rendering.");
 #endif
 
-    map<Mesh*, PhongShader*>::iterator itr = shaders.begin();
-    for (; itr != shaders.end(); ++itr) {
-        itr->second->SetLight(light, Vector<4,float>(0.3, 0.3, 0.3, 1.0));
-    }
-
     modelViewMatrix = arg.canvas->GetViewingVolume()->GetViewMatrix();
     projectionMatrix = arg.canvas->GetViewingVolume()->GetProjectionMatrix();
     ctx = arg.renderer.GetContext();
+    FrameTimer* timer = arg.renderer.GetFrameTimer();
+
+    if (timer) timer->Begin("frame data");
+    // with uniform buffers the lights and projection are written
+    // once, instead of to every shader.
+    frameBlock = ctx->UniformBufferSupport();
+    if (frameBlock) {
+        PhongShader::FrameData data;
+        PhongShader::SetFrameData(data, projectionMatrix, light, Vector<4,float>(0.3, 0.3, 0.3, 1.0));
+        ctx->UpdateUniformBlock("FrameData", &data, sizeof(data));
+    }
+    else {
+        map<MeshKey, PhongShader*>::iterator itr = shaders.begin();
+        for (; itr != shaders.end(); ++itr) {
+            itr->second->SetLight(light, Vector<4,float>(0.3, 0.3, 0.3, 1.0));
+        }
+        map<MeshKey, InstanceData>::iterator iitr = instanceData.begin();
+        for (; iitr != instanceData.end(); ++iitr) {
+            iitr->second.shader->SetLight(light, Vector<4,float>(0.3, 0.3, 0.3, 1.0));
+        }
+    }
+    if (timer) timer->End();
     renderer = &arg.renderer;
+    if (releaseFrame != renderer->GetFrame()) {
+        releaseFrame = renderer->GetFrame();
+        ReleaseDead();
+    }
+    bvh = renderer->LookupBoundingVolumeHierarchy(arg.canvas->GetScene());
+    occlusion = renderer->GetOcclusionCuller();
+    if (occlusion) occlusion->Rasterize(modelViewMatrix * projectionMatrix);
 
-    // setup default render state
-    ApplyRenderState(currentRenderState);
+    // collect the draw items
+    if (timer) timer->Begin("traversal");
     arg.canvas->GetScene()->Accept(*this);
-    
-    // process transparent meshes
-    glDepthMask(GL_FALSE);
-    vector<RenderObject>::iterator it = transparencyQueue.begin();    
-    for (; it != transparencyQueue.end(); ++it) {
-        RenderMesh(it->mesh, it->modelViewMatrix);
-    }         
-    transparencyQueue.clear();
-    glDepthMask(GL_TRUE);
+    if (ctx->InstancingSupport()) BatchInstances();
+    if (timer) timer->End();
+
+    // sort them by render state, shader, textures and depth
+    if (timer) timer->Begin("sort");
+    sortQueue.resize(renderQueue.size());
+    for (unsigned int i = 0; i < renderQueue.size(); ++i) {
+        RenderObject& ro = renderQueue[i];
+        sortQueue[i].key = SortKey(ro);
+        sortQueue[i].index = i;
+    }
+    Utils::RadixSort(sortQueue, sortBuffer);
+    if (timer) timer->End();
+
+    // submit the queue, transparent meshes are sorted last
+    if (timer) timer->Begin("submit");
+    RenderState defaultState = GetRenderState(currentRenderState);
+    RenderState state = defaultState;
+    ApplyRenderState(state);
+    bool transparent = false;
+    vector<QueueEntry>::iterator it = sortQueue.begin();
+    for (; it != sortQueue.end(); ++it) {
+        RenderObject& ro = renderQueue[it->index];
+        if (!transparent && (it->key & TRANSPARENT_KEY)) {
+            ctx->DepthMask(GL_FALSE);
+            transparent = true;
+        }
+        if (ro.state.enabled != state.enabled || ro.state.disabled != state.disabled) {
+            state = ro.state;
+            ApplyRenderState(state);
+        }
+        if (ro.batch >= 0) {
+            RenderInstances(batches[ro.batch]);
+            continue;
+        }
+        IDataBlock* sortedIndices = NULL;
+        if (transparent && !triangleOrders.empty()) {
+            map<MeshKey, TriangleOrder*>::iterator order = triangleOrders.find(MeshKey(ro.mesh));
+            if (order != triangleOrders.end())
+                sortedIndices = SortTriangles(order->second, ro.modelViewMatrix);
+        }
+        RenderMesh(ro.mesh, ro.modelViewMatrix, sortedIndices);
+    }
+    renderQueue.clear();
+    batches.clear();
+    ctx->DepthMask(GL_TRUE);
+    ApplyRenderState(defaultState);
+    if (timer) timer->End();
 
     ctx = NULL;
     renderer = NULL;
+    bvh = NULL;
+    occlusion = NULL;
 }
             
-void RenderingView::ApplyRenderState(RenderStateNode* node) {
-    if (node->IsOptionEnabled(RenderStateNode::WIREFRAME)) {
+RenderingView::RenderState RenderingView::GetRenderState(RenderStateNode* node) {
+    const RenderStateNode::RenderStateOption options[] = {
+        RenderStateNode::TEXTURE, RenderStateNode::SHADER, 
+        RenderStateNode::BACKFACE, RenderStateNode::LIGHTING, 
+        RenderStateNode::DEPTH_TEST, RenderStateNode::WIREFRAME,
+        RenderStateNode::COLOR_MATERIAL
+    };
+    RenderState state;
+    state.enabled = state.disabled = 0;
+    for (unsigned int i = 0; i < sizeof(options) / sizeof(options[0]); ++i) {
+        if (node->IsOptionEnabled(options[i]))
+            state.enabled |= options[i];
+        else if (node->IsOptionDisabled(options[i]))
+            state.disabled |= options[i];
+    }
+    return state;
+}
+
+void RenderingView::ApplyRenderState(RenderState state) {
+    if (state.enabled & RenderStateNode::WIREFRAME) {
 #ifndef OE_IOS
         glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
 #endif
         CHECK_FOR_GL_ERROR();
     }
-    else if (node->IsOptionDisabled(RenderStateNode::WIREFRAME)) {
+    else if (state.disabled & RenderStateNode::WIREFRAME) {
 #ifndef OE_IOS
         glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
 #endif
         CHECK_FOR_GL_ERROR();
     }
 
-    if (node->IsOptionEnabled(RenderStateNode::BACKFACE)) {
-        glDisable(GL_CULL_FACE);
+    if (state.enabled & RenderStateNode::BACKFACE) {
+        ctx->Disable(GL_CULL_FACE);
         CHECK_FOR_GL_ERROR();
     }
-    else if (node->IsOptionDisabled(RenderStateNode::BACKFACE)) {
-        glEnable(GL_CULL_FACE);
+    else if (state.disabled & RenderStateNode::BACKFACE) {
+        ctx->Enable(GL_CULL_FACE);
         CHECK_FOR_GL_ERROR();
     }
-    if (node->IsOptionEnabled(RenderStateNode::DEPTH_TEST)) {
-        glEnable(GL_DEPTH_TEST);
+    if (state.enabled & RenderStateNode::DEPTH_TEST) {
+        ctx->Enable(GL_DEPTH_TEST);
         CHECK_FOR_GL_ERROR();
     }
-    else if (node->IsOptionDisabled(RenderStateNode::DEPTH_TEST)) {
-        glDisable(GL_DEPTH_TEST);
+    else if (state.disabled & RenderStateNode::DEPTH_TEST) {
+        ctx->Disable(GL_DEPTH_TEST);
         CHECK_FOR_GL_ERROR();
     }
 
 #if FIXED_FUNCTION
-    if (node->IsOptionEnabled(RenderStateNode::LIGHTING)) {
-        glEnable(GL_LIGHTING);
+    if (state.enabled & RenderStateNode::LIGHTING) {
+        ctx->Enable(GL_LIGHTING);
         CHECK_FOR_GL_ERROR();
     }
-    else if (node->IsOptionDisabled(RenderStateNode::LIGHTING)) {
-        glDisable(GL_LIGHTING);
+    else if (state.disabled & RenderStateNode::LIGHTING) {
+        ctx->Disable(GL_LIGHTING);
         CHECK_FOR_GL_ERROR();
     }
-    if (node->IsOptionEnabled(RenderStateNode::COLOR_MATERIAL)) {
-        glEnable(GL_COLOR_MATERIAL);
+    if (state.enabled & RenderStateNode::COLOR_MATERIAL) {
+        ctx->Enable(GL_COLOR_MATERIAL);
         CHECK_FOR_GL_ERROR();
     }
-    else if (node->IsOptionDisabled(RenderStateNode::COLOR_MATERIAL)) {
-        glDisable(GL_COLOR_MATERIAL);
+    else if (state.disabled & RenderStateNode::COLOR_MATERIAL) {
+        ctx->Disable(GL_COLOR_MATERIAL);
         CHECK_FOR_GL_ERROR();
     }
 
-    if (node->IsOptionEnabled(RenderStateNode::TEXTURE))
+    if (state.enabled & RenderStateNode::TEXTURE)
         renderTexture = true;
-    else if (node->IsOptionDisabled(RenderStateNode::TEXTURE))
+    else if (state.disabled & RenderStateNode::TEXTURE)
         renderTexture = false;
 
-    if (node->IsOptionEnabled(RenderStateNode::SHADER))
+    if (state.enabled & RenderStateNode::SHADER)
         renderShader = true;
-    else if (node->IsOptionDisabled(RenderStateNode::SHADER))
+    else if (state.disabled & RenderStateNode::SHADER)
         renderShader = false;
 #endif
 
-    // if (node->IsOptionEnabled(RenderStateNode::BINORMAL))
+    // if (state.enabled & RenderStateNode::BINORMAL)
     //     renderBinormal = true;
-    // else if (node->IsOptionDisabled(RenderStateNode::BINORMAL))
+    // else if (state.disabled & RenderStateNode::BINORMAL)
     //     renderBinormal = false;
 
-    // if (node->IsOptionEnabled(RenderStateNode::TANGENT))
+    // if (state.enabled & RenderStateNode::TANGENT)
     //     renderTangent = true;
-    // else if (node->IsOptionDisabled(RenderStateNode::TANGENT))
+    // else if (state.disabled & RenderStateNode::TANGENT)
     //     renderTangent = false;
 
-    // if (node->IsOptionEnabled(RenderStateNode::SOFT_NORMAL))
+    // if (state.enabled & RenderStateNode::SOFT_NORMAL)
     //     renderSoftNormal = true;
-    // else if (node->IsOptionDisabled(RenderStateNode::SOFT_NORMAL))
+    // else if (state.disabled & RenderStateNode::SOFT_NORMAL)
     //     renderSoftNormal = false;
 
-    // if (node->IsOptionEnabled(RenderStateNode::HARD_NORMAL))
+    // if (state.enabled & RenderStateNode::HARD_NORMAL)
     //     renderHardNormal = true;
-    // else if (node->IsOptionDisabled(RenderStateNode::HARD_NORMAL))
+    // else if (state.disabled & RenderStateNode::HARD_NORMAL)
     //     renderHardNormal = false;
 
 }
@@ -181,9 +319,8 @@ void RenderingView::VisitRenderStateNode(Scene::RenderStateNode* node) {
     // save old state
     RenderStateNode* prevCurrent = currentRenderState;
 
-    // apply combined render state
+    // combined render state, captured by the meshes in the sub tree
     currentRenderState = currentRenderState->GetCombined(*node);
-    ApplyRenderState(currentRenderState);
 
     // visit sub tree
     node->VisitSubNodes(*this);
@@ -191,9 +328,6 @@ void RenderingView::VisitRenderStateNode(Scene::RenderStateNode* node) {
     // restore previous state
     delete currentRenderState;
     currentRenderState = prevCurrent;
-    ApplyRenderState(currentRenderState);
-
-    CHECK_FOR_GL_ERROR();
 }
 
 /**
@@ -202,6 +336,9 @@ void RenderingView::VisitRenderStateNode(Scene::RenderStateNode* node) {
  * @param node Transformation node to apply.
  */
 void RenderingView::VisitTransformationNode(TransformationNode* node) {
+    // skip sub trees outside the view frustum
+    if (bvh && !bvh->Intersects(node, Frustum(modelViewMatrix * projectionMatrix)))
+        return;
 
     Matrix<4,4,float> m = node->GetTransformationMatrix();
     Matrix<4,4,float> oldMv = modelViewMatrix;
@@ -215,25 +352,330 @@ void RenderingView::VisitTransformationNode(TransformationNode* node) {
 /**
  * Process a mesh node.
  *
+ * The mesh is queued along with its transformation and render
+ * state, and drawn when the queue is submitted. Meshes whose bounds
+ * are outside the view frustum or hidden behind the occluders of the
+ * occlusion culler are skipped.
+ *
  * @param node Mesh node to render
  */
 void RenderingView::VisitMeshNode(MeshNode* node) {
-    Mesh* mesh = node->GetMesh().get();
-    Material* mat = mesh->GetMaterial().get();
-    
-    if (mat->transparency > 0.0) {
+    const MeshPtr& mesh = node->GetMesh();
+    const IDataBlockPtr& verts = mesh->GetGeometrySet()->GetVertices();
+
+    // skip meshes outside the view frustum or behind the occluders
+    bool visible = true;
+    Vector<3,float> center;
+    if (verts) {
+        const Bounds& bounds = renderer->GetBoundsCache()->Lookup(verts);
+        Matrix<4,4,float> mvp = modelViewMatrix * projectionMatrix;
+        visible = Frustum(mvp).Intersects(bounds) && 
+            (occlusion == NULL || occlusion->IsOccluder(mesh.get()) || 
+             occlusion->IsVisible(bounds, mvp));
+        if (!bounds.infinite) 
+            center = (bounds.min + bounds.max) * 0.5f;
+    }
+    if (visible) {
         RenderObject ro;
         ro.mesh = mesh;
-        ro.modelViewMatrix = Matrix<4,4,float>(modelViewMatrix);
-        transparencyQueue.push_back(ro);
+        ro.modelViewMatrix = modelViewMatrix;
+        ro.state = GetRenderState(currentRenderState);
+        ro.depth = -(center[0] * modelViewMatrix(0,2) + 
+                     center[1] * modelViewMatrix(1,2) + 
+                     center[2] * modelViewMatrix(2,2) + 
+                     modelViewMatrix(3,2));
+        ro.batch = -1;
+        renderQueue.push_back(ro);
     }
-    else RenderMesh(mesh, modelViewMatrix); 
 
     node->VisitSubNodes(*this);
+}
+
+PhongShader* RenderingView::LookupShader(const MeshPtr& mesh) {
+    MeshKey key(mesh);
+    map<MeshKey, PhongShader*>::iterator it = shaders.find(key);
+    if (it != shaders.end())
+        return it->second;
+    PhongShader* shad = new PhongShader(mesh.get(), false, frameBlock);
+    if (!frameBlock) shad->SetLight(light, Vector<4,float>(0.3, 0.3, 0.3, 1.0));
+    shaders[key] = shad;
+    return shad;
+}
+
+// least number of copies of a mesh drawn instanced
+static const unsigned int MIN_INSTANCES = 2;
+
+/**
+ * True if the item can be drawn as part of an instance batch. This
+ * requires the shader path and an opaque mesh without cube maps, as
+ * the instanced shader has no inverse normal matrix.
+ */
+bool RenderingView::IsInstanceable(RenderObject& ro) {
+#if FIXED_FUNCTION
+    if (!(ro.state.enabled & RenderStateNode::SHADER)) return false;
+#endif
+    Material* mat = ro.mesh->GetMaterial().get();
+    return mat->transparency <= 0.0 && mat->GetCubemaps().empty();
+}
+
+/**
+ * Replace repeated meshes in the render queue by instance batches.
+ * Copies of a mesh with the render state of its first copy are
+ * batched, the rest are drawn one by one. A batch is sorted by its
+ * nearest instance.
+ */
+void RenderingView::BatchInstances() {
+    map<Mesh*, unsigned int> counts;
+    vector<RenderObject>::iterator it = renderQueue.begin();
+    for (; it != renderQueue.end(); ++it) {
+        if (IsInstanceable(*it)) ++counts[it->mesh.get()];
+    }
+
+    map<Mesh*, unsigned int> batched; // mesh to queue index of its batch
+    batchQueue.clear();
+    for (it = renderQueue.begin(); it != renderQueue.end(); ++it) {
+        if (!IsInstanceable(*it) || counts[it->mesh.get()] < MIN_INSTANCES) {
+            batchQueue.push_back(*it);
+            continue;
+        }
+        map<Mesh*, unsigned int>::iterator b = batched.find(it->mesh.get());
+        if (b == batched.end()) {
+            InstanceBatch batch;
+            batch.mesh = it->mesh;
+            batch.modelViewMatrices.push_back(it->modelViewMatrix);
+            batches.push_back(batch);
+            batched[it->mesh.get()] = batchQueue.size();
+            batchQueue.push_back(*it);
+            batchQueue.back().batch = batches.size() - 1;
+            continue;
+        }
+        RenderObject& first = batchQueue[b->second];
+        if (first.state.enabled != it->state.enabled || 
+            first.state.disabled != it->state.disabled) {
+            batchQueue.push_back(*it);
+            continue;
+        }
+        batches[first.batch].modelViewMatrices.push_back(it->modelViewMatrix);
+        if (it->depth < first.depth) first.depth = it->depth;
+    }
+    renderQueue.swap(batchQueue);
+
+    // make sure the instanced shaders exist before sorting
+    vector<InstanceBatch>::iterator b = batches.begin();
+    for (; b != batches.end(); ++b)
+        LookupInstanceData(b->mesh, b->modelViewMatrices.size());
+}
+
+RenderingView::InstanceData& RenderingView::LookupInstanceData(const MeshPtr& mesh, unsigned int instances) {
+    MeshKey key(mesh);
+    map<MeshKey, InstanceData>::iterator it = instanceData.find(key);
+    if (it == instanceData.end()) {
+        InstanceData data;
+        data.shader = new PhongShader(mesh.get(), true, frameBlock);
+        if (!frameBlock) data.shader->SetLight(light, Vector<4,float>(0.3, 0.3, 0.3, 1.0));
+        data.capacity = 0;
+        it = instanceData.insert(std::make_pair(key, data)).first;
+    }
+    InstanceData& data = it->second;
+    if (data.capacity < instances) {
+        // grow the streams geometrically
+        data.capacity = std::max(instances, data.capacity * 2);
+        DataBlock<16,float>* mvs = 
+            new DataBlock<16,float>(data.capacity, NULL, Resources::ARRAY, Resources::DYNAMIC);
+        DataBlock<9,float>* nms = 
+            new DataBlock<9,float>(data.capacity, NULL, Resources::ARRAY, Resources::DYNAMIC);
+        mvs->SetUnloadPolicy(Resources::UNLOAD_EXPLICIT);
+        nms->SetUnloadPolicy(Resources::UNLOAD_EXPLICIT);
+        data.modelViewMatrices = IDataBlockPtr(mvs);
+        data.normalMatrices = IDataBlockPtr(nms);
+        data.shader->GetAttribute("instanceModelViewMatrix").Set(data.modelViewMatrices);
+        data.shader->GetAttribute("instanceNormalMatrix").Set(data.normalMatrices);
+    }
+    return data;
+}
+
+/**
+ * Draw all instances of a batch with one instanced draw call. The
+ * matrices are streamed to the per instance attributes.
+ */
+void RenderingView::RenderInstances(InstanceBatch& batch) {
+    Mesh* mesh = batch.mesh.get();
+    unsigned int instances = batch.modelViewMatrices.size();
+    InstanceData& data = LookupInstanceData(batch.mesh, instances);
+
+    float* mvs = (float*)data.modelViewMatrices->GetVoidDataPtr();
+    float* nms = (float*)data.normalMatrices->GetVoidDataPtr();
+    for (unsigned int i = 0; i < instances; ++i) {
+        Matrix<4,4,float>& m = batch.modelViewMatrices[i];
+        m.ToArray(mvs + i * 16);
+        m.GetReduced().GetInverse().GetTranspose().ToArray(nms + i * 9);
+    }
+    ctx->UpdateVBO(data.modelViewMatrices.get());
+    ctx->UpdateVBO(data.normalMatrices.get());
+
+    if (!frameBlock) data.shader->GetUniform("projectionMatrix").Set(projectionMatrix);
+    if (ctx->Apply(data.shader) == 0) return;
+
+    IDataBlock* indices = mesh->indices.get();
+    ctx->BindBuffer(GL_ELEMENT_ARRAY_BUFFER, ctx->LookupVBO(mesh->indices));
+#ifndef OE_IOS
+    ctx->DrawElementsInstanced(mesh->GetType(), 
+                               mesh->GetDrawingRange(), 
+                               indices->GetType(), 
+                               (GLvoid*)(ctx->LookupVBOOffset(indices) + 
+                                         mesh->GetIndexOffset() * GLContext::GLTypeSize(indices->GetType())),
+                               instances);
+#endif
     CHECK_FOR_GL_ERROR();
+    ctx->Release(data.shader);
 }
 
-void RenderingView::RenderMesh(Mesh* mesh, Matrix<4,4,float> mvMatrix) {
+/**
+ * Map a float to an unsigned integer with the same ordering.
+ */
+static inline uint32_t OrderedBits(float f) {
+    uint32_t bits;
+    memcpy(&bits, &f, sizeof(bits));
+    return bits ^ ((bits & 0x80000000) ? 0xFFFFFFFF : 0x80000000);
+}
+
+/**
+ * Build the sort key of a draw item.
+ *
+ * From the most significant bit: transparency (1 bit), render state
+ * (7 bits), program (16 bits), texture set hash (16 bits) and view
+ * depth (24 bits). Opaque items thereby group by state and front to
+ * back within a group, which is what the early depth test wants.
+ *
+ * Transparent items are only keyed on depth, back to front, as
+ * blending depends on the order.
+ */
+uint64_t RenderingView::SortKey(RenderObject& ro) {
+    Mesh* mesh = ro.mesh.get();
+    if (mesh->GetMaterial()->transparency > 0.0) 
+        return TRANSPARENT_KEY | (~OrderedBits(ro.depth) >> 8);
+
+    uint64_t key = 0;
+    RenderState state = ro.state;
+
+    // the combined state options in use fit in the lowest 11 bits,
+    // fold them to 7.
+    unsigned int s = state.enabled;
+    s = (s & 0x3F) | ((s & RenderStateNode::COLOR_MATERIAL) >> 4);
+    key |= uint64_t(s & 0x7F) << 56;
+
+    GLuint program = 0;
+    unsigned int textures = 0;
+    bool shader = ctx->ShaderSupport();
+#if FIXED_FUNCTION
+    shader = shader && (state.enabled & RenderStateNode::SHADER);
+#endif
+    if (shader) {
+        Shader* shad = ro.batch >= 0 ? instanceData[MeshKey(ro.mesh)].shader : LookupShader(ro.mesh);
+        // do not wait for shaders still compiling
+        GLContext::GLShader& glshader = ctx->LookupShader(shad, false);
+        program = glshader.id;
+        vector<pair<Box<ITexture2DPtr>*, GLint> >::iterator it = glshader.textures.begin();
+        for (; it != glshader.textures.end(); ++it)
+            textures = textures * 31 + ctx->LookupTexture(it->first->Get());
+    }
+    else if (mesh->GetMaterial()->Get2DTextures().size() > 0)
+        textures = ctx->LookupTexture(mesh->GetMaterial()->Get2DTextures().begin()->second);
+    key |= uint64_t(program & 0xFFFF) << 40;
+    key |= uint64_t((textures ^ (textures >> 16)) & 0xFFFF) << 24;
+
+    key |= OrderedBits(ro.depth) >> 8;
+    return key;
+}
+
+/**
+ * Enable or disable back to front sorting of the triangles of a
+ * transparent mesh. The vertices and unsigned int indices of the mesh
+ * must still be loaded when enabling, and the indices in range.
+ */
+void RenderingView::SetTriangleSorting(MeshPtr mesh, bool enable) {
+    map<MeshKey, TriangleOrder*>::iterator it = triangleOrders.find(MeshKey(mesh));
+    if (!enable) {
+        if (it == triangleOrders.end()) return;
+        delete it->second;
+        triangleOrders.erase(it);
+        return;
+    }
+    if (it != triangleOrders.end()) return;
+
+    IDataBlock* verts = mesh->GetGeometrySet()->GetVertices().get();
+    IDataBlock* is = mesh->indices.get();
+    if (mesh->GetType() != Geometry::TRIANGLES)
+        throw Exception("Triangle sorting requires a triangle mesh.");
+    if (verts == NULL || is == NULL || verts->GetVoidDataPtr() == NULL || is->GetVoidDataPtr() == NULL
+        || verts->GetType() != Types::FLOAT || is->GetType() != Types::UINT)
+        throw Exception("Triangle sorting requires loaded vertices and indices.");
+
+    unsigned int* indices = (unsigned int*)is->GetVoidDataPtr();
+    unsigned int offset = std::min(mesh->GetIndexOffset(), is->GetSize());
+    unsigned int count = std::min(mesh->GetDrawingRange(), is->GetSize() - offset);
+    count -= count % 3;
+    // checked before the order is made, so a bad mesh leaves none
+    for (unsigned int i = offset; i < offset + count; ++i)
+        if (indices[i] >= verts->GetSize())
+            throw Exception("Triangle sorting index out of range.");
+
+    TriangleOrder* order = new TriangleOrder();
+    float* v = (float*)verts->GetVoidDataPtr();
+    unsigned int dim = verts->GetDimension();
+    order->triangles.assign(indices + offset, indices + offset + count);
+    for (unsigned int i = 0; i < count; i += 3) {
+        for (unsigned int c = 0; c < 3; ++c) {
+            float sum = 0.0f;
+            for (unsigned int k = 0; k < 3; ++k)
+                sum += c < dim ? v[order->triangles[i + k] * dim + c] : 0.0f;
+            order->centroids.push_back(sum / 3.0f);
+        }
+    }
+    DataBlock<1,unsigned int>* sorted = 
+        new DataBlock<1,unsigned int>(count, NULL, Resources::ELEMENT_ARRAY, Resources::DYNAMIC);
+    sorted->SetUnloadPolicy(Resources::UNLOAD_EXPLICIT);
+    order->indices = IDataBlockPtr(sorted);
+    order->sorted = false;
+    triangleOrders[MeshKey(mesh)] = order;
+}
+
+/**
+ * Sort the triangles of a mesh back to front by the view depth of
+ * their centroids and upload the new order. Nothing is done if the
+ * modelview matrix is the one of the previous sort.
+ */
+IDataBlock* RenderingView::SortTriangles(TriangleOrder* order, Matrix<4,4,float>& mvMatrix) {
+    if (order->sorted && order->modelViewMatrix == mvMatrix) 
+        return order->indices.get();
+
+    unsigned int n = order->centroids.size() / 3;
+    triangleQueue.resize(n);
+    const float* c = n > 0 ? &order->centroids[0] : NULL;
+    for (unsigned int i = 0; i < n; ++i, c += 3) {
+        float depth = -(c[0] * mvMatrix(0,2) + c[1] * mvMatrix(1,2) + 
+                        c[2] * mvMatrix(2,2) + mvMatrix(3,2));
+        triangleQueue[i].key = ~OrderedBits(depth);
+        triangleQueue[i].index = i;
+    }
+    Utils::RadixSort(triangleQueue, sortBuffer);
+
+    unsigned int* dst = (unsigned int*)order->indices->GetVoidDataPtr();
+    for (unsigned int i = 0; i < n; ++i) {
+        const unsigned int* tri = &order->triangles[triangleQueue[i].index * 3];
+        dst[i * 3]     = tri[0];
+        dst[i * 3 + 1] = tri[1];
+        dst[i * 3 + 2] = tri[2];
+    }
+    if (ctx->VBOSupport())
+        ctx->UpdateVBO(order->indices.get());
+
+    order->modelViewMatrix = mvMatrix;
+    order->sorted = true;
+    return order->indices.get();
+}
+
+void RenderingView::RenderMesh(const MeshPtr& mesh, Matrix<4,4,float> mvMatrix, IDataBlock* sortedIndices) {
     // index buffer
     IDataBlock* indices = mesh->indices.get();
 
@@ -241,12 +683,19 @@ void RenderingView::RenderMesh(Mesh* mesh, Matrix<4,4,float> mvMatrix) {
     GLsizei offset = mesh->GetIndexOffset();
     Geometry::Type type = mesh->GetType();
 
+    // sorted copy of the drawing range
+    if (sortedIndices) {
+        indices = sortedIndices;
+        count = sortedIndices->GetSize();
+        offset = 0;
+    }
+
     PhongShader* shad;
 
     // material
     Material* mat = mesh->GetMaterial().get();    
     if (mat->transparency > 0.0) {
-        glEnable(GL_BLEND);
+        ctx->Enable(GL_BLEND);
         glBlendFunc(GL_ONE_MINUS_CONSTANT_ALPHA, GL_CONSTANT_ALPHA);
         glBlendColor(0.0, 0.0, 0.0, mat->transparency);
         glBlendEquation(GL_FUNC_ADD);
@@ -255,42 +704,37 @@ void RenderingView::RenderMesh(Mesh* mesh, Matrix<4,4,float> mvMatrix) {
 #if FIXED_FUNCTION
     if (renderShader && ctx->ShaderSupport()) {        
 #endif
-        // for now we simply rebind everything in each lookup
-        // todo: optimize to only rebind when needed (event driven rebinding).
-        // todo: optimize by caching locations
-        map<Mesh*, PhongShader*>::iterator it = shaders.find(mesh);
-        if (it != shaders.end())
-            shad = it->second;
-        else {
-            shad = new PhongShader(mesh);
-            shad->SetLight(light, Vector<4,float>(0.3, 0.3, 0.3, 1.0));
-            shaders[mesh] = shad;
-        }
+        // the context only forwards bindings which actually changed.
+        shad = LookupShader(mesh);
         shad->SetModelViewMatrix(mvMatrix);
         shad->SetModelViewProjectionMatrix(mvMatrix * projectionMatrix);
 
-        ctx->Apply(shad);
+        // nothing is drawn for a shader which failed to compile
+        bool applied = ctx->Apply(shad) != 0;
         
-        if (ctx->VBOSupport()) {
-            glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ctx->LookupVBO(indices));
-            glDrawElements(type, 
-                           count, 
-                           indices->GetType(), 
-                           (GLvoid*)(offset * GLContext::GLTypeSize(indices->GetType())));
-            glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+        if (applied && ctx->VBOSupport()) {
+            ctx->BindBuffer(GL_ELEMENT_ARRAY_BUFFER, sortedIndices ? ctx->LookupVBO(indices) 
+                                                                   : ctx->LookupVBO(mesh->indices));
+            ctx->DrawElements(type, 
+                              count, 
+                              indices->GetType(), 
+                              (GLvoid*)(ctx->LookupVBOOffset(indices) + 
+                                        offset * GLContext::GLTypeSize(indices->GetType())));
         }
-        else {
-            glDrawElements(type,
-                           count,
-                           indices->GetType(),
-                           (char*)indices->GetVoidDataPtr() + offset * GLContext::GLTypeSize(indices->GetType()));
+        else if (applied) {
+            ctx->DrawElements(type,
+                              count,
+                              indices->GetType(),
+                              (char*)indices->GetVoidDataPtr() + offset * GLContext::GLTypeSize(indices->GetType()));
         }
         ctx->Release(shad);
         
 #if FIXED_FUNCTION
 
     } else {
-        
+        // hand over a clean state to the fixed function pipeline
+        ctx->ResetState();
+
         float f[16];
         mvMatrix.ToArray(f);
         glLoadIdentity();
@@ -301,9 +745,8 @@ void RenderingView::RenderMesh(Mesh* mesh, Matrix<4,4,float> mvMatrix) {
     
     if (renderTexture && mat->Get2DTextures().size() > 0) {
         glEnable(GL_TEXTURE_2D);
-        ITexture2D* tex = (*mat->Get2DTextures().begin()).second.get();
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, ctx->LookupTexture(tex));
+        ITexture2DPtr tex = (*mat->Get2DTextures().begin()).second;
+        ctx->BindTexture(0, GL_TEXTURE_2D, ctx->LookupTexture(tex));
         CHECK_FOR_GL_ERROR();
     }
 
@@ -339,8 +782,8 @@ void RenderingView::RenderMesh(Mesh* mesh, Matrix<4,4,float> mvMatrix) {
         glEnableClientState(GL_TEXTURE_COORD_ARRAY);
         CHECK_FOR_GL_ERROR();
         if (ctx->VBOSupport()) {
-            glBindBuffer(GL_ARRAY_BUFFER, ctx->LookupVBO(t));
-            glTexCoordPointer(t->GetDimension(), GL_FLOAT, 0, 0);
+            ctx->BindBuffer(GL_ARRAY_BUFFER, ctx->LookupVBO(*itr));
+            glTexCoordPointer(t->GetDimension(), GL_FLOAT, 0, (GLvoid*)ctx->LookupVBOOffset(t));
         }
         else {
             glTexCoordPointer(t->GetDimension(), GL_FLOAT, 0, t->GetVoidDataPtr());
@@ -350,42 +793,43 @@ void RenderingView::RenderMesh(Mesh* mesh, Matrix<4,4,float> mvMatrix) {
 
     if (ctx->VBOSupport()) {
         if (v) { 
-            glBindBuffer(GL_ARRAY_BUFFER, ctx->LookupVBO(v)); 
-            glVertexPointer(v->GetDimension(), GL_FLOAT, 0, 0); 
+            ctx->BindBuffer(GL_ARRAY_BUFFER, ctx->LookupVBO(geom->GetVertices())); 
+            glVertexPointer(v->GetDimension(), GL_FLOAT, 0, (GLvoid*)ctx->LookupVBOOffset(v)); 
         }
         if (n) {
-            glBindBuffer(GL_ARRAY_BUFFER, ctx->LookupVBO(n));
-            glNormalPointer(GL_FLOAT, 0, 0);  
+            ctx->BindBuffer(GL_ARRAY_BUFFER, ctx->LookupVBO(geom->GetNormals()));
+            glNormalPointer(GL_FLOAT, 0, (GLvoid*)ctx->LookupVBOOffset(n));  
         }
         if (c) { 
-            glBindBuffer(GL_ARRAY_BUFFER, ctx->LookupVBO(c));
-            glColorPointer(c->GetDimension(), GL_FLOAT, 0, 0); 
+            ctx->BindBuffer(GL_ARRAY_BUFFER, ctx->LookupVBO(geom->GetColors()));
+            glColorPointer(c->GetDimension(), GL_FLOAT, 0, (GLvoid*)ctx->LookupVBOOffset(c)); 
         }
 
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ctx->LookupVBO(indices));
-        glDrawElements(type, 
-                       count, 
-                       indices->GetType(), 
-                       (GLvoid*)(offset * GLContext::GLTypeSize(indices->GetType())));
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
-        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        ctx->BindBuffer(GL_ELEMENT_ARRAY_BUFFER, sortedIndices ? ctx->LookupVBO(indices) 
+                                                               : ctx->LookupVBO(mesh->indices));
+        ctx->DrawElements(type, 
+                          count, 
+                          indices->GetType(), 
+                          (GLvoid*)(ctx->LookupVBOOffset(indices) + 
+                                    offset * GLContext::GLTypeSize(indices->GetType())));
+        ctx->BindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+        ctx->BindBuffer(GL_ARRAY_BUFFER, 0);
     }
     else {
         if (v) glVertexPointer(v->GetDimension(), GL_FLOAT, 0, v->GetVoidDataPtr());
         if (n) glNormalPointer(GL_FLOAT, 0, n->GetVoidDataPtr());
         if (c) glColorPointer(c->GetDimension(), GL_FLOAT, 0, c->GetVoidDataPtr());
-        glDrawElements(type, 
-                       count, 
-                       indices->GetType(), 
-                       (char*)indices->GetVoidDataPtr() + offset * GLContext::GLTypeSize(indices->GetType()));
+        ctx->DrawElements(type, 
+                          count, 
+                          indices->GetType(), 
+                          (char*)indices->GetVoidDataPtr() + offset * GLContext::GLTypeSize(indices->GetType()));
     }
 
     // cleanup
     glDisableClientState(GL_VERTEX_ARRAY);
     glDisableClientState(GL_NORMAL_ARRAY);
     glDisableClientState(GL_COLOR_ARRAY);
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, 0);
+    ctx->BindTexture(0, GL_TEXTURE_2D, 0);
     glDisable(GL_TEXTURE_2D);
 
     itr = ts.begin();
@@ -398,7 +842,7 @@ void RenderingView::RenderMesh(Mesh* mesh, Matrix<4,4,float> mvMatrix) {
     CHECK_FOR_GL_ERROR();
     }
 #endif
-    glDisable(GL_BLEND);
+    ctx->Disable(GL_BLEND);
 }
 
 } // NS OpenGL
@@ -18,7 +18,10 @@
 #include <Meta/OpenGL.h>
 #include <Math/Matrix.h>
 
+#include <boost/weak_ptr.hpp>
 #include <map>
+#include <vector>
+#include <stdint.h>
 
 namespace OpenEngine {
     // Forward declarations.
@@ -33,11 +36,14 @@ namespace OpenEngine {
     }
 
 namespace Renderers2 {
+    class BoundingVolumeHierarchy;
+    class OcclusionCuller;
 namespace OpenGL {
 
 using Scene::ISceneNodeVisitor;
 using Core::IListener;
 using Geometry::Mesh;
+using Geometry::MeshPtr;
 using Geometry::GeometrySet;
 using Geometry::Material;
 using Math::Matrix;
@@ -47,6 +53,7 @@ using Scene::MeshNode;
 using Resources2::PhongShader;
 using Resources2::Shader;
 using std::map;
+using std::vector;
 
 /**
  * Concrete scene traverser and rendering tool using OpenGL.
@@ -56,23 +63,85 @@ class RenderingView
 private:
     GLContext* ctx;
     GLRenderer* renderer;
+    BoundingVolumeHierarchy* bvh;
+    OcclusionCuller* occlusion;
     RenderStateNode* currentRenderState;
     // bool renderBinormal, renderTangent, renderSoftNormal, renderHardNormal;
     bool renderTexture, renderShader;
+    bool frameBlock;    // lights and projection in a uniform block
 
-    map<Mesh*, PhongShader*> shaders; // hack until material type is revised
+    // per mesh data is keyed on weak pointers, so a new mesh at the
+    // address of a destroyed one never finds its data, and the data
+    // of destroyed meshes is released by ReleaseDead.
+    typedef boost::weak_ptr<Mesh> MeshKey;
+    map<MeshKey, PhongShader*> shaders; // hack until material type is revised
+    unsigned int releaseFrame;          // frame of the last ReleaseDead
 
     Matrix<4,4,float> modelViewMatrix, projectionMatrix;
 
+    // render state options as enabled and disabled bit masks.
+    struct RenderState {
+        unsigned int enabled, disabled;
+    };
+
     struct RenderObject {
-        Mesh* mesh;
+        MeshPtr mesh;
         Matrix<4,4,float> modelViewMatrix;
+        RenderState state;
+        float depth; // view space depth of the bounds center
+        int batch;   // index of the instance batch, -1 if drawn alone
+    };
+
+    // instances of a mesh drawn with one instanced draw call.
+    struct InstanceBatch {
+        MeshPtr mesh;
+        vector<Matrix<4,4,float> > modelViewMatrices;
+    };
+    vector<InstanceBatch> batches;
+
+    // instanced shader of a mesh and its per instance data streams.
+    struct InstanceData {
+        PhongShader* shader;
+        IDataBlockPtr modelViewMatrices, normalMatrices;
+        unsigned int capacity;
     };
+    map<MeshKey, InstanceData> instanceData;
 
-    vector<RenderObject> transparencyQueue;
+    // back to front triangle order of a transparent mesh.
+    struct TriangleOrder {
+        vector<unsigned int> triangles;  // copy of the mesh indices
+        vector<float> centroids;         // object space, 3 floats per triangle
+        IDataBlockPtr indices;           // triangles in sorted order
+        Matrix<4,4,float> modelViewMatrix; // matrix of the last sort
+        bool sorted;
+    };
+    map<MeshKey, TriangleOrder*> triangleOrders;
+
+    // most significant sort key bit, set for transparent items.
+    static const uint64_t TRANSPARENT_KEY = uint64_t(1) << 63;
+
+    // sort key and index into the render queue.
+    struct QueueEntry {
+        uint64_t key;
+        unsigned int index;
+    };
+
+    // draw items collected during traversal, submitted in key order.
+    vector<RenderObject> renderQueue, batchQueue;
+    vector<QueueEntry> sortQueue, sortBuffer, triangleQueue;
 
-    inline void RenderMesh(Mesh* mesh, Matrix<4,4,float> modelViewMatrix);
-    inline void ApplyRenderState(RenderStateNode* node);
+    inline void RenderMesh(const MeshPtr& mesh, Matrix<4,4,float> modelViewMatrix, 
+                           IDataBlock* sortedIndices = NULL);
+    inline RenderState GetRenderState(RenderStateNode* node);
+    inline void ApplyRenderState(RenderState state);
+    inline uint64_t SortKey(RenderObject& ro);
+    inline IDataBlock* SortTriangles(TriangleOrder* order, Matrix<4,4,float>& mvMatrix);
+    inline PhongShader* LookupShader(const MeshPtr& mesh);
+    inline InstanceData& LookupInstanceData(const MeshPtr& mesh, unsigned int instances);
+    void ReleaseDead();
+    inline bool IsInstanceable(RenderObject& ro);
+    inline void BatchInstances();
+    inline void RenderInstances(InstanceBatch& batch);
     inline void BindUniforms(GLContext::GLShader& glshader);
     inline void BindAttributes(GLContext::GLShader& glshader);
     inline void UnbindAttributes(GLContext::GLShader& glshader);
@@ -87,6 +156,8 @@ public:
     void VisitTransformationNode(TransformationNode* node);
     void VisitRenderStateNode(RenderStateNode* node);
     void Handle(RenderingEventArg arg);
+
+    void SetTriangleSorting(MeshPtr mesh, bool enable);
 };
 
 } // NS OpenGL
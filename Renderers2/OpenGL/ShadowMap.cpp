@@ -18,6 +18,10 @@
 #include <Geometry/GeometrySet.h>
 #include <Resources/ResourceManager.h>
 #include <Resources2/ShaderResource.h>
+#include <Renderers2/BoundsCache.h>
+#include <Renderers2/Frustum.h>
+#include <Renderers2/BoundingVolumeHierarchy.h>
+#include <Utils/Profiler.h>
 
 namespace OpenEngine {
 namespace Renderers2 {
@@ -49,6 +53,7 @@ ShadowMap::DepthRenderer::DepthRenderer(unsigned int width, unsigned int height)
   , vertAttrib(shader->GetAttribute("vertex"))
   , ctx(NULL)
   , renderer(NULL)
+  , bvh(NULL)
   , num1(2.1)
   , num2(4.0)
 {
@@ -65,18 +70,19 @@ void ShadowMap::DepthRenderer::Initialize(GLContext* ctx, Shader* shader) {
 }
 
 void ShadowMap::DepthRenderer::Render(ISceneNode* scene, IViewingVolume& cam, GLRenderer* renderer) {
+    OE_PROFILE_SCOPE("ShadowMap::DepthRenderer::Render");
     this->renderer = renderer;
     ctx = renderer->GetContext();
+    bvh = renderer->LookupBoundingVolumeHierarchy(scene);
     modelViewMatrix = cam.GetViewMatrix();
     projectionMatrix = cam.GetProjectionMatrix();
 
-    GLint prevFbo;
-    glGetIntegerv(GL_FRAMEBUFFER_BINDING, &prevFbo);
+    GLuint prevFbo = ctx->GetFramebuffer();
 
     GLuint fbo = ctx->LookupFBO(canvas);
 
     // Setup the new frame buffer
-    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, fbo);
+    ctx->BindFramebuffer(fbo);
     glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, 
                            ctx->LookupTexture(ctx->LookupCanvas(canvas).color0.get()), 0);
     glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, 
@@ -88,7 +94,7 @@ void ShadowMap::DepthRenderer::Render(ISceneNode* scene, IViewingVolume& cam, GL
 
     // Turn off unneeded stuff!
     glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
-    glEnable(GL_CULL_FACE);
+    ctx->Enable(GL_CULL_FACE);
     glCullFace(GL_FRONT);
     // glEnable(GL_DEPTH_TEST);
     glEnable(GL_POLYGON_OFFSET_FILL);
@@ -100,11 +106,15 @@ void ShadowMap::DepthRenderer::Render(ISceneNode* scene, IViewingVolume& cam, GL
     glDisable(GL_POLYGON_OFFSET_FILL);
     glCullFace(GL_BACK);
     glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
-    glBindFramebuffer(GL_FRAMEBUFFER, prevFbo);
+    ctx->BindFramebuffer(prevFbo);
     CHECK_FOR_GL_ERROR();
 }
 
 void ShadowMap::DepthRenderer::VisitTransformationNode(TransformationNode* node) {
+    // skip sub trees outside the light frustum
+    if (bvh && !bvh->Intersects(node, Frustum(modelViewMatrix * projectionMatrix)))
+        return;
+
     Matrix<4,4,float> m = node->GetTransformationMatrix();
     Matrix<4,4,float> oldMv = modelViewMatrix;
     modelViewMatrix = m * modelViewMatrix;
@@ -116,6 +126,13 @@ void ShadowMap::DepthRenderer::VisitMeshNode(MeshNode* node) {
     MeshPtr mesh = node->GetMesh();
     GeometrySetPtr geom = mesh->GetGeometrySet();
 
+    // skip meshes outside the light frustum
+    if (geom->GetVertices() && !Frustum(modelViewMatrix * projectionMatrix)
+        .Intersects(renderer->GetBoundsCache()->Lookup(geom->GetVertices()))) {
+        node->VisitSubNodes(*this);
+        return;
+    }
+
     vertAttrib.Set(geom->GetVertices());
     mvpUniform.Set(modelViewMatrix * projectionMatrix);
 
@@ -124,21 +141,25 @@ void ShadowMap::DepthRenderer::VisitMeshNode(MeshNode* node) {
     unsigned int offset = mesh->GetIndexOffset();
     Geometry::Type type = mesh->GetType();
 
-    ctx->Apply(shader);
+    if (ctx->Apply(shader) == 0) {
+        // still compiling
+        node->VisitSubNodes(*this);
+        return;
+    }
     
     if (ctx->VBOSupport()) {
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ctx->LookupVBO(indices));
-        glDrawElements(type, 
-                       count, 
-                       indices->GetType(), 
-                       (GLvoid*)(offset * GLContext::GLTypeSize(indices->GetType())));
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+        ctx->BindBuffer(GL_ELEMENT_ARRAY_BUFFER, ctx->LookupVBO(mesh->indices));
+        ctx->DrawElements(type, 
+                          count, 
+                          indices->GetType(), 
+                          (GLvoid*)(ctx->LookupVBOOffset(indices) + 
+                                    offset * GLContext::GLTypeSize(indices->GetType())));
     }
     else {
-        glDrawElements(type,
-                       count,
-                       indices->GetType(),
-                       (char*)indices->GetVoidDataPtr() + offset * GLContext::GLTypeSize(indices->GetType()));
+        ctx->DrawElements(type,
+                          count,
+                          indices->GetType(),
+                          (char*)indices->GetVoidDataPtr() + offset * GLContext::GLTypeSize(indices->GetType()));
     }
     CHECK_FOR_GL_ERROR();
 
@@ -202,9 +223,8 @@ void ShadowMap::Handle(RenderingEventArg arg) {
         shader->GetTexture2D("color0").Set(atts.color0);
         shader->GetTexture2D("depth").Set(atts.depth);
         
-        GLint prevFbo; 
-        glGetIntegerv(GL_FRAMEBUFFER_BINDING, &prevFbo);
-        GLint fbo = ctx->LookupFBO(arg.canvas);
+        GLuint prevFbo = ctx->GetFramebuffer();
+        GLuint fbo = ctx->LookupFBO(arg.canvas);
         
         if (prevFbo == fbo) {
             glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, 
@@ -216,17 +236,16 @@ void ShadowMap::Handle(RenderingEventArg arg) {
         }
 
         glViewport(0, 0, arg.canvas->GetWidth(), arg.canvas->GetHeight());
-        glDisable(GL_DEPTH_TEST);
-        glDepthMask(GL_FALSE);
+        ctx->Disable(GL_DEPTH_TEST);
+        ctx->DepthMask(GL_FALSE);
         // do the quading with the post process shader
-        ctx->Apply(shader.get());
-        CHECK_FOR_GL_ERROR();
-        glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+        if (ctx->Apply(shader.get()))
+            ctx->DrawArrays(GL_TRIANGLE_STRIP, 0, 4);
         CHECK_FOR_GL_ERROR();
         ctx->Release(shader.get());
         CHECK_FOR_GL_ERROR();
-        glDepthMask(GL_TRUE);
-        glEnable(GL_DEPTH_TEST);
+        ctx->DepthMask(GL_TRUE);
+        ctx->Enable(GL_DEPTH_TEST);
     } 
 }
 
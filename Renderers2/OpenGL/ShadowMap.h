@@ -38,6 +38,7 @@ namespace OpenEngine {
     }
 
 namespace Renderers2 {
+    class BoundingVolumeHierarchy;
 namespace OpenGL {
 
 using Core::IListener;
@@ -72,6 +73,7 @@ private:
         Box<IDataBlockPtr>& vertAttrib;
         GLContext* ctx;
         GLRenderer* renderer;
+        BoundingVolumeHierarchy* bvh;
     public:
         float num1, num2;        
         DepthRenderer(unsigned int width, unsigned int height);
@@ -0,0 +1,196 @@
+// Asynchronous texture loading and upload.
+// -------------------------------------------------------------------
+// Copyright (C) 2007 OpenEngine.dk (See AUTHORS)
+//
+// This program is free software; It is covered by the GNU General
+// Public License version 2 or any later version.
+// See the GNU General Public License for more details (see LICENSE).
+//--------------------------------------------------------------------
+
+#include <Renderers2/OpenGL/TextureStreamer.h>
+#include <Renderers2/OpenGL/GLContext.h>
+#include <cstring>
+
+namespace OpenEngine {
+namespace Renderers2 {
+namespace OpenGL {
+
+TextureStreamer::Worker::Worker(TextureStreamer& streamer)
+    : streamer(streamer)
+    , running(false)
+    , started(false)
+{}
+
+void TextureStreamer::Worker::Run() {
+    ITexture2DPtr tex;
+    while ((tex = streamer.NextRequest(*this))) {
+        tex->Load();
+        streamer.Loaded(tex);
+    }
+}
+
+TextureStreamer::TextureStreamer(GLContext& ctx, unsigned int budget, unsigned int workers)
+    : ctx(ctx)
+    , budget(budget)
+    , nextPBO(0)
+{
+    for (unsigned int i = 0; i < workers; ++i)
+        this->workers.push_back(new Worker(*this));
+    for (unsigned int i = 0; i < PBO_COUNT; ++i)
+        pbos[i] = 0;
+}
+
+TextureStreamer::~TextureStreamer() {
+    mutex.Lock();
+    requests.clear();
+    mutex.Unlock();
+    for (unsigned int i = 0; i < workers.size(); ++i) {
+        if (workers[i]->started) workers[i]->Wait();
+        delete workers[i];
+    }
+}
+
+void TextureStreamer::SetBudget(unsigned int bytes) {
+    budget = bytes;
+}
+
+/**
+ * Hand the next request to a worker. A worker finding the queue
+ * empty marks itself as stopped while holding the lock, so Request
+ * knows to start it again.
+ */
+ITexture2DPtr TextureStreamer::NextRequest(Worker& worker) {
+    mutex.Lock();
+    ITexture2DPtr tex;
+    if (requests.empty())
+        worker.running = false;
+    else {
+        tex = requests.front();
+        requests.pop_front();
+    }
+    mutex.Unlock();
+    return tex;
+}
+
+void TextureStreamer::Loaded(ITexture2DPtr tex) {
+    mutex.Lock();
+    loaded.push_back(tex);
+    mutex.Unlock();
+}
+
+void TextureStreamer::Request(ITexture2DPtr tex) {
+    if (!pending.insert(tex.get()).second) return;
+    // still on its way from before a Clear, uploaded when it arrives
+    if (!queued.insert(tex.get()).second) return;
+    mutex.Lock();
+    requests.push_back(tex);
+    // start an idle worker, joining its previous run first
+    Worker* idle = NULL;
+    for (unsigned int i = 0; i < workers.size() && idle == NULL; ++i)
+        if (!workers[i]->running) idle = workers[i];
+    if (idle) idle->running = true;
+    mutex.Unlock();
+
+    if (idle) {
+        if (idle->started) idle->Wait();
+        idle->started = true;
+        idle->Start();
+    }
+}
+
+bool TextureStreamer::IsPending(ITexture2D* tex) {
+    return pending.find(tex) != pending.end();
+}
+
+void TextureStreamer::Process() {
+    list<ITexture2DPtr> ready;
+    mutex.Lock();
+    ready.swap(loaded);
+    mutex.Unlock();
+
+    unsigned int used = 0;
+    while (!ready.empty()) {
+        ITexture2D* tex = ready.front().get();
+        if (pending.find(tex) == pending.end()) {
+            // cleared while loading
+            tex->Unload();
+            queued.erase(tex);
+            ready.pop_front();
+            continue;
+        }
+        unsigned int size = tex->GetWidth() * tex->GetHeight() *
+            tex->GetChannels() * GLContext::GLTypeSize(tex->GetType());
+        if (used > 0 && used + size > budget) break;
+        Upload(tex);
+        used += size;
+        pending.erase(tex);
+        queued.erase(tex);
+        tex->Unload();
+        ready.pop_front();
+    }
+
+    // the rest waits for the next frame, in order
+    mutex.Lock();
+    loaded.splice(loaded.begin(), ready);
+    mutex.Unlock();
+}
+
+void TextureStreamer::Upload(ITexture2D* tex) {
+    ctx.BindTexture(GL_TEXTURE_2D, ctx.LookupTexture(tex));
+    ctx.PixelStore(GL_UNPACK_ALIGNMENT, 1);
+    const GLvoid* data = tex->GetVoidDataPtr();
+#ifndef OE_IOS
+    bool staged = false;
+    if (GLEW_ARB_pixel_buffer_object) {
+        unsigned int size = tex->GetWidth() * tex->GetHeight() *
+            tex->GetChannels() * GLContext::GLTypeSize(tex->GetType());
+        if (pbos[0] == 0) glGenBuffers(PBO_COUNT, pbos);
+        ctx.BindBuffer(GL_PIXEL_UNPACK_BUFFER, pbos[nextPBO]);
+        nextPBO = (nextPBO + 1) % PBO_COUNT;
+        // orphan, then fill through a mapping
+        glBufferData(GL_PIXEL_UNPACK_BUFFER, size, NULL, GL_STREAM_DRAW);
+        void* dst = glMapBuffer(GL_PIXEL_UNPACK_BUFFER, GL_WRITE_ONLY);
+        if (dst) {
+            memcpy(dst, data, size);
+            glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+            data = NULL; // offset into the buffer
+            staged = true;
+        }
+        else
+            ctx.BindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    }
+#endif
+    glTexImage2D(GL_TEXTURE_2D,
+                 0, // mipmap level
+                 GLContext::GLInternalColorFormat(tex->GetColorFormat()),
+                 tex->GetWidth(),
+                 tex->GetHeight(),
+                 0, // border
+                 GLContext::GLColorFormat(tex->GetColorFormat()),
+                 tex->GetType(),
+                 data);
+#ifndef OE_IOS
+    if (staged) ctx.BindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+#endif
+    CHECK_FOR_GL_ERROR();
+    ctx.BindTexture(GL_TEXTURE_2D, 0);
+    ctx.UpdateTextureMemory(tex);
+}
+
+void TextureStreamer::Clear() {
+    mutex.Lock();
+    list<ITexture2DPtr> dropped;
+    dropped.swap(requests);
+    mutex.Unlock();
+    for (list<ITexture2DPtr>::iterator it = dropped.begin(); it != dropped.end(); ++it)
+        queued.erase(it->get());
+    // textures still loading are unloaded when they arrive
+    pending.clear();
+    if (pbos[0]) glDeleteBuffers(PBO_COUNT, pbos);
+    for (unsigned int i = 0; i < PBO_COUNT; ++i)
+        pbos[i] = 0;
+}
+
+} // NS OpenGL
+} // NS Renderers2
+} // NS OpenEngine
@@ -0,0 +1,118 @@
+// Asynchronous texture loading and upload.
+// -------------------------------------------------------------------
+// Copyright (C) 2007 OpenEngine.dk (See AUTHORS)
+//
+// This program is free software; It is covered by the GNU General
+// Public License version 2 or any later version.
+// See the GNU General Public License for more details (see LICENSE).
+//--------------------------------------------------------------------
+
+#ifndef _OE_OPENGL_TEXTURE_STREAMER_H_
+#define _OE_OPENGL_TEXTURE_STREAMER_H_
+
+#include <Resources/ITexture2D.h>
+#include <Meta/OpenGL.h>
+#include <Core/Thread.h>
+#include <Core/Mutex.h>
+#include <list>
+#include <map>
+#include <set>
+#include <vector>
+
+namespace OpenEngine {
+namespace Renderers2 {
+namespace OpenGL {
+
+class GLContext;
+
+using Resources::ITexture2D;
+using Resources::ITexture2DPtr;
+using std::list;
+using std::map;
+using std::set;
+using std::vector;
+
+/**
+ * Texture streamer
+ *
+ * Loads textures on worker threads and uploads them on the render
+ * thread, a limited number of bytes per frame. Uploads are staged
+ * through a ring of pixel buffer objects when supported, so writing
+ * one texture does not wait for the transfer of the previous.
+ *
+ * The context creates the GL texture with placeholder contents
+ * before requesting it, so the texture id stays the same once the
+ * data arrives. The streamer holds a reference to each texture until
+ * it is uploaded or dropped, so a worker never loads a destroyed one.
+ *
+ * @class TextureStreamer TextureStreamer.h Renderers2/OpenGL/TextureStreamer.h
+ */
+class TextureStreamer {
+public:
+    static const unsigned int PBO_COUNT = 3;
+
+private:
+    class Worker : public Core::Thread {
+    private:
+        TextureStreamer& streamer;
+    public:
+        bool running, started;
+        Worker(TextureStreamer& streamer);
+        void Run();
+    };
+
+    GLContext& ctx;
+    unsigned int budget;          // bytes uploaded per frame
+    vector<Worker*> workers;
+
+    // shared with the workers, guarded by the mutex
+    Core::Mutex mutex;
+    list<ITexture2DPtr> requests; // waiting to be loaded
+    list<ITexture2DPtr> loaded;   // waiting to be uploaded
+
+    // render thread only
+    set<ITexture2D*> pending;     // requested and not yet uploaded
+    set<ITexture2D*> queued;      // sent to the workers and not yet back, kept by Clear
+    GLuint pbos[PBO_COUNT];
+    unsigned int nextPBO;
+
+    ITexture2DPtr NextRequest(Worker& worker);
+    void Loaded(ITexture2DPtr tex);
+    void Upload(ITexture2D* tex);
+
+public:
+    TextureStreamer(GLContext& ctx, unsigned int budget, unsigned int workers = 2);
+    virtual ~TextureStreamer();
+
+    void SetBudget(unsigned int bytes);
+    unsigned int GetBudget() const { return budget; }
+
+    /**
+     * Queue a texture without data for loading.
+     */
+    void Request(ITexture2DPtr tex);
+
+    /**
+     * True if the texture was requested and is not yet uploaded.
+     */
+    bool IsPending(ITexture2D* tex);
+
+    /**
+     * Upload loaded textures until the frame budget is spent, at
+     * least one texture per frame. Call on the render thread.
+     */
+    void Process();
+
+    /**
+     * Forget all requests and delete the buffer objects. Textures a
+     * worker is loading are unloaded when they arrive, unless
+     * requested again.
+     */
+    void Clear();
+};
+
+} // NS OpenGL
+} // NS Renderers2
+} // NS OpenEngine
+
+#endif // _OE_OPENGL_TEXTURE_STREAMER_H_
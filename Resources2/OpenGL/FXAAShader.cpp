@@ -77,9 +77,8 @@ void FXAAShader::Handle(RenderingEventArg arg) {
     texA.Set(atts.color0);
     rcpFrame.Set(Vector<2,float>(1.0f / arg.canvas->GetWidth(), 1.0f / arg.canvas->GetHeight()));    
     
-    GLint prevFbo; 
-    glGetIntegerv(GL_FRAMEBUFFER_BINDING, &prevFbo);
-    GLint fbo = ctx->LookupFBO(arg.canvas);
+    GLuint prevFbo = ctx->GetFramebuffer();
+    GLuint fbo = ctx->LookupFBO(arg.canvas);
     
     if (prevFbo == fbo) {
         glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, 
@@ -90,18 +89,18 @@ void FXAAShader::Handle(RenderingEventArg arg) {
         atts.color1 = tmp;
     }
 
-    glDisable(GL_DEPTH_TEST);
-    glDepthMask(GL_FALSE);
+    ctx->Disable(GL_DEPTH_TEST);
+    ctx->DepthMask(GL_FALSE);
     
     //draw quad
-    ctx->Apply(this);
-    glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+    if (ctx->Apply(this))
+        ctx->DrawArrays(GL_TRIANGLE_STRIP, 0, 4);
     CHECK_FOR_GL_ERROR();
     ctx->Release(this);
 
-    glDepthMask(GL_TRUE);
-    glEnable(GL_DEPTH_TEST);
-    glEnable(GL_CULL_FACE);
+    ctx->DepthMask(GL_TRUE);
+    ctx->Enable(GL_DEPTH_TEST);
+    ctx->Enable(GL_CULL_FACE);
 }
 
 void FXAAShader::SetActive(bool active) {
@@ -48,8 +48,21 @@ void PhongShader::UpdateMaterial(Material* mat) {
     GetUniform("frontMaterial.shininess").Set(mat->shininess);
 } 
 
-PhongShader::PhongShader(Mesh* mesh)
+/**
+ * Create a phong shader for a mesh.
+ *
+ * @param mesh Mesh to shade.
+ * @param instanced Read the modelview and normal matrices per
+ * instance from the "instanceModelViewMatrix" and
+ * "instanceNormalMatrix" attributes, and the projection from the
+ * "projectionMatrix" uniform. Cube maps are not supported.
+ * @param frameBlock Read the projection, global ambient and lights
+ * from the "FrameData" uniform block (see SetFrameData) instead of
+ * per shader uniforms. Requires uniform buffer support.
+ */
+PhongShader::PhongShader(Mesh* mesh, bool instanced, bool frameBlock)
     : ShaderResource(*ResourceManager<ShaderResource>::Create("shaders/PhongShaderESCompatible.glsl").get())
+    , frameBlock(frameBlock)
 {
     ShaderResource::Load();    
     // logger.info << "phong" << logger.end;
@@ -142,6 +155,13 @@ PhongShader::PhongShader(Mesh* mesh)
     }
 
     AddDefine("NUM_LIGHTS", 1);
+    if (frameBlock) AddDefine("FRAME_BLOCK");
+
+    if (instanced) {
+        AddDefine("INSTANCED");
+        SetAttributeDivisor("instanceModelViewMatrix", 1);
+        SetAttributeDivisor("instanceNormalMatrix", 1);
+    }
 
     map<string, IDataBlockPtr> attribs = mesh->GetGeometrySet()->GetAttributeLists();
     map<string, IDataBlockPtr>::iterator itr1 = attribs.begin();
@@ -232,6 +252,20 @@ void PhongShader::SetLight(LightVisitor::LightSource l, Vector<4,float> globalAm
     GetUniform("lightSource[0].quadraticAttenuation").Set(l.quadraticAttenuation);
 }
 
+void PhongShader::SetFrameData(FrameData& data, Matrix<4,4,float> projection,
+                               LightVisitor::LightSource l, Vector<4,float> globalAmbient) {
+    projection.ToArray(data.projectionMatrix);
+    globalAmbient.ToArray(data.globalAmbient);
+    l.position.ToArray(data.lightSource[0].position);
+    data.lightSource[0].constantAttenuation = l.constantAttenuation;
+    data.lightSource[0].linearAttenuation = l.linearAttenuation;
+    data.lightSource[0].quadraticAttenuation = l.quadraticAttenuation;
+    data.lightSource[0].padding = 0.0;
+    l.ambient.ToArray(data.lightSource[0].ambient);
+    l.diffuse.ToArray(data.lightSource[0].diffuse);
+    l.specular.ToArray(data.lightSource[0].specular);
+}
+
 string PhongShader::GetVertexShader() {
     return defines + vertexShader;
 }
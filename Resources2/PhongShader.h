@@ -26,7 +26,22 @@ using Renderers2::OpenGL::LightVisitor;
 
 class PhongShader: public ShaderResource
                  , public IListener<Material::ChangedEventArg> {
+public:
+    // std140 layout of the FrameData uniform block, see FRAME_BLOCK
+    // in the shader source.
+    struct FrameData {
+        float projectionMatrix[16];
+        float globalAmbient[4];
+        struct {
+            float position[4];
+            float constantAttenuation, linearAttenuation, quadraticAttenuation, padding;
+            float ambient[4], diffuse[4], specular[4];
+        } lightSource[1]; // NUM_LIGHTS
+    };
+
 private:
+    bool frameBlock;
+
     void AddDefine(string name);
     void AddDefine(string name, int val);
     string defines;
@@ -34,9 +49,14 @@ private:
     void UpdateMaterial(Material* mat);
 
 public:
-    PhongShader(Mesh* mesh);
+    PhongShader(Mesh* mesh, bool instanced = false, bool frameBlock = false);
     virtual ~PhongShader();
 
+    // true if the projection and lights are read from the FrameData block.
+    bool UsesFrameBlock() const { return frameBlock; }
+    static void SetFrameData(FrameData& data, Matrix<4,4,float> projection,
+                             LightVisitor::LightSource l, Vector<4,float> globalAmbient);
+
     void SetModelViewMatrix(Matrix<4,4,float> m);
     void SetModelViewProjectionMatrix(Matrix<4,4,float> m);
 
@@ -78,7 +78,18 @@ Shader::Shader(string vertexShader, string fragmentShader)
 }
 
 Shader::~Shader() {
-    // todo: delete boxes and uniforms and fire destroyedEvent.
+    destroyedEvent.Notify(DestroyedEventArg(this));
+    for (UniformIterator it = uniforms.begin(); it != uniforms.end(); ++it)
+        delete it->second;
+    map<string, Box<IDataBlockPtr>*>::iterator ait = attributes.begin();
+    for (; ait != attributes.end(); ++ait)
+        delete ait->second;
+    map<string, Box<ITexture2DPtr>*>::iterator tit = textures.begin();
+    for (; tit != textures.end(); ++tit)
+        delete tit->second;
+    map<string, Box<ICubemapPtr>*>::iterator cit = cubemaps.begin();
+    for (; cit != cubemaps.end(); ++cit)
+        delete cit->second;
 }
 
 Uniform& Shader::GetUniform(string name) {
@@ -99,6 +110,26 @@ Box<IDataBlockPtr>& Shader::GetAttribute(string name) {
     return *box;
 }
 
+Uniform* Shader::FindUniform(string name) {
+    UniformIterator it = uniforms.find(name);
+    return it != uniforms.end() ? it->second : NULL;
+}
+
+Box<IDataBlockPtr>* Shader::FindAttribute(string name) {
+    map<string, Box<IDataBlockPtr>*>::iterator it = attributes.find(name);
+    return it != attributes.end() ? it->second : NULL;
+}
+
+void Shader::SetAttributeDivisor(string name, unsigned int divisor) {
+    divisors[name] = divisor;
+}
+
+unsigned int Shader::GetAttributeDivisor(string name) {
+    map<string, unsigned int>::iterator it = divisors.find(name);
+    if (it == divisors.end()) return 0;
+    return it->second;
+}
+
 // void Shader::SetAttribute(string name, IDataBlockPtr attr) {
 //     attributes[name] = attr;
 // }
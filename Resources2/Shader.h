@@ -107,15 +107,28 @@ public:
         virtual ~ChangedEventArg() {}
         Shader* shader;
     };
+    // fired by the destructor, before the uniforms and boxes are deleted.
+    class DestroyedEventArg {
+    public:
+        DestroyedEventArg(Shader* shader): shader(shader) {}
+        virtual ~DestroyedEventArg() {}
+        Shader* shader;
+    };
 private:
     map<string, Uniform*> uniforms;
     map<string, Box<IDataBlockPtr>*> attributes;
+    map<string, unsigned int> divisors;
     map<string, Box<ITexture2DPtr>*> textures;
     map<string, Box<ICubemapPtr>*> cubemaps;
+
+    // the uniforms and boxes are owned, so shaders can not be copied.
+    Shader(const Shader&);
+    Shader& operator=(const Shader&);
 protected:
     string vertexShader, fragmentShader;
     Event<ChangedEventArg> changedEvent;
     Event<Uniform::ChangedEventArg> uniformChangedEvent;
+    Event<DestroyedEventArg> destroyedEvent;
 public:
     Shader();
     Shader(string vertexShader, string fragmentShader);
@@ -124,6 +137,21 @@ public:
     Uniform& GetUniform(string name);
     
     Box<IDataBlockPtr>& GetAttribute(string name);
+
+    /**
+     * As above, but NULL if the shader has none of the name, instead
+     * of adding it.
+     */
+    Uniform* FindUniform(string name);
+    Box<IDataBlockPtr>* FindAttribute(string name);
+
+    /**
+     * Advance an attribute once per \a divisor instances instead of
+     * once per vertex when drawing instanced. Must be set before the
+     * shader is first applied.
+     */
+    void SetAttributeDivisor(string name, unsigned int divisor);
+    unsigned int GetAttributeDivisor(string name);
     Box<ITexture2DPtr>& GetTexture2D(string name);
     Box<ICubemapPtr>& GetCubemap(string name);
 
@@ -132,6 +160,7 @@ public:
 
     IEvent<ChangedEventArg>& ChangedEvent() { return changedEvent; }
     IEvent<Uniform::ChangedEventArg>& UniformChangedEvent() { return uniformChangedEvent; }
+    IEvent<DestroyedEventArg>& DestroyedEvent() { return destroyedEvent; }
 };
 
 } // NS Resources
@@ -103,6 +103,16 @@ ShaderResource::ShaderResource(ShaderResourcePlugin& plugin, string filename)
 
 }
 
+ShaderResource::ShaderResource(const ShaderResource& other)
+    : Shader()
+    , IResource<SillyEventArg>()
+    , IListener<ShaderResourcePlugin::ChangedEventArg>()
+    , plugin(other.plugin)
+    , filename(other.filename)
+    , dir(other.dir) {
+
+}
+
 ShaderResource::~ShaderResource() {
     plugin.Detach(*this);
 }
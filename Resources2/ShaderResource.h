@@ -94,6 +94,11 @@ private:
     ShaderResourcePlugin& plugin;
     string filename, dir;
     string LoadShader(vector<string> files);
+    ShaderResource& operator=(const ShaderResource&);
+protected:
+    // a new, unloaded resource for the file of another. The uniforms
+    // and boxes of the other shader are not copied.
+    ShaderResource(const ShaderResource& other);
 public:
     ShaderResource(ShaderResourcePlugin& plugin, string filename);
     virtual ~ShaderResource();
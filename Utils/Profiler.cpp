@@ -0,0 +1,135 @@
+// Scoped CPU profiler.
+// -------------------------------------------------------------------
+// Copyright (C) 2007 OpenEngine.dk (See AUTHORS)
+//
+// This program is free software; It is covered by the GNU General
+// Public License version 2 or any later version.
+// See the GNU General Public License for more details (see LICENSE).
+//--------------------------------------------------------------------
+
+#include <Utils/Profiler.h>
+
+#ifdef OE_PROFILE
+
+#include <algorithm>
+
+#ifdef _MSC_VER
+#include <windows.h>
+#define OE_THREAD_LOCAL __declspec(thread)
+#define OE_MEMORY_BARRIER() MemoryBarrier()
+#else
+#define OE_THREAD_LOCAL __thread
+#define OE_MEMORY_BARRIER() __sync_synchronize()
+#endif
+
+namespace OpenEngine {
+namespace Utils {
+
+volatile bool Profiler::enabled = true;
+Core::Mutex Profiler::mutex;
+std::vector<Profiler::Buffer*> Profiler::buffers;
+
+static OE_THREAD_LOCAL void* threadBuffer = NULL;
+
+void Profiler::SetEnabled(bool enable) {
+    enabled = enable;
+}
+
+void Profiler::SetThreadName(const char* name) {
+    GetBuffer()->name = name;
+}
+
+Profiler::Buffer* Profiler::GetBuffer() {
+    if (threadBuffer) return (Buffer*)threadBuffer;
+    Buffer* buffer = new Buffer();
+    buffer->name = NULL;
+    buffer->count = 0;
+    buffer->first = 0;
+    mutex.Lock();
+    buffer->thread = buffers.size() + 1;
+    buffers.push_back(buffer);
+    mutex.Unlock();
+    threadBuffer = buffer;
+    return buffer;
+}
+
+void Profiler::Record(const char* name, unsigned long long start, unsigned long long end) {
+    Buffer* buffer = GetBuffer();
+    unsigned int index = buffer->count;
+    Event& e = buffer->events[index % CAPACITY];
+    e.name = name;
+    e.start = start;
+    e.end = end;
+    // the event must be complete before readers see the count
+    OE_MEMORY_BARRIER();
+    buffer->count = index + 1;
+}
+
+void Profiler::Clear() {
+    mutex.Lock();
+    for (unsigned int i = 0; i < buffers.size(); ++i)
+        buffers[i]->first = buffers[i]->count;
+    mutex.Unlock();
+}
+
+/**
+ * Write a string literal as a JSON string.
+ */
+static void WriteString(std::ostream& out, const char* s) {
+    out << '"';
+    for (; s && *s; ++s) {
+        if (*s == '"' || *s == '\\') out << '\\' << *s;
+        else if ((unsigned char)*s >= 0x20) out << *s;
+    }
+    out << '"';
+}
+
+void Profiler::WriteChromeTrace(std::ostream& out) {
+    mutex.Lock();
+    std::vector<Buffer*> threads = buffers;
+    mutex.Unlock();
+
+    out << "{\"traceEvents\":[";
+    bool comma = false;
+    std::vector<Event> events;
+    for (unsigned int t = 0; t < threads.size(); ++t) {
+        Buffer* buffer = threads[t];
+        unsigned int count = buffer->count;
+        OE_MEMORY_BARRIER();
+        unsigned int first = buffer->first;
+        if (count - first > CAPACITY) first = count - CAPACITY;
+        events.clear();
+        for (unsigned int i = first; i != count; ++i)
+            events.push_back(buffer->events[i % CAPACITY]);
+        // the owner may have written over the oldest copied events,
+        // including the one it is writing now.
+        OE_MEMORY_BARRIER();
+        unsigned int now = buffer->count;
+        unsigned int skip = 0;
+        if (now + 1 - first > CAPACITY) skip = std::min(now + 1 - first - CAPACITY, count - first);
+
+        if (buffer->name) {
+            out << (comma ? ",\n" : "\n");
+            out << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << buffer->thread
+                << ",\"args\":{\"name\":";
+            WriteString(out, buffer->name);
+            out << "}}";
+            comma = true;
+        }
+        for (unsigned int i = skip; i < events.size(); ++i) {
+            out << (comma ? ",\n" : "\n");
+            out << "{\"name\":";
+            WriteString(out, events[i].name);
+            out << ",\"ph\":\"X\",\"pid\":1,\"tid\":" << buffer->thread
+                << ",\"ts\":" << events[i].start
+                << ",\"dur\":" << events[i].end - events[i].start << "}";
+            comma = true;
+        }
+    }
+    out << "\n],\"displayTimeUnit\":\"ms\"}\n";
+}
+
+} // NS Utils
+} // NS OpenEngine
+
+#endif // OE_PROFILE
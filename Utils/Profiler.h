@@ -0,0 +1,117 @@
+// Scoped CPU profiler.
+// -------------------------------------------------------------------
+// Copyright (C) 2007 OpenEngine.dk (See AUTHORS)
+//
+// This program is free software; It is covered by the GNU General
+// Public License version 2 or any later version.
+// See the GNU General Public License for more details (see LICENSE).
+//--------------------------------------------------------------------
+
+#ifndef _OE_UTILS_PROFILER_H_
+#define _OE_UTILS_PROFILER_H_
+
+/**
+ * Profile the enclosing scope under a name, which must be a string
+ * literal. Expands to nothing unless compiled with OE_PROFILE.
+ */
+#ifdef OE_PROFILE
+#define OE_PROFILE_SCOPE(name) \
+    OpenEngine::Utils::Profiler::Scope OE_PROFILE_JOIN(oeProfileScope, __LINE__)(name)
+#define OE_PROFILE_JOIN(a, b) OE_PROFILE_JOIN2(a, b)
+#define OE_PROFILE_JOIN2(a, b) a##b
+#else
+#define OE_PROFILE_SCOPE(name)
+#endif
+
+#ifdef OE_PROFILE
+
+#include <Core/Mutex.h>
+#include <Utils/Timer.h>
+#include <ostream>
+#include <vector>
+
+namespace OpenEngine {
+namespace Utils {
+
+/**
+ * Scoped CPU profiler
+ *
+ * Records the start and end of named scopes, see OE_PROFILE_SCOPE,
+ * and exports them in the Chrome trace event format, for viewing in
+ * chrome://tracing or Perfetto. Nested scopes show as a hierarchy.
+ *
+ * Each thread records into its own ring buffer without locking. Only
+ * the first scope of a thread takes a lock, to register its buffer.
+ * A full buffer overwrites its oldest scopes. Buffers of exited
+ * threads are kept, so their scopes can still be exported.
+ *
+ * @class Profiler Profiler.h Utils/Profiler.h
+ */
+class Profiler {
+public:
+    static const unsigned int CAPACITY = 1 << 15; // scopes per thread
+
+    class Scope;
+    friend class Scope;
+    class Scope {
+    private:
+        const char* name;
+        unsigned long long start;
+    public:
+        Scope(const char* name)
+            : name(name)
+            , start(enabled ? Timer::GetTime().AsInt() : 0) {}
+        ~Scope() {
+            if (start) Record(name, start, Timer::GetTime().AsInt());
+        }
+    };
+
+    /**
+     * Start or stop recording. Recording is on by default.
+     */
+    static void SetEnabled(bool enable);
+
+    /**
+     * Name the calling thread in exported traces.
+     */
+    static void SetThreadName(const char* name);
+
+    /**
+     * Forget the recorded scopes of all threads.
+     */
+    static void Clear();
+
+    /**
+     * Write the recorded scopes as Chrome trace JSON. May be called
+     * while other threads record; scopes overwritten during the
+     * export are left out.
+     */
+    static void WriteChromeTrace(std::ostream& out);
+
+private:
+    struct Event {
+        const char* name;
+        unsigned long long start, end; // microseconds
+    };
+    struct Buffer {
+        unsigned int thread;
+        const char* name;
+        Event events[CAPACITY];
+        volatile unsigned int count;   // recorded since creation, only written by the owner
+        volatile unsigned int first;   // oldest not cleared
+    };
+
+    static volatile bool enabled;
+    static Core::Mutex mutex;          // guards the buffer list
+    static std::vector<Buffer*> buffers;
+
+    static Buffer* GetBuffer();
+    static void Record(const char* name, unsigned long long start, unsigned long long end);
+};
+
+} // NS Utils
+} // NS OpenEngine
+
+#endif // OE_PROFILE
+
+#endif // _OE_UTILS_PROFILER_H_
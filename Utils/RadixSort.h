@@ -0,0 +1,70 @@
+// Radix sort on 64 bit keys
+// -------------------------------------------------------------------
+// Copyright (C) 2007 OpenEngine.dk (See AUTHORS)
+//
+// This program is free software; It is covered by the GNU General
+// Public License version 2 or any later version.
+// See the GNU General Public License for more details (see LICENSE).
+//--------------------------------------------------------------------
+
+#ifndef _OE_UTILS_RADIX_SORT_H_
+#define _OE_UTILS_RADIX_SORT_H_
+
+#include <vector>
+#include <stdint.h>
+
+namespace OpenEngine {
+    namespace Utils {
+
+/**
+ * Stable least significant digit radix sort of elements with a 64
+ * bit unsigned member named key.
+ *
+ * The sort runs one pass per key byte, skipping bytes which are
+ * equal for all elements, so sparse keys only pay for the bytes
+ * actually in use. Keep the elements small (e.g. key and an index)
+ * as they are copied once per pass.
+ *
+ * @param items Elements to sort in ascending key order.
+ * @param buffer Scratch space, kept by the caller to avoid
+ * reallocation between sorts.
+ */
+template <class T>
+void RadixSort(std::vector<T>& items, std::vector<T>& buffer) {
+    const unsigned int n = items.size();
+    if (n < 2) return;
+    buffer.resize(n);
+
+    unsigned int counts[8][256] = {{0}};
+    for (unsigned int i = 0; i < n; ++i) {
+        uint64_t key = items[i].key;
+        for (unsigned int b = 0; b < 8; ++b)
+            ++counts[b][(key >> (b * 8)) & 0xFF];
+    }
+
+    std::vector<T>* src = &items;
+    std::vector<T>* dst = &buffer;
+    for (unsigned int b = 0; b < 8; ++b) {
+        unsigned int* count = counts[b];
+        // all keys share this byte, nothing to move
+        if (count[((*src)[0].key >> (b * 8)) & 0xFF] == n) continue;
+
+        unsigned int offsets[256];
+        unsigned int sum = 0;
+        for (unsigned int d = 0; d < 256; ++d) {
+            offsets[d] = sum;
+            sum += count[d];
+        }
+        for (unsigned int i = 0; i < n; ++i) {
+            const T& item = (*src)[i];
+            (*dst)[offsets[(item.key >> (b * 8)) & 0xFF]++] = item;
+        }
+        std::vector<T>* tmp = src; src = dst; dst = tmp;
+    }
+    if (src != &items) items.swap(buffer);
+}
+
+} // NS Utils
+} // NS OpenEngine
+
+#endif // _OE_UTILS_RADIX_SORT_H_
@@ -1,3 +1,7 @@
+#ifdef FRAME_BLOCK
+#extension GL_ARB_uniform_buffer_object : require
+#endif
+
 struct LightSource {
     vec4 position;
     float constantAttenuation;
@@ -16,8 +20,17 @@ struct Material {
 };
 
 uniform Material frontMaterial;
+#ifdef FRAME_BLOCK
+// shared by all shaders, see PhongShader::FrameData
+layout(std140) uniform FrameData {
+    mat4 projectionMatrix;
+    vec4 globalAmbient;
+    LightSource lightSource[NUM_LIGHTS];
+};
+#else
 uniform LightSource lightSource[NUM_LIGHTS];
 uniform vec4 globalAmbient;
+#endif
 
 varying vec3 norm, eyeVec;
 varying vec3 lightDir[NUM_LIGHTS];
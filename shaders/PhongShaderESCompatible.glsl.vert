@@ -1,3 +1,7 @@
+#ifdef FRAME_BLOCK
+#extension GL_ARB_uniform_buffer_object : require
+#endif
+
 struct LightSource {
     vec4 position;
     float constantAttenuation;
@@ -16,7 +20,16 @@ struct Material {
 };
 
 uniform Material frontMaterial;
+#ifdef FRAME_BLOCK
+// shared by all shaders, see PhongShader::FrameData
+layout(std140) uniform FrameData {
+    mat4 projectionMatrix;
+    vec4 globalAmbient;
+    LightSource lightSource[NUM_LIGHTS];
+};
+#else
 uniform LightSource lightSource[NUM_LIGHTS];
+#endif
 
 varying vec3 norm, eyeVec;
 varying vec3 lightDir[NUM_LIGHTS];
@@ -37,8 +50,18 @@ attribute vec2 texCoord[NUM_TEXTURES];
 #endif
 #endif
 
+#ifdef INSTANCED
+attribute mat4 instanceModelViewMatrix;
+attribute mat3 instanceNormalMatrix;
+#ifndef FRAME_BLOCK
+uniform mat4 projectionMatrix;
+#endif
+#define modelViewMatrix instanceModelViewMatrix
+#define normalMatrix instanceNormalMatrix
+#else
 uniform mat4 modelViewMatrix, modelViewProjectionMatrix;
 uniform mat3 normalMatrix;
+#endif
 
 //#undef BUMP_MAP
 
@@ -91,6 +114,10 @@ void main()
     }
 #endif
 #endif
+#if defined(INSTANCED) || defined(FRAME_BLOCK)
+    gl_Position = projectionMatrix * vec4(vert, 1.0);
+#else
     gl_Position = modelViewProjectionMatrix * vec4(vertex, 1.0);
+#endif
     norm = n;
 }